@@ -5581,6 +5581,12 @@ void dlmalloc_ensure_initialization()
     ensure_initialization();
 }
 
+mspace dlmalloc_mspace()
+{
+    ensure_initialization();
+    return (mspace)gm;
+}
+
 int mspace_track_large_chunks(mspace msp, int enable) {
   int ret = 0;
   mstate ms = (mstate)msp;
@@ -614,6 +614,8 @@ size_t mspace_bulk_free(mspace msp, void**, size_t n_elements);
 size_t mspace_usable_size(const void* mem);
 size_t mspace_virtual_size(const void* mem);
 mspace mspace_from_ptr(const void* mem);
+//COID: mspace of the global dlmalloc space, as returned by mspace_from_ptr for dlmalloc blocks
+mspace dlmalloc_mspace(void);
 void mspace_malloc_stats(mspace msp);
 int mspace_trim(mspace msp, size_t pad);
 size_t mspace_footprint(mspace msp);
@@ -67,9 +67,11 @@ struct comm_array_mspace
 {
     comm_array_mspace() {
         msp = ::create_mspace(0, true, 16 - sizeof(uints));
+        thread_cache::enable(msp);
     }
 
     ~comm_array_mspace() {
+        thread_cache::disable(msp);
         ::destroy_mspace(msp);
     }
 
@@ -94,6 +96,13 @@ struct comm_array_allocator
         SINGLETON(comm_array_mspace);
     }
 
+    ///mspace used by the current thread for new arrays when none is specified explicitly
+    //@note set by scope_arena, 0 for the shared comm_array_mspace
+    static mspace& thread_mspace() {
+        static thread_local mspace m = 0;
+        return m;
+    }
+
     ///Typed array reserve
     template<class T>
     static T* reserve(uints n, mspace m = 0) {
@@ -172,7 +181,7 @@ struct comm_array_allocator
             m ? m : SINGLETON(comm_array_mspace).msp,
             sizeof(uints) + n * elemsize);
 
-        dbg_memtrack_alloc(tracking, ::mspace_usable_size(p));
+        dbg_memtrack_alloc(tracking, ::mspace_usable_size(p), p);
 
         if (!p) throw std::bad_alloc();
         p[0] = n;
@@ -187,11 +196,14 @@ struct comm_array_allocator
         mspace m = 0
     )
     {
-        uints* p = (uints*)::mspace_malloc(
+        if (!m)
+            m = thread_mspace();
+
+        uints* p = (uints*)thread_cache::alloc(
             m ? m : SINGLETON(comm_array_mspace).msp,
             sizeof(uints) + n * elemsize);
 
-        dbg_memtrack_alloc(tracking, ::mspace_usable_size(p));
+        dbg_memtrack_alloc(tracking, ::mspace_usable_size(p), p);
 
         if (!p) throw std::bad_alloc();
         p[0] = n;
@@ -210,7 +222,7 @@ struct comm_array_allocator
         if (!p)
             return alloc(n, elemsize, tracking, m);
 
-        dbg_memtrack_free(tracking, ::mspace_usable_size((uints*)p - 1));
+        dbg_memtrack_free(tracking, ::mspace_usable_size((uints*)p - 1), (uints*)p - 1);
 
         uints* pn = (uints*)::mspace_realloc(
             m ? m : SINGLETON(comm_array_mspace).msp,
@@ -218,7 +230,7 @@ struct comm_array_allocator
             sizeof(uints) + n * elemsize);
         if (!pn) throw std::bad_alloc();
 
-        dbg_memtrack_alloc(tracking, ::mspace_usable_size(pn));
+        dbg_memtrack_alloc(tracking, ::mspace_usable_size(pn), pn);
 
         pn[0] = n;
         return pn + 1;
@@ -244,8 +256,8 @@ struct comm_array_allocator
         if (!pn)
             return 0;
 
-        dbg_memtrack_free(tracking, so);
-        dbg_memtrack_alloc(tracking, ::mspace_usable_size(pn));
+        dbg_memtrack_free(tracking, so, po);
+        dbg_memtrack_alloc(tracking, ::mspace_usable_size(pn), pn);
 
         pn[0] = n;
         return pn + 1;
@@ -259,8 +271,8 @@ struct comm_array_allocator
     {
         if (!p)  return;
 
-        dbg_memtrack_free(tracking, ::mspace_usable_size((uints*)p - 1));
-        ::mspace_free((uints*)p - 1);
+        dbg_memtrack_free(tracking, ::mspace_usable_size((uints*)p - 1), (uints*)p - 1);
+        thread_cache::free((uints*)p - 1);
     }
 
     ///Untyped uninitialized add
@@ -324,6 +336,24 @@ struct comm_array_allocator
     }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+///Route array allocations of the current thread to the shared comm_array_mspace while in scope
+/// Used by long-lived state that may be first allocated while a scope_arena is installed
+struct shared_mspace_guard
+{
+    shared_mspace_guard() : _prev(comm_array_allocator::thread_mspace()) {
+        comm_array_allocator::thread_mspace() = 0;
+    }
+
+    ~shared_mspace_guard() {
+        comm_array_allocator::thread_mspace() = _prev;
+    }
+
+private:
+
+    mspace _prev;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 COID_NAMESPACE_END
 
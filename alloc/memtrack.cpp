@@ -35,14 +35,23 @@
  * ***** END LICENSE BLOCK ***** */
 
 #include "memtrack.h"
-#include "../hash/hashkeyset.h"
+#include "commalloc.h"
 #include "../singleton.h"
 #include "../atomic/atomic.h"
 #include "../sync/mutex.h"
 
 #include "../binstream/filestream.h"
 
-#ifdef _DEBUG
+#include <math.h>
+
+#ifdef SYSTYPE_WIN
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <execinfo.h>
+#endif
+
+#if defined(_DEBUG) || COID_USE_MEMTRACK
 static const bool default_enabled = true;
 #else
 static const bool default_enabled = false;
@@ -51,6 +60,11 @@ static const bool default_enabled = false;
 
 namespace coid {
 
+static const uint MAX_SLOTS = 8192;         //< max number of tracked types
+static const uint PAGE_SLOTS = 256;         //< slots in a lazily allocated page of counters
+static const uint TYPE_CACHE = 64;          //< per-thread type_info to slot cache entries
+static const uint SAMPLE_BUCKETS = 4096;   //< buckets of sampled blocks, frees of blocks in empty buckets skip the lock
+
 
 static void name_filter(charstr& dst, token name)
 {
@@ -78,45 +92,150 @@ static void name_filter(charstr& dst, token name)
     while (name);
 }
 
-///
-struct memtrack_imp : memtrack {
-    bool operator == (size_t k) const {
-        return (size_t)name == k;
+////////////////////////////////////////////////////////////////////////////////
+///Allocation counters of a type, lifetime totals
+struct memtrack_counters {
+    std::atomic<int64> abytes;
+    std::atomic<int64> acount;
+    std::atomic<int64> fbytes;
+    std::atomic<int64> fcount;
+};
+
+///Per-thread counters, adopted by another thread once the owner exits
+/// Counters are written only by the owning thread without interlocked operations, except
+/// for the shared shard used by threads that are already exiting
+struct memtrack_shard {
+    std::atomic<memtrack_counters*> pages[MAX_SLOTS / PAGE_SLOTS];
+    std::atomic<bool> owned;
+    bool shared;
+    memtrack_shard* next;
+
+    const std::type_info* cache_key[TYPE_CACHE];
+    uint cache_slot[TYPE_CACHE];
+
+    std::atomic<int64> sample_left;     //< bytes to allocate until the next sample
+    uint sample_gen;                    //< sampling setup the countdown belongs to
+    uint64 rng;
+
+    ///Next geometrically distributed sampling interval in bytes, with given mean
+    int64 sample_interval(uint rate)
+    {
+        //rate 1 samples everything
+        if (rate <= 1)
+            return 0;
+
+        //xorshift64*, uniform in (0,1]
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        double u = double((rng * 0x2545f4914f6cdd1dULL) >> 11 | 1) * (1.0 / 9007199254740992.0);
+
+        return int64(-::log(u) * rate);
     }
 
-    operator size_t() const {
-        return (size_t)name;
+    memtrack_counters& counters(uint slot)
+    {
+        std::atomic<memtrack_counters*>& pg = pages[slot / PAGE_SLOTS];
+        memtrack_counters* c = pg.load(std::memory_order_acquire);
+
+        if (!c) {
+            c = (memtrack_counters*)::dlcalloc(PAGE_SLOTS, sizeof(memtrack_counters));
+            memtrack_counters* exp = 0;
+            if (!pg.compare_exchange_strong(exp, c, std::memory_order_acq_rel)) {
+                ::dlfree(c);
+                c = exp;
+            }
+        }
+
+        return c[slot % PAGE_SLOTS];
     }
 
-    //don't track this
-    void* operator new(size_t size) { return ::dlmalloc(size); }
-    void operator delete(void* ptr) { ::dlfree(ptr); } \
+    void add(std::atomic<int64>& v, int64 d) {
+        if (shared)
+            v.fetch_add(d, std::memory_order_relaxed);
+        else
+            v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    }
+
+    static memtrack_shard* create(bool shared)
+    {
+        memtrack_shard* s = (memtrack_shard*)::dlcalloc(1, sizeof(memtrack_shard));
+        s->owned = true;
+        s->shared = shared;
+        s->rng = uint64((uints)s) * 0x9e3779b97f4a7c15ULL | 1;
+        return s;
+    }
 };
 
-///
-struct hash_memtrack {
-    typedef size_t key_type;
-    uint operator()(size_t x) const { return (uint)x; }
+///Sampled live allocation
+struct memtrack_sample_node {
+    const void* ptr;
+    memtrack_sample_node* next;
+    memtrack_sample sample;
 };
 
-typedef hash_keyset<memtrack_imp, _Select_Copy<memtrack_imp, size_t>, hash_memtrack>
-memtrack_hash_t;
+////////////////////////////////////////////////////////////////////////////////
+static uint capture_stack(void** frames, uint nmax)
+{
+    //skip capture_stack, sample_alloc and the memtrack entry point
+    static const uint SKIP = 3;
+
+#ifdef SYSTYPE_WIN
+    return ::RtlCaptureStackBackTrace(SKIP, nmax, frames, 0);
+#else
+    void* buf[memtrack_sample::MAX_FRAMES + SKIP];
+    int n = ::backtrace(buf, int(nmax + SKIP));
+    if (n <= int(SKIP))
+        return 0;
 
+    ::memcpy(frames, buf + SKIP, (n - SKIP) * sizeof(void*));
+    return n - SKIP;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
 ///
 struct memtrack_registrar
 {
     volatile bool running = false;
 
-    memtrack_hash_t* hash = 0;
-    comm_mutex* mux = 0;
+    comm_mutex* mux = 0;                //< guards type registration, shard list and aggregation
+    comm_mutex* sample_mux = 0;
 
     bool enabled = default_enabled;
     bool ready = false;
 
+    //type table, slot 0 is unknown
+    const char** names = 0;
+    uint* index = 0;                    //< open addressing table of slot+1, keyed by name pointer
+    uint nslots = 1;
+
+    //state at last list or reset call, to compute the differences
+    int64* last_abytes = 0;
+    int64* last_acount = 0;
+
+    memtrack_shard* shards = 0;
+    memtrack_shard* shared = 0;         //< shard for threads past their exit
+
+    volatile uint sample_rate = 0;      //< mean bytes allocated between samples
+    volatile uint sample_gen = 0;       //< bumped with each sampling change to restart the countdowns
+    std::atomic<memtrack_sample_node*>* samples = 0;
+
     memtrack_registrar()
     {
         mux = new comm_mutex(500, false);
-        hash = new memtrack_hash_t;
+        sample_mux = new comm_mutex(500, false);
+
+        names = (const char**)::dlcalloc(MAX_SLOTS, sizeof(const char*));
+        index = (uint*)::dlcalloc(2 * MAX_SLOTS, sizeof(uint));
+        last_abytes = (int64*)::dlcalloc(MAX_SLOTS, sizeof(int64));
+        last_acount = (int64*)::dlcalloc(MAX_SLOTS, sizeof(int64));
+        samples = (std::atomic<memtrack_sample_node*>*)::dlcalloc(SAMPLE_BUCKETS, sizeof(std::atomic<memtrack_sample_node*>));
+
+        names[0] = "unknown";
+
+        shared = memtrack_shard::create(true);
+        shards = shared;
 
         ready = true;
     }
@@ -125,71 +244,177 @@ struct memtrack_registrar
 
     //@note virtual methods to avoid breaking dlls when exe implementation changes
 
-    ///Track allocation
-    virtual void alloc(const std::type_info* tracking, size_t size)
+    ///Get slot for type, registering it if not known yet
+    virtual uint slot(const std::type_info* tracking)
     {
-        static bool inside = false;
-        if (inside)
-            return;     //avoid stack overlow from hashmap
+        if (!tracking)
+            return 0;
+
+        const char* name = tracking->name();
+        uint mask = 2 * MAX_SLOTS - 1;
+        uint i = uint(((uints)name >> 3) * 2654435761u) & mask;
 
-        const char* name = tracking ? tracking->name() : "unknown";
+        GUARDTHIS(*mux);
+        for (;; i = (i + 1) & mask) {
+            uint s = index[i];
+            if (!s) {
+                if (nslots >= MAX_SLOTS)
+                    return 0;
+
+                names[nslots] = name;
+                index[i] = nslots + 1;
+                return nslots++;
+            }
+            if (names[s - 1] == name)
+                return s - 1;
+        }
+    }
 
+    ///Get a shard for the calling thread, reusing one abandoned by an exited thread
+    virtual memtrack_shard* acquire_shard()
+    {
         GUARDTHIS(*mux);
-        inside = true;
-        memtrack* val = hash->find_or_insert_value_slot((size_t)name);
-        inside = false;
-
-        val->name = name;
-
-        ++val->nallocs;
-        ++val->ncurallocs;
-        ++val->nlifeallocs;
-        val->size += size;
-        val->cursize += size;
-        val->lifesize += size;
+        for (memtrack_shard* s = shards; s; s = s->next) {
+            bool free = false;
+            if (!s->shared && s->owned.compare_exchange_strong(free, true, std::memory_order_acquire))
+                return s;
+        }
+
+        memtrack_shard* s = memtrack_shard::create(false);
+        s->next = shards;
+        shards = s;
+        return s;
+    }
+
+    virtual void release_shard(memtrack_shard* s)
+    {
+        s->owned.store(false, std::memory_order_release);
+    }
+
+    ///Track allocation
+    virtual void alloc(uint slot, size_t size, const void* p)
+    {
+        memtrack_shard* s = local_shard();
+        memtrack_counters& c = s->counters(slot);
+
+        s->add(c.abytes, size);
+        s->add(c.acount, 1);
+
+        uint rate = sample_rate;
+        if (rate && p) {
+            //per-thread countdown of allocated bytes, independent of the block addresses
+            uint gen = sample_gen;
+            int64 left = s->sample_left.load(std::memory_order_relaxed);
+            if (s->sample_gen != gen) {
+                s->sample_gen = gen;
+                left = s->sample_interval(rate);
+            }
+
+            left -= int64(size);
+            if (left < 0) {
+                left = s->sample_interval(rate);
+                sample_alloc(slot, size, p);
+            }
+            s->sample_left.store(left, std::memory_order_relaxed);
+        }
     }
 
     ///Track freeing
-    virtual void free(const std::type_info* tracking, size_t size)
+    virtual void free(uint slot, size_t size, const void* p)
     {
-        const char* name = tracking ? tracking->name() : "unknown";
+        memtrack_shard* s = local_shard();
+        memtrack_counters& c = s->counters(slot);
 
-        GUARDTHIS(*mux);
-        memtrack_imp* val = const_cast<memtrack_imp*>(hash->find_value((size_t)name));
+        s->add(c.fbytes, size);
+        s->add(c.fcount, 1);
+
+        if (sample_rate && p)
+            sample_free(p);
+    }
+
+    ///Map type to slot using the calling thread's cache
+    uint cached_slot(const std::type_info* tracking)
+    {
+        if (!tracking)
+            return 0;
+
+        memtrack_shard* s = local_shard();
+        uint i = uint(((uints)tracking >> 3) * 2654435761u) % TYPE_CACHE;
+
+        if (s->cache_key[i] == tracking)
+            return s->cache_slot[i];
 
-        if (val) {
-            //val->size -= size;
-            val->cursize -= size;
-            --val->ncurallocs;
+        uint sl = slot(tracking);
+        if (!s->shared) {
+            s->cache_key[i] = tracking;
+            s->cache_slot[i] = sl;
         }
+        return sl;
     }
 
-    virtual uint list(memtrack* dst, uint nmax, bool modified_only) const
+    ///Sum counters of all shards
+    //@param dst array of 4 values per slot: allocated bytes, allocations, freed bytes, frees
+    void aggregate(int64* dst) const
+    {
+        ::memset(dst, 0, nslots * 4 * sizeof(int64));
+
+        for (const memtrack_shard* s = shards; s; s = s->next) {
+            for (uint p = 0; p * PAGE_SLOTS < nslots; ++p) {
+                const memtrack_counters* c = s->pages[p].load(std::memory_order_acquire);
+                if (!c)
+                    continue;
+
+                uint n = nslots - p * PAGE_SLOTS;
+                if (n > PAGE_SLOTS)
+                    n = PAGE_SLOTS;
+
+                int64* d = dst + p * PAGE_SLOTS * 4;
+                for (uint i = 0; i < n; ++i, d += 4) {
+                    d[0] += c[i].abytes.load(std::memory_order_relaxed);
+                    d[1] += c[i].acount.load(std::memory_order_relaxed);
+                    d[2] += c[i].fbytes.load(std::memory_order_relaxed);
+                    d[3] += c[i].fcount.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    memtrack make_entry(uint slot, const int64* v) const
+    {
+        memtrack m;
+        m.name = names[slot];
+        m.size = ptrdiff_t(v[0] - last_abytes[slot]);
+        m.nallocs = uint(v[1] - last_acount[slot]);
+        m.cursize = size_t(v[0] - v[2]);
+        m.ncurallocs = uint(v[1] - v[3]);
+        m.lifesize = size_t(v[0]);
+        m.nlifeallocs = uint(v[1]);
+        return m;
+    }
+
+    virtual uint list(memtrack* dst, uint nmax, bool modified_only)
     {
         GUARDTHIS(*mux);
-        memtrack_hash_t::iterator ib = hash->begin();
-        memtrack_hash_t::iterator ie = hash->end();
+        int64* totals = (int64*)::dlmalloc(nslots * 4 * sizeof(int64));
+        aggregate(totals);
 
-        uint i = 0;
-        for (; ib != ie && i < nmax; ++ib) {
-            memtrack& p = *ib;
-            if (p.nallocs == 0 && modified_only)
+        uint n = 0;
+        for (uint i = 0; i < nslots && n < nmax; ++i) {
+            memtrack m = make_entry(i, totals + i * 4);
+            if (m.nallocs == 0 && (modified_only || m.nlifeallocs == 0))
                 continue;
 
-            dst[i++] = p;
-            p.nallocs = 0;
-            p.size = 0;
+            dst[n++] = m;
+            last_abytes[i] = totals[i * 4 + 0];
+            last_acount[i] = totals[i * 4 + 1];
         }
 
-        return i;
+        ::dlfree(totals);
+        return n;
     }
 
-    virtual void dump(const char* file, bool diff) const
+    virtual void dump(const char* file, bool diff)
     {
-        GUARDTHIS(*mux);
-        memtrack_hash_t::iterator ib = hash->begin();
-        memtrack_hash_t::iterator ie = hash->end();
-
         bofstream bof(file);
         if (!bof.is_open())
             return;
@@ -205,27 +430,35 @@ struct memtrack_registrar
         int64 totalsize = 0;
         size_t totalcount = 0;
 
-        for (; ib != ie; ++ib) {
-            memtrack& p = *ib;
-            if (diff ? (p.size == 0) : (p.cursize == 0))
-                continue;
+        {
+            GUARDTHIS(*mux);
+            int64* totals = (int64*)::dlmalloc(nslots * 4 * sizeof(int64));
+            aggregate(totals);
 
-            ints size = diff ? p.size : ints(p.cursize);
-            uint count = diff ? p.nallocs : p.ncurallocs;
+            for (uint i = 0; i < nslots; ++i) {
+                memtrack p = make_entry(i, totals + i * 4);
+                if (diff ? (p.size == 0) : (p.cursize == 0))
+                    continue;
 
-            totalsize += size;
-            totalcount += count;
+                ints size = diff ? p.size : ints(p.cursize);
+                uint count = diff ? p.nallocs : p.ncurallocs;
 
-            buf.append_num_thousands(size, ',', 12);
-            buf.append_num(10, count, 9);
-            buf << '\t';
-            name_filter(buf, p.name);
-            buf << '\n';
+                totalsize += size;
+                totalcount += count;
 
-            if (buf.len() > 7900) {
-                bof.xwrite_token_raw(buf);
-                buf.reset();
+                buf.append_num_thousands(size, ',', 12);
+                buf.append_num(10, count, 9);
+                buf << '\t';
+                name_filter(buf, p.name);
+                buf << '\n';
+
+                if (buf.len() > 7900) {
+                    bof.xwrite_token_raw(buf);
+                    buf.reset();
+                }
             }
+
+            ::dlfree(totals);
         }
 
         buf << "======== bytes | #alloc |  type ======\n";
@@ -244,24 +477,164 @@ struct memtrack_registrar
         buf << "\ntotal free space:                        " << num_metric(md.fordblks + ma.fordblks, 8); buf << 'B';
         buf << "\nreleasable (via malloc_trim) space:      " << num_metric(md.keepcost + ma.keepcost, 8); buf << 'B';
 
+        if (sample_rate) {
+            buf << "\n\n======== sampled live allocations (1 per " << sample_rate << " bytes) ======\n";
+
+            GUARDTHIS(*sample_mux);
+            for (uint b = 0; b < SAMPLE_BUCKETS; ++b) {
+                for (const memtrack_sample_node* n = samples[b].load(std::memory_order_relaxed); n; n = n->next) {
+                    const memtrack_sample& s = n->sample;
+                    buf.append_num_thousands(s.size, ',', 12);
+                    buf << '\t';
+                    name_filter(buf, s.name);
+                    buf << '\n';
+
+                    for (uint f = 0; f < s.nframes; ++f) {
+                        buf << "\t\t0x";
+                        buf.append_num(16, (uints)s.frames[f]);
+                        buf << '\n';
+                    }
+
+                    if (buf.len() > 7900) {
+                        bof.xwrite_token_raw(buf);
+                        buf.reset();
+                    }
+                }
+            }
+        }
+
         bof.xwrite_token_raw(buf);
         bof.close();
     }
 
     virtual uint count() const {
         GUARDTHIS(*mux);
-        return (uint)hash->size();
+        return nslots;
     }
 
     virtual void reset() {
         GUARDTHIS(*mux);
-        memtrack_hash_t::iterator ib = hash->begin();
-        memtrack_hash_t::iterator ie = hash->end();
+        int64* totals = (int64*)::dlmalloc(nslots * 4 * sizeof(int64));
+        aggregate(totals);
+
+        for (uint i = 0; i < nslots; ++i) {
+            last_abytes[i] = totals[i * 4 + 0];
+            last_acount[i] = totals[i * 4 + 1];
+        }
+
+        ::dlfree(totals);
+    }
+
+    virtual uint set_sampling(uint n)
+    {
+        GUARDTHIS(*sample_mux);
+        uint old = sample_rate;
+
+        sample_rate = n;
+        ++sample_gen;
+
+        if (!n) {
+            for (uint b = 0; b < SAMPLE_BUCKETS; ++b) {
+                memtrack_sample_node* s = samples[b].load(std::memory_order_relaxed);
+                while (s) {
+                    memtrack_sample_node* t = s->next;
+                    ::dlfree(s);
+                    s = t;
+                }
+                samples[b].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        return old;
+    }
+
+    virtual uint list_samples(memtrack_sample* dst, uint nmax)
+    {
+        GUARDTHIS(*sample_mux);
+        uint n = 0;
+        for (uint b = 0; b < SAMPLE_BUCKETS && n < nmax; ++b)
+            for (const memtrack_sample_node* s = samples[b].load(std::memory_order_relaxed); s && n < nmax; s = s->next)
+                dst[n++] = s->sample;
+
+        return n;
+    }
+
+private:
+
+    ///Get shard of the calling thread
+    memtrack_shard* local_shard()
+    {
+        struct holder {
+            memtrack_registrar* reg = 0;
+            memtrack_shard* shard = 0;
+
+            ~holder() {
+                if (shard)
+                    reg->release_shard(shard);
+                shard = 0;
+                gone() = true;
+            }
+
+            static bool& gone() {
+                static thread_local bool gone = false;
+                return gone;
+            }
+        };
+
+        static thread_local memtrack_shard* shard = 0;
+        if (shard)
+            return shard;
+
+        if (holder::gone())
+            return shared;
+
+        static thread_local holder h;
+        h.reg = this;
+        h.shard = shard = acquire_shard();
+        return shard;
+    }
+
+    static uint bucket(const void* p) {
+        return uint(((uints)p >> 4) * 2654435761u) % SAMPLE_BUCKETS;
+    }
+
+    void sample_alloc(uint slot, size_t size, const void* p)
+    {
+        memtrack_sample_node* n = (memtrack_sample_node*)::dlmalloc(sizeof(memtrack_sample_node));
+        n->ptr = p;
+        n->sample.name = names[slot];
+        n->sample.size = size;
+        n->sample.nframes = capture_stack(n->sample.frames, memtrack_sample::MAX_FRAMES);
+
+        GUARDTHIS(*sample_mux);
+        if (!sample_rate) {
+            ::dlfree(n);
+            return;
+        }
+
+        std::atomic<memtrack_sample_node*>& head = samples[bucket(p)];
+        n->next = head.load(std::memory_order_relaxed);
+        head.store(n, std::memory_order_release);
+    }
+
+    void sample_free(const void* p)
+    {
+        //a sampled block is published before its pointer can reach the freeing thread
+        std::atomic<memtrack_sample_node*>& head = samples[bucket(p)];
+        if (!head.load(std::memory_order_acquire))
+            return;
 
-        for (; ib != ie; ++ib) {
-            memtrack& p = *ib;
-            p.nallocs = 0;
-            p.size = 0;
+        GUARDTHIS(*sample_mux);
+        memtrack_sample_node* prev = 0;
+        for (memtrack_sample_node* n = head.load(std::memory_order_relaxed); n; prev = n, n = n->next) {
+            if (n->ptr == p) {
+                if (prev)
+                    prev->next = n->next;
+                else
+                    head.store(n->next, std::memory_order_relaxed);
+                ::dlfree(n);
+                return;
+            }
         }
     }
 };
@@ -269,6 +642,10 @@ struct memtrack_registrar
 ////////////////////////////////////////////////////////////////////////////////
 static memtrack_registrar* memtrack_register()
 {
+    static memtrack_registrar* registrar = 0;
+    if (registrar)
+        return registrar;
+
     static bool reentry = false;
     if (reentry)
         return 0;
@@ -277,7 +654,7 @@ static memtrack_registrar* memtrack_register()
     LOCAL_PROCWIDE_SINGLETON_DEF(memtrack_registrar) reg;
     reentry = false;
 
-    return reg.get();
+    return registrar = reg.get();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -300,21 +677,49 @@ void memtrack_shutdown()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void memtrack_alloc(const std::type_info* tracking, size_t size)
+uint memtrack_slot(const std::type_info* tracking)
+{
+    memtrack_registrar* mtr = memtrack_register();
+    if (!mtr || !mtr->ready)
+        return 0;
+
+    return mtr->slot(tracking);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void memtrack_alloc_slot(uint slot, size_t size, const void* p)
+{
+    memtrack_registrar* mtr = memtrack_register();
+    if (!mtr || !mtr->running) return;
+
+    mtr->alloc(slot, size, p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void memtrack_free_slot(uint slot, size_t size, const void* p)
 {
     memtrack_registrar* mtr = memtrack_register();
     if (!mtr || !mtr->running) return;
 
-    mtr->alloc(tracking, size);
+    mtr->free(slot, size, p);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void memtrack_free(const std::type_info* tracking, size_t size)
+void memtrack_alloc(const std::type_info* tracking, size_t size, const void* p)
 {
     memtrack_registrar* mtr = memtrack_register();
     if (!mtr || !mtr->running) return;
 
-    mtr->free(tracking, size);
+    mtr->alloc(mtr->cached_slot(tracking), size, p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void memtrack_free(const std::type_info* tracking, size_t size, const void* p)
+{
+    memtrack_registrar* mtr = memtrack_register();
+    if (!mtr || !mtr->running) return;
+
+    mtr->free(mtr->cached_slot(tracking), size, p);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -354,4 +759,22 @@ void memtrack_reset()
     mtr->reset();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+uint memtrack_sampling(uint n)
+{
+    memtrack_registrar* mtr = memtrack_register();
+    if (!mtr) return 0;
+
+    return mtr->set_sampling(n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint memtrack_samples(memtrack_sample* dst, uint nmax)
+{
+    memtrack_registrar* mtr = memtrack_register();
+    if (!mtr) return 0;
+
+    return mtr->list_samples(dst, nmax);
+}
+
 } //namespace coid
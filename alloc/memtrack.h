@@ -40,29 +40,48 @@
 
 #include "../namespace.h"
 #include "_malloc.h"
+#include "thread_cache.h"
 #include <typeinfo>
 #include <utility>
+#include <atomic>
 
 namespace coid {
 
 #if defined(_DEBUG) || COID_USE_MEMTRACK
 
 //fwd
-void memtrack_alloc(const std::type_info* tracking, size_t size);
-void memtrack_free(const std::type_info* tracking, size_t size);
+void memtrack_alloc(const std::type_info* tracking, size_t size, const void* p = 0);
+void memtrack_free(const std::type_info* tracking, size_t size, const void* p = 0);
+void memtrack_alloc_slot(unsigned int slot, size_t size, const void* p);
+void memtrack_free_slot(unsigned int slot, size_t size, const void* p);
+unsigned int memtrack_slot(const std::type_info* tracking);
 
+///Memtrack slot of type T, assigned on first use
 template <class T>
-inline void dbg_memtrack_alloc(size_t size) { coid::memtrack_alloc(&typeid(T), size); }
+inline unsigned int memtrack_type_slot() {
+    static std::atomic<unsigned int> slot;
+    unsigned int s = slot.load(std::memory_order_relaxed);
+    if (!s)
+        slot.store(s = coid::memtrack_slot(&typeid(T)), std::memory_order_relaxed);
+    return s;
+}
 
 template <class T>
-inline void dbg_memtrack_free(size_t size) { coid::memtrack_free(&typeid(T), size); }
+inline void dbg_memtrack_alloc(size_t size, const void* p = 0) {
+    coid::memtrack_alloc_slot(memtrack_type_slot<T>(), size, p);
+}
+
+template <class T>
+inline void dbg_memtrack_free(size_t size, const void* p = 0) {
+    coid::memtrack_free_slot(memtrack_type_slot<T>(), size, p);
+}
 
-inline void dbg_memtrack_alloc(const std::type_info* tracking, size_t size) {
-    coid::memtrack_alloc(tracking, size);
+inline void dbg_memtrack_alloc(const std::type_info* tracking, size_t size, const void* p = 0) {
+    coid::memtrack_alloc(tracking, size, p);
 }
 
-inline void dbg_memtrack_free(const std::type_info* tracking, size_t size) {
-    coid::memtrack_free(tracking, size);
+inline void dbg_memtrack_free(const std::type_info* tracking, size_t size, const void* p = 0) {
+    coid::memtrack_free(tracking, size, p);
 }
 
 #define MEMTRACK_ENABLED
@@ -70,13 +89,13 @@ inline void dbg_memtrack_free(const std::type_info* tracking, size_t size) {
 #else
 
 template <class T>
-inline void dbg_memtrack_alloc(size_t size) {}
+inline void dbg_memtrack_alloc(size_t size, const void* p = 0) {}
 
 template <class T>
-inline void dbg_memtrack_free(size_t size) {}
+inline void dbg_memtrack_free(size_t size, const void* p = 0) {}
 
-inline void dbg_memtrack_alloc(const std::type_info* tracking, size_t size) {}
-inline void dbg_memtrack_free(const std::type_info* tracking, size_t size) {}
+inline void dbg_memtrack_alloc(const std::type_info* tracking, size_t size, const void* p = 0) {}
+inline void dbg_memtrack_free(const std::type_info* tracking, size_t size, const void* p = 0) {}
 
 #endif
 
@@ -85,35 +104,35 @@ inline void dbg_memtrack_free(const std::type_info* tracking, size_t size) {}
 
 #define COIDNEWDELETE(T) \
     void* operator new( size_t size ) { \
-        void* p=::dlmalloc(size); \
+        void* p=coid::thread_cache::alloc(0, size); \
         if(p==0) throw std::bad_alloc(); \
-        coid::dbg_memtrack_alloc<T>(dlmalloc_usable_size(p)); \
+        coid::dbg_memtrack_alloc<T>(dlmalloc_usable_size(p), p); \
         return p; } \
     void* operator new( size_t, void* p ) { return p; } \
     void operator delete(void* p) { \
-        coid::dbg_memtrack_free<T>(dlmalloc_usable_size(p)); \
-        ::dlfree(p); } \
+        coid::dbg_memtrack_free<T>(dlmalloc_usable_size(p), p); \
+        coid::thread_cache::free(p); } \
     void operator delete(void*, void*)  { }
 
 #define COIDNEWDELETE_ALIGN(T, alignment) \
     void* operator new( size_t size ) { \
         void* p=::dlmemalign(alignment,size); \
         if(p==0) throw std::bad_alloc(); \
-        coid::dbg_memtrack_alloc<T>(dlmalloc_usable_size(p)); \
+        coid::dbg_memtrack_alloc<T>(dlmalloc_usable_size(p), p); \
         return p; } \
     void* operator new( size_t, void* p ) { return p; } \
     void operator delete(void* p) { \
-        coid::dbg_memtrack_free<T>(dlmalloc_usable_size(p)); \
+        coid::dbg_memtrack_free<T>(dlmalloc_usable_size(p), p); \
         ::dlfree(p); } \
     void operator delete(void*, void*)  { }
 
 #define COIDNEWDELETE_NOTRACK \
     void* operator new( size_t size ) { \
-        void* p=::dlmalloc(size); \
+        void* p=coid::thread_cache::alloc(0, size); \
         if(p==0) throw std::bad_alloc(); \
         return p; } \
     void* operator new( size_t, void* p ) { return p; } \
-    void operator delete(void* ptr)     { ::dlfree(ptr); } \
+    void operator delete(void* ptr)     { coid::thread_cache::free(ptr); } \
     void operator delete(void*, void*)  { }
 
 
@@ -139,16 +158,40 @@ struct memtrack {
     }
 };
 
+///Live allocation sampled together with its call stack
+struct memtrack_sample {
+    static const unsigned int MAX_FRAMES = 16;
+
+    const char* name = 0;               //< class identifier
+    size_t size = 0;                    //< allocated size
+    unsigned int nframes = 0;           //< number of valid frames
+    void* frames[MAX_FRAMES];           //< return addresses, innermost first
+};
+
 
 ///Track allocation request for name
 //@param name allocation name, unique pointer
 //@param size allocated size
-void memtrack_alloc( const std::type_info* tracking, size_t size );
+//@param p allocated block, used only for sampling
+void memtrack_alloc( const std::type_info* tracking, size_t size, const void* p );
 
 ///Track allocation request for name
 //@param name allocation name, unique pointer
 //@param size freed size
-void memtrack_free( const std::type_info* tracking, size_t size );
+//@param p freed block, used only for sampling
+void memtrack_free( const std::type_info* tracking, size_t size, const void* p );
+
+///Track allocation request for type slot
+//@param slot type slot from memtrack_slot
+void memtrack_alloc_slot( unsigned int slot, size_t size, const void* p );
+
+///Track freeing for type slot
+//@param slot type slot from memtrack_slot
+void memtrack_free_slot( unsigned int slot, size_t size, const void* p );
+
+///Get tracking slot for type, registering it on first use
+//@return slot index, 0 (unknown) if the tracker isn't available
+unsigned int memtrack_slot( const std::type_info* tracking );
 
 ///List allocation request statistics since the last call
 //@param dst pointer to a buffer to receive the allocation lists
@@ -170,6 +213,19 @@ void memtrack_reset();
 //@return previous state
 bool memtrack_enable( bool en );
 
+///Set up sampling of call stacks for roughly one allocation per n allocated bytes, to find leaks
+/// Each thread counts down geometrically distributed byte intervals, frees look the block up
+/// only if a sample lives in its bucket
+//@param n mean bytes between samples, 1 samples all allocations, 0 disables sampling and discards existing samples
+//@return previous sampling rate
+unsigned int memtrack_sampling( unsigned int n );
+
+///List sampled allocations that haven't been freed yet
+//@param dst pointer to a buffer to receive the samples
+//@param nmax maximum number of entries
+//@return number of entries returned
+unsigned int memtrack_samples( memtrack_sample* dst, unsigned int nmax );
+
 void memtrack_shutdown();
 
 
@@ -178,7 +234,7 @@ inline void* tracked_alloc(const std::type_info* tracking, size_t size)
 {
     void* p = ::dlmalloc(size);
     if (p)
-        memtrack_alloc(tracking, dlmalloc_usable_size(p));
+        memtrack_alloc(tracking, dlmalloc_usable_size(p), p);
     return p;
 }
 
@@ -186,7 +242,7 @@ inline void* tracked_alloc(const std::type_info* tracking, size_t size)
 inline void tracked_free(const std::type_info* tracking, void* p)
 {
     if (p)
-        memtrack_free(tracking, dlmalloc_usable_size(p));
+        memtrack_free(tracking, dlmalloc_usable_size(p), p);
     ::dlfree(p);
 }
 
@@ -0,0 +1,131 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_SCOPE_ARENA__HEADER_FILE__
+#define __COID_COMM_SCOPE_ARENA__HEADER_FILE__
+
+#include "../namespace.h"
+#include "commalloc.h"
+
+COID_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+///Arena for short-lived arrays, releasing all its memory at once when destroyed
+/// While installed, new dynarray and charstr buffers allocated by the current thread go
+/// into the arena. It can also be used explicitly by passing space() to dynarray::reserve
+/// or charstr::reserve.
+/// The arena is a private non-locking mspace. Freed buffers are reused, and reallocating
+/// the most recently allocated buffer extends it into the arena top without copying, as long
+/// as the initial capacity isn't exhausted. The capacity is mapped up front, but pages are
+/// backed by the system only when touched.
+/// Arrays allocated before the arena keep their original mspace when grown.
+//@note buffers allocated from the arena must not outlive it, nor be used by other threads;
+/// singletons, thread names and logger registries are allocated outside of it, other long-lived
+/// containers that may be first filled within the scope must use shared_mspace_guard
+class scope_arena
+{
+public:
+
+    static const size_t DEFAULT_CAPACITY = 8 << 20;
+
+    //@param install route array allocations of the current thread into the arena until destroyed
+    //@param capacity initial capacity in bytes
+    explicit scope_arena(bool install = true, size_t capacity = DEFAULT_CAPACITY)
+    {
+        create(capacity);
+
+        if (install) {
+            mspace& m = comm_array_allocator::thread_mspace();
+            _prev = m;
+            m = _msp;
+            _installed = true;
+        }
+    }
+
+    ~scope_arena()
+    {
+        if (_installed) {
+            DASSERT(comm_array_allocator::thread_mspace() == _msp);
+            comm_array_allocator::thread_mspace() = _prev;
+        }
+
+        ::destroy_mspace(_msp);
+    }
+
+    ///Memory space to pass explicitly to reserve methods
+    mspace space() const { return _msp; }
+
+    ///Bytes currently obtained from the system
+    size_t footprint() const { return ::mspace_footprint(_msp); }
+
+    ///Release all memory allocated from the arena, keeping it installed
+    void reset()
+    {
+        bool current = _installed && comm_array_allocator::thread_mspace() == _msp;
+
+        ::destroy_mspace(_msp);
+        create(_capacity);
+
+        if (current)
+            comm_array_allocator::thread_mspace() = _msp;
+    }
+
+private:
+
+    scope_arena(const scope_arena&) = delete;
+    scope_arena& operator = (const scope_arena&) = delete;
+
+    void create(size_t capacity)
+    {
+        _capacity = capacity;
+        _msp = ::create_mspace(capacity, 0, 16 - sizeof(uints));
+        if (!_msp)
+            throw std::bad_alloc();
+
+        //large chunks must be tracked too, to be released with the space
+        ::mspace_track_large_chunks(_msp, 1);
+    }
+
+    mspace _msp = 0;
+    mspace _prev = 0;                   //< previously installed mspace
+    size_t _capacity = 0;
+    bool _installed = false;
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_SCOPE_ARENA__HEADER_FILE__
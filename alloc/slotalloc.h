@@ -62,6 +62,7 @@ having to resort to expensive system memory allocators.
 Objects within the array have a unique slot id that can be used to retrieve the objects by id or to have an id of the
 object during its lifetime.
 The allocator has for_each and find_if methods that can run functors on each object managed by the allocator.
+Methods for_each_run and for_each_page pass contiguous spans of the main and ext arrays instead, for vectorizable loops.
 
 Optionally can be constructed in pool mode, in which case the removed/freed objects aren't destroyed, and subsequent
 allocation can return one of these without having to call the constructor. This is good when the objects allocate
@@ -71,6 +72,9 @@ All objects are destroyed with the destruction of the allocator object.
 
 Safe to use from a single producer / single consumer threading mode, as long as the working set is
 reserved in advance.
+In atomic multi mode (slotalloc_multi) multiple threads can insert and delete items concurrently. Each
+thread takes free slot ids from its own magazine, refilled from and drained to the shared bitmask in
+batches, so the shared state is locked only once per batch. Address space has to be reserved in advance.
 
 @param T array element type
 @param MODE see slotalloc_mode flags
@@ -80,6 +84,7 @@ template<class T, slotalloc_mode MODE = slotalloc_mode::base, class ...Es>
 class slotalloc_base
     : protected slotalloc_detail::storage<MODE & slotalloc_mode::linear, MODE & slotalloc_mode::atomic, T>
     , protected slotalloc_detail::base<MODE & slotalloc_mode::versioning, MODE & slotalloc_mode::tracking, Es...>
+    , protected slotalloc_detail::multi_base<MODE & slotalloc_mode::multi>
 {
 protected:
 
@@ -92,12 +97,16 @@ protected:
     using uint_type = typename storage_t::uint_type;
 
     static constexpr int MASK_BITS = 8 * sizeof(uints);
+    static constexpr uints SPAN_ITEMS = 256;            //< items in allocation page, or in linear mode span
 
     static constexpr bool POOL = (MODE & slotalloc_mode::pool) != 0;
     static constexpr bool ATOMIC = (MODE & slotalloc_mode::atomic) != 0;
     static constexpr bool TRACKING = (MODE & slotalloc_mode::tracking) != 0;
     static constexpr bool VERSIONING = (MODE & slotalloc_mode::versioning) != 0;
     static constexpr bool LINEAR = (MODE & slotalloc_mode::linear) != 0;
+    static constexpr bool MULTI = (MODE & slotalloc_mode::multi) != 0;
+
+    static_assert(!MULTI || (ATOMIC && !LINEAR), "multi mode requires atomic paged slotalloc");
 
 public:
 
@@ -183,6 +192,7 @@ public:
     void swap(slotalloc_base& other) {
         this->swap_storage(other);
         this->swap_exts(other);
+        this->swap_multi(other);
 
         std::swap(_allocated, other._allocated);
         std::swap(_count, other._count);
@@ -205,6 +215,9 @@ public:
 
         _allocated.reserve(na, true);
 
+        if coid_constexpr_if (MULTI)
+            this->_reserved.reserve(na, true);
+
         extarray_reserve(nitems, reserve_mode::memory);
     }
 
@@ -223,6 +236,9 @@ public:
 
         _allocated.reserve_virtual(na);
 
+        if coid_constexpr_if (MULTI)
+            this->_reserved.reserve_virtual(na);
+
         extarray_reserve(nitems, reserve_mode::virtual_space);
     }
 
@@ -231,6 +247,9 @@ public:
     //@return pointer to the newly inserted object
     T* push(const T& v)
     {
+        if coid_constexpr_if (MULTI)
+            return copy_object(alloc(0), POOL, v);
+
         bool isold = _count < created();
         T* p = isold ? alloc(0) : append<false>();
 
@@ -241,6 +260,9 @@ public:
     //@return pointer to the newly inserted object
     T* push(T&& v)
     {
+        if coid_constexpr_if (MULTI)
+            return this->copy_object(alloc(0), POOL, std::forward<T>(v));
+
         bool isold = _count < created();
         T* p = isold ? alloc(0) : append<false>();
 
@@ -251,6 +273,9 @@ public:
     template<class...Ps>
     T* push_construct(Ps&&... ps)
     {
+        if coid_constexpr_if (MULTI)
+            return construct_object(alloc(0), POOL, std::forward<Ps>(ps)...);
+
         bool isold = _count < created();
         T* p = isold ? alloc(0) : append<false>();
 
@@ -260,6 +285,9 @@ public:
     ///Add new object initialized with default constructor, or reuse one in pool mode
     T* add(uints* pid = 0)
     {
+        if coid_constexpr_if (MULTI)
+            return construct_default(alloc(pid), POOL);
+
         bool isold = _count < created();
         T* p = isold ? alloc(pid) : append<false>(pid);
 
@@ -269,6 +297,8 @@ public:
     ///Add completely new object, ignoring any unused ones
     T* add_new(uints* pid = 0)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         T* p = append<false>(pid);
         return construct_default(p, false);
     }
@@ -277,6 +307,8 @@ public:
     template <typename Func>
     T* add_if(Func fn, uints* pid = 0)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         bool isold = _count < created();
 
         if (!isold)
@@ -294,7 +326,7 @@ public:
     //@note if newitem == 0 within the pool mode and thus no way to indicate the item has been reused, the reused objects have destructors called
     T* add_uninit(bool* newitem = 0, uints* pid = 0)
     {
-        if (_count < created()) {
+        if (MULTI || _count < created()) {
             T* p = alloc(pid);
             if coid_constexpr_if(POOL) {
                 if (!newitem) destroy(*p);
@@ -312,6 +344,8 @@ public:
     //@return id to the beginning of the allocated range
     uints add_range(uints n)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         if (n == 0)
             return UMAXS;
         if (n == 1) {
@@ -338,6 +372,8 @@ public:
     //@return id to the beginning of the allocated range
     uints add_range_uninit(uints n, uints* nreused = 0)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         if (n == 0)
             return UMAXS;
         if (n == 1) {
@@ -460,6 +496,9 @@ public:
 
         if coid_constexpr_if(!POOL)
             p->~T();
+
+        if coid_constexpr_if (MULTI)
+            release_multi(id);
     }
 
     ///Delete object by id
@@ -482,6 +521,9 @@ public:
             T* p = ptr(id);
             p->~T();
         }
+
+        if coid_constexpr_if (MULTI)
+            release_multi(id);
     }
 
 
@@ -499,6 +541,7 @@ public:
     T* undel_item(uints id)
     {
         static_assert(POOL, "only available in pool mode");
+        static_assert(!MULTI, "not supported in multi mode");
 
         if (POOL && id < created()) {
             if (!set_bit(id))
@@ -520,6 +563,7 @@ public:
     T* undel_item(versionid vid)
     {
         static_assert(POOL, "only available in pool mode");
+        static_assert(!MULTI, "not supported in multi mode");
 
         if (POOL && vid.id < this->_created) {
             if (this->check_versionid(vid)) {
@@ -556,6 +600,9 @@ public:
             --_count;
         else
             DASSERTN(0);
+
+        if coid_constexpr_if (MULTI)
+            release_multi(id);
     }
 
     void del_range(uints item_id, uints n) {
@@ -600,6 +647,10 @@ public:
             }
         }
         _count -= clear_bitrange(item_id, n, _allocated.ptr());
+
+        //ranges are returned to the shared bitmask directly
+        if coid_constexpr_if (MULTI)
+            clear_bitrange(item_id, n, this->_reserved.ptr());
     }
 
     ///Del range of objects
@@ -715,6 +766,8 @@ public:
     //@note a deleted item in POOL mode is also considered newly created here
     T* get_or_create(uints id, bool* is_new = 0)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         if (id == UMAXS) {
             if (is_new) *is_new = true;
             return add();
@@ -764,6 +817,8 @@ public:
     //@param is_new optional if not null, receives true if the item was newly created (also not restored from pool)
     T* get_or_create_uninit(uints id, bool* is_new = 0)
     {
+        static_assert(!MULTI, "not supported in multi mode");
+
         if (id == UMAXS) {
             if (is_new) *is_new = true;
             return add_uninit();
@@ -906,6 +961,11 @@ public:
         _count = 0;
 
         _allocated.set_size(0);
+
+        if coid_constexpr_if (MULTI) {
+            this->_reserved.set_size(0);
+            this->reset_magazines();
+        }
     }
 
     ///Discard content. Also destroys pooled objects and frees memory
@@ -919,6 +979,11 @@ public:
         _count = 0;
         _allocated.discard();
 
+        if coid_constexpr_if (MULTI) {
+            this->_reserved.discard();
+            this->reset_magazines();
+        }
+
         if coid_constexpr_if (LINEAR) {
             this->_array.discard();
         }
@@ -1225,6 +1290,21 @@ protected:
 #endif
     //@}
 
+    ///Split bitmask words into chunks of whole allocation pages and run fn(first word, last word) on them via the executor
+    template<typename Exec, typename Fn>
+    static void parallel_words(Exec& exec, uints nwords, uints grain, const Fn& fn)
+    {
+        //page size in bitmask words, the same for linear storage to keep the chunks comparable
+        static constexpr uints PAGE_WORDS = 256 / MASK_BITS;
+
+        uints cw = PAGE_WORDS * stdmax(uints(1), align_to_chunks(grain, PAGE_WORDS * MASK_BITS));
+        uints nchunks = align_to_chunks(nwords, cw);
+
+        exec.parallel_for_range(uints(0), nchunks, grain ? 1 : 0, [&](uints cb, uints ce) {
+            fn(cb * cw, stdmin(ce * cw, nwords));
+        });
+    }
+
 public:
 
     ///Invoke a functor on each used item.
@@ -1237,18 +1317,15 @@ public:
             Tx* d = const_cast<Tx*>(this->_array.ptr());
             uint_type const* b = const_cast<uint_type const*>(_allocated.ptr());
             uint_type const* e = const_cast<uint_type const*>(_allocated.ptre());
-            uints s = 0;
 
-            for (uint_type const* p = b; p != e; ++p, s += MASK_BITS) {
-                if (*p == 0)
-                    continue;
+            for (uint_type const* p = find_word_not(b, e, uints(0)); p != e; p = find_word_not(p + 1, e, uints(0))) {
+                uints s = (p - b) * MASK_BITS;
 
-                uints m = 1;
-                for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
-                    if (*p & m)
-                        funccall(f, d[s + i], s + i);
-                    else if ((*p & ~(m - 1)) == 0)
-                        break;
+                //mask is re-read after each call, items deleted by the functor are skipped
+                for (uints w = *p; w; ) {
+                    uint8 i = lsb_bit_set(uint64(w));
+                    funccall(f, d[s + i], s + i);
+                    w = uints(*p) & ~((uints(2) << i) - 1);
                 }
             }
         }
@@ -1270,18 +1347,12 @@ public:
                     ? pm + page::NMASK
                     : em;
 
-                uints pbase = 0;
-
-                for (; pm != epm; ++pm, pbase += MASK_BITS) {
-                    if (*pm == 0)
-                        continue;
+                for (pm = find_word_not(pm, epm, uints(0)); pm != epm; pm = find_word_not(pm + 1, epm, uints(0))) {
+                    uints pbase = (pm - bm) * MASK_BITS - gbase;
 
-                    uints m = 1;
-                    for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
-                        if (*pm & m)
-                            funccall(f, data[pbase + i], gbase + pbase + i);
-                        else if ((*pm & ~(m - 1)) == 0)
-                            break;
+                    for (uints w = *pm; w; ) {
+                        uint8 i = lsb_bit_set(uint64(w));
+                        funccall(f, data[pbase + i], gbase + pbase + i);
 
                         //update after rebase
                         ints diffm = (ints)const_cast<uint_type const*>(_allocated.ptr()) - (ints)bm;
@@ -1291,6 +1362,8 @@ public:
                             pm = ptr_byteshift(pm, diffm);
                             epm = ptr_byteshift(epm, diffm);
                         }
+
+                        w = uints(*pm) & ~((uints(2) << i) - 1);
                     }
                 }
             }
@@ -1452,30 +1525,26 @@ public:
         uint_type const* em = const_cast<uint_type const*>(_allocated.ptre());
 
         if coid_constexpr_if (LINEAR) {
-            uints base = 0;
             T* pd0 = const_cast<T*>(this->_array.ptr());
 
-            for (uint_type const* pm = bm; pm != em; ++pm, base += MASK_BITS) {
-                if (*pm == 0)
-                    continue;
-
-                uints m = 1;
-                for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
-                    if (*pm & m) {
-                        uints id = base + i;
-                        if (funccall(f, pd0[id], base + i))
-                            return pd0 + id;
-
-                        //update after rebase
-                        ints diffm = (ints)const_cast<uint_type const*>(_allocated.ptr()) - (ints)bm;
-                        if (diffm) {
-                            bm = ptr_byteshift(bm, diffm);
-                            em = const_cast<uint_type const*>(_allocated.ptre());
-                            pm = ptr_byteshift(pm, diffm);
-                        }
+            for (uint_type const* pm = find_word_not(bm, em, uints(0)); pm != em; pm = find_word_not(pm + 1, em, uints(0))) {
+                uints base = (pm - bm) * MASK_BITS;
+
+                for (uints w = *pm; w; ) {
+                    uint8 i = lsb_bit_set(uint64(w));
+                    uints id = base + i;
+                    if (funccall(f, pd0[id], base + i))
+                        return pd0 + id;
+
+                    //update after rebase
+                    ints diffm = (ints)const_cast<uint_type const*>(_allocated.ptr()) - (ints)bm;
+                    if (diffm) {
+                        bm = ptr_byteshift(bm, diffm);
+                        em = const_cast<uint_type const*>(_allocated.ptre());
+                        pm = ptr_byteshift(pm, diffm);
                     }
-                    else if ((*pm & ~(m - 1)) == 0)
-                        break;
+
+                    w = uints(*pm) & ~((uints(2) << i) - 1);
                 }
             }
         }
@@ -1495,29 +1564,24 @@ public:
                     ? pm + page::NMASK
                     : em;
 
-                uints pbase = 0;
+                for (pm = find_word_not(pm, epm, uints(0)); pm != epm; pm = find_word_not(pm + 1, epm, uints(0))) {
+                    uints pbase = (pm - bm) * MASK_BITS - gbase;
 
-                for (; pm != epm; ++pm, pbase += MASK_BITS) {
-                    if (*pm == 0)
-                        continue;
-
-                    uints m = 1;
-                    for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
-                        if (*pm & m) {
-                            if (funccall_if(f, data[pbase + i], gbase + pbase + i))
-                                return const_cast<T*>(data) + (pbase + i);
-
-                            //update after rebase
-                            ints diffm = (ints)const_cast<uint_type const*>(_allocated.ptr()) - (ints)bm;
-                            if (diffm) {
-                                bm = ptr_byteshift(bm, diffm);
-                                em = const_cast<uint_type const*>(_allocated.ptre());
-                                pm = ptr_byteshift(pm, diffm);
-                                epm = ptr_byteshift(epm, diffm);
-                            }
+                    for (uints w = *pm; w; ) {
+                        uint8 i = lsb_bit_set(uint64(w));
+                        if (funccall_if(f, data[pbase + i], gbase + pbase + i))
+                            return const_cast<T*>(data) + (pbase + i);
+
+                        //update after rebase
+                        ints diffm = (ints)const_cast<uint_type const*>(_allocated.ptr()) - (ints)bm;
+                        if (diffm) {
+                            bm = ptr_byteshift(bm, diffm);
+                            em = const_cast<uint_type const*>(_allocated.ptre());
+                            pm = ptr_byteshift(pm, diffm);
+                            epm = ptr_byteshift(epm, diffm);
                         }
-                        else if ((*pm & ~(m - 1)) == 0)
-                            break;
+
+                        w = uints(*pm) & ~((uints(2) << i) - 1);
                     }
                 }
             }
@@ -1526,6 +1590,183 @@ public:
         return 0;
     }
 
+    ///Invoke a functor on each used item, running on chunks of items in parallel
+    //@param exec executor with parallel_for_range(uints first, uints last, uints grain, fn(uints first, uints last)) method, e.g. taskmaster
+    //@param f functor with ([const] T&) or ([const] T&, size_t index) arguments, invoked concurrently on different items
+    //@param grain minimum number of items processed by a single task, 0 to let the executor decide
+    //@note items must not be inserted or deleted during the iteration
+    //@note chunks are aligned to allocation pages, modifications are tracked in per-item changesets so parallel
+    // chunks never write to the same changeset entry
+    template<typename Exec, typename Func>
+    void parallel_for_each(Exec& exec, Func f, uints grain = 0) const
+    {
+        parallel_words(exec, _allocated.size(), grain, [&](uints wb, uints we) {
+            uint_type const* bm = const_cast<uint_type const*>(_allocated.ptr());
+            uint_type const* em = bm + we;
+
+            for (uint_type const* pm = find_word_not(bm + wb, em, uints(0)); pm != em; pm = find_word_not(pm + 1, em, uints(0))) {
+                uints base = (pm - bm) * MASK_BITS;
+
+                //items of a bitmask word never cross a page
+                T* data = const_cast<T*>(ptr(base));
+
+                for (uints w = *pm; w; w &= w - 1) {
+                    uint8 i = lsb_bit_set(uint64(w));
+                    funccall(f, data[i], base + i);
+                }
+            }
+        });
+    }
+
+    ///Invoke a functor on each item that was modified between two frames, running on chunks of items in parallel
+    //@param exec executor with parallel_for_range(uints first, uints last, uints grain, fn(uints first, uints last)) method, e.g. taskmaster
+    //@param bitplane_mask changeset bitplane mask (slotalloc_detail::changeset::bitplane_mask)
+    //@param f functor with ([const] T* ptr) or ([const] T* ptr, size_t index) arguments; ptr can be null if item was deleted
+    //@param grain minimum number of items processed by a single task, 0 to let the executor decide
+    //@note items must not be inserted or deleted during the iteration
+    template<typename Exec, typename Func, bool T1 = TRACKING, typename = std::enable_if_t<T1>>
+    void parallel_for_each_modified(Exec& exec, uint bitplane_mask, Func f, uints grain = 0) const
+    {
+        const bool all_modified = bitplane_mask > slotalloc_detail::changeset::BITPLANE_MASK;
+
+        auto chs = tracker_t::get_changeset();
+        DASSERT(chs->size() >= _allocated.size());
+
+        uints nitems = chs->size();
+        if coid_constexpr_if (!LINEAR) {
+            typedef typename storage_t::page page;
+            nitems = stdmin(nitems, this->_pages.size() * page::ITEMS);
+        }
+
+        const uints nmask = _allocated.size();
+
+        parallel_words(exec, align_to_chunks(nitems, MASK_BITS), grain, [&](uints wb, uints we) {
+            uint_type const* bm = const_cast<uint_type const*>(_allocated.ptr());
+            const changeset_t* pc = chs->ptr() + wb * MASK_BITS;
+            uints base = wb * MASK_BITS;
+
+            for (uints k = wb; k < we; ++k, base += MASK_BITS) {
+                uints m = k < nmask ? uints(bm[k]) : 0U;
+                uints n = stdmin(uints(MASK_BITS), nitems - base);
+
+                for (uints i = 0; i < n; ++i, m >>= 1, ++pc) {
+                    if (all_modified || (pc->mask & bitplane_mask) != 0) {
+                        T* pd = (m & 1) != 0 ? const_cast<T*>(ptr(base + i)) : nullptr;
+                        funccallp(f, pd, base + i);
+                    }
+                }
+            }
+        });
+    }
+
+    ///Find an element for which the predicate returns true, searching chunks of items in parallel
+    //@param exec executor with parallel_for_range(uints first, uints last, uints grain, fn(uints first, uints last)) method, e.g. taskmaster
+    //@param f functor with ([const] T&) or ([const] T&, size_t index) arguments, invoked concurrently on different items
+    //@param grain minimum number of items processed by a single task, 0 to let the executor decide
+    //@return pointer to one of the matching elements (not necessarily the one with the lowest id) or null
+    //@note items must not be inserted or deleted during the search
+    template<typename Exec, typename Func>
+    T* parallel_find_if(Exec& exec, Func f, uints grain = 0) const
+    {
+        std::atomic<T*> found(nullptr);
+
+        parallel_words(exec, _allocated.size(), grain, [&](uints wb, uints we) {
+            uint_type const* bm = const_cast<uint_type const*>(_allocated.ptr());
+            uint_type const* em = bm + we;
+
+            for (uint_type const* pm = find_word_not(bm + wb, em, uints(0)); pm != em; pm = find_word_not(pm + 1, em, uints(0))) {
+                //stop when another chunk found one
+                if (found.load(std::memory_order_relaxed))
+                    return;
+
+                uints base = (pm - bm) * MASK_BITS;
+                T* data = const_cast<T*>(ptr(base));
+
+                for (uints w = *pm; w; w &= w - 1) {
+                    uint8 i = lsb_bit_set(uint64(w));
+                    if (funccall_if(f, data[i], base + i)) {
+                        T* expected = nullptr;
+                        found.compare_exchange_strong(expected, data + i);
+                        return;
+                    }
+                }
+            }
+        });
+
+        return found.load();
+    }
+
+    ///Invoke a functor on runs of consecutive used items, with contiguous spans of the main array and all ext arrays
+    //@param f functor with (uints id, uints count, [const] T* items, [const] Es*... values) arguments, where each span
+    // starts at item id and all count items in it are allocated
+    //@note runs don't cross allocation pages
+    //@note items must not be inserted or deleted during the iteration
+    template<typename Func>
+    void for_each_run(Func f) const
+    {
+        uint_type const* bm = const_cast<uint_type const*>(_allocated.ptr());
+        uint_type const* em = const_cast<uint_type const*>(_allocated.ptre());
+
+        uints rid = 0, rn = 0;
+
+        for (uint_type const* pm = find_word_not(bm, em, uints(0)); pm != em; pm = find_word_not(pm + 1, em, uints(0))) {
+            uints base = (pm - bm) * MASK_BITS;
+            uints w = *pm;
+
+            while (w) {
+                uint8 b = lsb_bit_set(uint64(w));
+                uints nw = ~(w >> b);
+                uint8 len = nw ? lsb_bit_set(uint64(nw)) : uint8(MASK_BITS);
+                uints id = base + b;
+
+                if (rn && rid + rn == id && (LINEAR || id % SPAN_ITEMS != 0))
+                    rn += len;
+                else {
+                    if (rn)
+                        extarray_spans_(make_index_sequence<tracker_t::extarray_size>(), f, rid, rn);
+                    rid = id;
+                    rn = len;
+                }
+
+                w = b + len < MASK_BITS ? w & (UMAXS << (b + len)) : 0;
+            }
+        }
+
+        if (rn)
+            extarray_spans_(make_index_sequence<tracker_t::extarray_size>(), f, rid, rn);
+    }
+
+    ///Invoke a functor on each page that contains used items, with page spans of the main array and all ext arrays
+    //@param f functor with (uints id, uints count, const uints* mask, [const] T* items, [const] Es*... values) arguments,
+    // where each span starts at item id and holds count created items, bit i of the mask marks if item id + i is allocated
+    //@note suited for branchless processing of whole pages with masked results; pages hold 256 items
+    //@note items must not be inserted or deleted during the iteration
+    template<typename Func>
+    void for_each_page(Func f) const
+    {
+        static_assert(sizeof(uint_type) == sizeof(uints), "mask words must be plain uints");
+        static constexpr uints NMASK = SPAN_ITEMS / MASK_BITS;
+
+        if coid_constexpr_if (!LINEAR) {
+            typedef typename storage_t::page page;
+            static_assert(page::ITEMS == SPAN_ITEMS, "spans must match allocation pages");
+        }
+
+        uint_type const* bm = const_cast<uint_type const*>(_allocated.ptr());
+        uint_type const* em = const_cast<uint_type const*>(_allocated.ptre());
+        const uints ncreated = created();
+
+        for (uint_type const* pm = find_word_not(bm, em, uints(0)); pm != em; ) {
+            uints k = (pm - bm) / NMASK * NMASK;
+            uints id = k * MASK_BITS;
+            uints n = stdmin(uints(SPAN_ITEMS), ncreated - id);
+
+            extarray_spans_(make_index_sequence<tracker_t::extarray_size>(), f, id, n, reinterpret_cast<const uints*>(bm + k));
+
+            pm = bm + k + NMASK < em ? find_word_not(bm + k + NMASK, em, uints(0)) : em;
+        }
+    }
+
     ///Run on unused elements (freed elements in pool mode) until predicate returns true
     //@return pointer to the element or null
     //@param f functor with ([const] T&) or ([const] T&, size_t index) arguments
@@ -1544,22 +1785,16 @@ public:
             T* pd0 = const_cast<T*>(this->_array.ptr());
             uints n = this->_array.size();
 
-            for (; pm != em; ++pm, pbase += MASK_BITS) {
-                if (*pm == UMAXS)
-                    continue;
+            for (pm = find_word_not(pm, em, UMAXS); pm != em; pm = find_word_not(pm + 1, em, UMAXS)) {
+                pbase = (pm - bm) * MASK_BITS;
 
-                uints m = 1;
-                for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
-                    uints id = pbase + i;
+                for (uints w = ~uints(*pm); w; w &= w - 1) {
+                    uints id = pbase + lsb_bit_set(uint64(w));
                     if (id >= n)
                         break;
 
-                    if (!(*pm & m)) {
-                        if (funccall_if(f, pd0[id], id))
-                            return id;
-                    }
-                    //else if ((*pm & ~(m - 1)) == 0)
-                    //    break;
+                    if (funccall_if(f, pd0[id], id))
+                        return id;
                 }
             }
         }
@@ -1582,22 +1817,17 @@ public:
 
                 uints pbase = 0;
 
-                for (; pm != epm; ++pm, pbase += MASK_BITS) {
-                    if (*pm == UMAXS)
-                        continue;
+                for (pm = find_word_not(pm, epm, UMAXS); pm != epm; pm = find_word_not(pm + 1, epm, UMAXS)) {
+                    pbase = (pm - bm) * MASK_BITS - gbase;
 
-                    uints m = 1;
-                    for (int i = 0; i < MASK_BITS; ++i, m <<= 1) {
+                    for (uints w = ~uints(*pm); w; w &= w - 1) {
+                        uint8 i = lsb_bit_set(uint64(w));
                         uints id = gbase + pbase + i;
                         if (id >= this->_created)
                             break;
 
-                        if (!(*pm & m)) {
-                            if (funccall_if(f, d[pbase + i], id))
-                                return id;
-                        }
-                        //else if ((*pm & ~(m - 1)) == 0)
-                        //    break;
+                        if (funccall_if(f, d[pbase + i], id))
+                            return id;
                     }
                 }
             }
@@ -1793,6 +2023,13 @@ private:
         extarray_iterate_(make_index_sequence<tracker_t::extarray_size>(), fn);
     }
 
+    ///Helper to invoke a functor with spans of the main array and all ext arrays starting at given item
+    template<typename F, size_t... Index, typename... Args>
+    void extarray_spans_(index_sequence<Index...>, F& fn, uints id, uints n, Args... args) const {
+        fn(id, n, args..., const_cast<T*>(ptr(id)),
+            const_cast<typename std::tuple_element<Index, extarray_t>::type::value_type*>(std::get<Index>(this->_exts).ptr()) + id...);
+    }
+
 #ifdef __clang__
 #pragma clang diagnostic pop
 #endif
@@ -1824,11 +2061,14 @@ private:
     ///Return allocated slot
     T* alloc(uints* pid)
     {
+        if coid_constexpr_if (MULTI)
+            return alloc_multi(pid);
+
         DASSERT(_count < created());
 
         uint_type* p = _allocated.ptr();
         uint_type* e = _allocated.ptre();
-        for (; p != e && *p == UMAXS; ++p);
+        p += find_word_not<uint_type>(p, e, UMAXS) - p;
 
         if (p == e)
             *(p = _allocated.add()) = 0;
@@ -1902,8 +2142,14 @@ private:
                 return UMAXS;
         }
 
-        uint_type const* bm = _allocated.ptr();
-        uint_type const* em = _allocated.ptre();
+        //in multi mode the free range is searched in the mask of reserved slots
+        std::unique_lock<std::mutex> lock;
+        dynarray<uint_type>& claimed = claim_mask();
+        if coid_constexpr_if (MULTI)
+            lock = std::unique_lock<std::mutex>(this->_claim_mx);
+
+        uint_type const* bm = claimed.ptr();
+        uint_type const* em = claimed.ptre();
         uints id = 0;
         if coid_constexpr_if (LINEAR) {
             id = find_zero_bitrange(n, bm, em);
@@ -1948,7 +2194,11 @@ private:
         if (nslots > _allocated.size())
             _allocated.addc(nslots - _allocated.size());
 
-        set_bitrange(id, n, _allocated.ptr());
+        if coid_constexpr_if (MULTI) {
+            if (nslots > claimed.size())
+                claimed.addc(nslots - claimed.size());
+            set_bitrange(id, n, claimed.ptr());
+        }
 
         uints ncr = created();
         uints nadd = id + n > ncr ? id + n - ncr : 0;
@@ -1956,12 +2206,121 @@ private:
             expand<UNINIT>(nadd);
         *old = n - nadd;
 
+        set_bitrange(id, n, _allocated.ptr());
         _count += n;
 
         DASSERT(!TRACKING);
         return id;
     }
 
+    //@return bit mask used to find free slots
+    dynarray<uint_type>& claim_mask() {
+        if coid_constexpr_if (MULTI)
+            return this->_reserved;
+        else
+            return _allocated;
+    }
+
+    ///Allocate slot from the magazine of the current thread
+    T* alloc_multi(uints* pid)
+    {
+        uints id;
+        auto* m = this->lock_magazine();
+
+        if (m) {
+            if (m->n == 0)
+                m->n = uint(claim_multi(m->ids, this->BATCH));
+            id = m->ids[--m->n];
+            this->unlock_magazine(m);
+        }
+        else
+            claim_multi(&id, 1);
+
+        DASSERT(!get_bit(id));
+
+        this->set_modified(id);
+        set_bit(id);
+        ++_count;
+
+        if (pid)
+            *pid = id;
+
+        return ptr(id);
+    }
+
+    ///Return freed slot to the magazine of the current thread, draining half of a full magazine to the shared bitmask
+    void release_multi(uints id)
+    {
+        auto* m = this->lock_magazine();
+
+        if (m) {
+            if (m->n == this->MAGAZINE_SIZE) {
+                //release the oldest ones, recently freed slots are likely still in cache
+                for (uint i = 0; i < this->BATCH; ++i)
+                    clear_bit(this->_reserved, m->ids[i]);
+
+                m->n -= this->BATCH;
+                ::memmove(m->ids, m->ids + this->BATCH, m->n * sizeof(uints));
+            }
+
+            m->ids[m->n++] = id;
+            this->unlock_magazine(m);
+        }
+        else
+            clear_bit(this->_reserved, id);
+    }
+
+    ///Claim free slots from the shared bitmask, or append new ones if there are none
+    //@return number of claimed slots, at least 1
+    uints claim_multi(uints* ids, uints n)
+    {
+        std::lock_guard<std::mutex> lock(this->_claim_mx);
+
+        uint_type* b = this->_reserved.ptr();
+        uint_type* e = this->_reserved.ptre();
+        uints ncr = created();
+        uints k = 0;
+
+        //claimed bits are set only under the lock, released ones can get cleared concurrently
+        for (uint_type* p = b + (find_word_not<uint_type>(b, e, UMAXS) - b); p != e && k < n; ++p) {
+            uints base = (p - b) * MASK_BITS;
+            uints take = 0;
+
+            for (uints w = ~uints(*p); w && k < n; w &= w - 1) {
+                uint8 bit = lsb_bit_set(uint64(w));
+                if (base + bit >= ncr)
+                    break;
+
+                take |= uints(1) << bit;
+                ids[k++] = base + bit;
+            }
+
+            if (take)
+                p->fetch_or(take);
+        }
+
+        if (k == 0) {
+            //append new slots, handed out in ascending order
+            uints nslots = align_to_chunks(ncr + n, MASK_BITS);
+
+            if (nslots > _allocated.size())
+                _allocated.addc(nslots - _allocated.size());
+            if (nslots > this->_reserved.size())
+                this->_reserved.addc(nslots - this->_reserved.size());
+
+            set_bitrange(ncr, n, this->_reserved.ptr());
+
+            extarray_expand(n);
+            //pool mode expects the unused slots to be constructed
+            expand<!POOL>(n);
+
+            for (; k < n; ++k)
+                ids[k] = ncr + n - 1 - k;
+        }
+
+        return k;
+    }
+
     ///Append to a full array
     template <bool EXT_UNINIT>
     T* append(uints* pid = 0)
@@ -2057,28 +2416,22 @@ private:
         //frame aggregation:
         //      8844222211111111 (MSb to LSb)
 
+        static_assert(sizeof(changeset_t) == sizeof(uint16), "changeset must be a plain 16 bit mask");
+
         changeset_t* chb = changeset.ptr();
         changeset_t* che = changeset.ptre();
 
         //make space for a new frame
+        // shifted bits: (v << 1) & 0xaeff, aggregated bits: ((v << 1) | (v << 2)) & 0x5100
+        // groups of older frames are shifted only on frames divisible by their size
 
         bool b8 = (frame & 7) == 0;
         bool b4 = (frame & 3) == 0;
         bool b2 = (frame & 1) == 0;
 
-        for (changeset_t* ch = chb; ch < che; ++ch) {
-            uint16 v = ch->mask;
-            uint16 vs = (v << 1) & 0xaeff;                 //shifted bits
-            uint16 va = ((v << 1) | (v << 2)) & 0x5100;    //aggregated bits
-            uint16 vx = vs | va;
-
-            uint16 xc000 = (b8 ? vx : v) & (3 << 14);
-            uint16 x3000 = (b4 ? vx : v) & (3 << 12);
-            uint16 x0f00 = (b2 ? vx : v) & (15 << 8);
-            uint16 x00ff = vs & 0xff;
+        uint16 sel = uint16((b8 ? 0xc000 : 0) | (b4 ? 0x3000 : 0) | (b2 ? 0x0f00 : 0));
 
-            ch->mask = xc000 | x3000 | x0f00 | x00ff;
-        }
+        bitscan::best().update_changeset((uint16*)chb, (uint16*)che, sel);
     }
 };
 
@@ -2158,4 +2511,15 @@ using slotalloc_tracking_atomic_linear = slotalloc_base<T, slotalloc_mode::atomi
 template<class T, class ...Es>
 using slotalloc_tracking_linear = slotalloc_base<T, slotalloc_mode::tracking | slotalloc_mode::linear, Es...>;
 
+//multiple inserters and deleters
+
+template<class T, class ...Es>
+using slotalloc_multi = slotalloc_base<T, slotalloc_mode::atomic | slotalloc_mode::multi, Es...>;
+
+template<class T, class ...Es>
+using slotalloc_multi_pool = slotalloc_base<T, slotalloc_mode::pool | slotalloc_mode::atomic | slotalloc_mode::multi, Es...>;
+
+template<class T, class ...Es>
+using slotalloc_versioning_multi = slotalloc_base<T, slotalloc_mode::atomic | slotalloc_mode::multi | slotalloc_mode::versioning, Es...>;
+
 COID_NAMESPACE_END
@@ -61,6 +61,8 @@ void coid::test::slotalloc_bmp()
     test_data * d = new (data.add_uninit()) test_data("Hello world!", 342);
     uints item = data.get_item_id(d);
 
+    DASSERT(data.count() == handles.size() + 1);
+
     item = data.first();
     while (item != UINTS_MAX) {
         if (!data.is_valid(item)) {
@@ -39,24 +39,21 @@ public:
     /// have to call this in destructor because we have item allocated with add_uninit...
     void clear()
     {
-        uints id = first();
-        while (id != UINTS_MAX) {
-            get_item(id)->~T();
-            id = next(id);
-        }
+        T* items = _items.ptr();
+        for_each_set_bit(_bmp.ptr(), _bmp.ptre(), [items](uints id) {
+            items[id].~T();
+        });
 
         memset(_bmp.ptr(), 0, _bmp.byte_size());
     }
 
-    /// TODO use SSE for faster iteration to free block?
-    /// SSE can do 16bytes at once our array is aligned
+    /// full blocks are skipped by vectorized scan (bitscan kernels)
     T* add_uninit()
     {
-        // find empty block 32bit
+        // find block with a free slot
         BLOCK_TYPE * b = _bmp.ptr();
         BLOCK_TYPE * const be = _bmp.ptre();
-        while (b != be && *b == 0xffffffff)
-            b++;
+        b += find_word_not(b, be, BLOCK_TYPE(-1)) - b;
 
         if (b == be) {
             const uints size = _bmp.size();
@@ -109,11 +106,9 @@ public:
 
     uints first() const
     {
-        const BLOCK_TYPE * b = _bmp.ptr();
         const BLOCK_TYPE * const be = _bmp.ptre();
+        const BLOCK_TYPE * b = find_word_not(_bmp.ptr(), be, BLOCK_TYPE(0));
 
-        while (b != be && *b == 0)
-            ++b;
         if (b == be) return -1;
 
         uchar index = lsb_bit_set(*b);
@@ -140,9 +135,7 @@ public:
             : 32;
 
         if (index == 32) {
-            ++b;
-            while (b != be && *b == 0)
-                ++b;
+            b = find_word_not(b + 1, be, BLOCK_TYPE(0));
 
             if (b == be)
                 return -1;
@@ -155,6 +148,9 @@ public:
 
     uints size() const { return _items.size(); }
 
+    /// number of used slots
+    uints count() const { return population_count(_bmp.ptr(), _bmp.ptre()); }
+
 };
 
 namespace test
@@ -39,6 +39,7 @@
 * ***** END LICENSE BLOCK ***** */
 
 #include "../binstring.h"
+#include <mutex>
 
 COID_NAMESPACE_BEGIN
 
@@ -53,6 +54,7 @@ enum class slotalloc_mode
     atomic = 4,             //< ins/del operations are done atomically, one inserter, multiple deleters allowed
     tracking = 8,           //< adds data and methods needed for tracking the modifications
     versioning = 16,        //< adds data and methods needed to track version of array items, to handle cases when a new item occupies the same slot and old references to the slot should be invalid
+    multi = 32,             //< with atomic: multiple inserters and deleters, free slots cached in per-thread magazines (paged mode only)
 
     multikey = 128,         //< used by slothash for multi-key value support
 };
@@ -156,6 +158,70 @@ struct storage<true, ATOMIC, T>
 };
 
 #endif //COID_CONSTEXPR_IF
+
+
+///Per-thread caches of free slots, used in multi-producer mode
+template <bool MULTI>
+struct multi_base
+{
+    void swap_multi(multi_base& other) {}
+};
+
+template <>
+struct multi_base<true>
+{
+    static constexpr uint NMAGAZINES = 16;      //< threads beyond this count share magazines
+    static constexpr uint MAGAZINE_SIZE = 64;
+    static constexpr uint BATCH = MAGAZINE_SIZE / 2;   //< slots claimed or released at once
+
+    ///Free slot ids cached by a thread
+    struct magazine
+    {
+        std::atomic_bool busy;
+        uint n = 0;
+        uints ids[MAGAZINE_SIZE];
+
+        magazine() : busy(false)
+        {}
+    };
+
+    dynarray<std::atomic<uints>> _reserved;     //< slots held by items or cached in magazines
+    magazine _magazines[NMAGAZINES];
+    std::mutex _claim_mx;                       //< serializes claims from the shared bitmask and growth
+
+    ///Lock the magazine of the current thread
+    //@return magazine, or null if another thread sharing it holds it now
+    magazine* lock_magazine() {
+        static std::atomic_uint nthreads(0);
+        static thread_local uint order = nthreads++;
+
+        magazine& m = _magazines[order % NMAGAZINES];
+        return m.busy.exchange(true, std::memory_order_acquire) ? nullptr : &m;
+    }
+
+    static void unlock_magazine(magazine* m) {
+        m->busy.store(false, std::memory_order_release);
+    }
+
+    ///Forget all cached slots
+    //@note not thread safe
+    void reset_magazines() {
+        for (magazine& m : _magazines)
+            m.n = 0;
+    }
+
+    //@note not thread safe
+    void swap_multi(multi_base& other) {
+        _reserved.swap(other._reserved);
+
+        for (uint i = 0; i < NMAGAZINES; ++i) {
+            magazine& a = _magazines[i];
+            magazine& b = other._magazines[i];
+            std::swap(a.n, b.n);
+            std::swap(a.ids, b.ids);
+        }
+    }
+};
 
 
 template<class...Es>
@@ -0,0 +1,282 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#include "thread_cache.h"
+#include <atomic>
+#include <string.h>
+
+COID_NAMESPACE_BEGIN
+
+static const uint NCLASSES = thread_cache::MAX_CACHED / thread_cache::GRANULARITY + 1;
+static const uint NSLOTS = thread_cache::MAX_SPACES + 1;
+static const uint CLASS_BYTES = 8192;       //< max bytes kept per size class and thread
+static const uint BATCH = 64;               //< max blocks returned to mspace at once
+
+///Registered mspaces, slot 0 is the global dlmalloc space
+struct registry_slot {
+    std::atomic<mspace> msp;
+    std::atomic<uint> gen;                  //< bumped on each (de)registration, invalidates thread lists
+};
+
+static registry_slot _registry[NSLOTS];
+
+struct tc_list {
+    void* head;
+    uint count;
+};
+
+struct tc_space {
+    mspace msp;
+    uint gen;
+    tc_list lists[NCLASSES];
+};
+
+///Per-thread cache, trivial so that the access doesn't need a guard
+struct tc_thread {
+    int state;                              //< 0 uninitialized, 1 active, -1 thread exiting
+    tc_space spaces[NSLOTS];
+};
+
+static thread_local tc_thread _tc;
+
+///Flushes the cache on thread exit
+struct tc_guard {
+    ~tc_guard() {
+        thread_cache::flush();
+        _tc.state = -1;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static mspace global_space()
+{
+    static mspace gm = []() {
+        mspace m = dlmalloc_mspace();
+        _registry[0].msp = m;
+        return m;
+    }();
+    return gm;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static int find_slot(mspace msp)
+{
+    for (uint i = 0; i < NSLOTS; ++i)
+        if (_registry[i].msp.load(std::memory_order_relaxed) == msp)
+            return i;
+    return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///Max number of blocks kept in a size class list
+static uint list_max(uint c)
+{
+    uint n = CLASS_BYTES / (c * thread_cache::GRANULARITY);
+    return n < 8 ? 8 : (n > BATCH ? BATCH : n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///Get current thread's cache for registry slot, 0 when the thread is exiting
+static tc_space* local_space(int slot, mspace msp)
+{
+    tc_thread& t = _tc;
+    if (t.state <= 0) {
+        if (t.state < 0)
+            return 0;
+
+        static thread_local tc_guard guard;
+        (void)&guard;
+        t.state = 1;
+    }
+
+    tc_space& s = t.spaces[slot];
+    uint gen = _registry[slot].gen.load(std::memory_order_acquire);
+
+    if (s.msp != msp || s.gen != gen) {
+        //slot was reassigned, blocks cached for the previous mspace are dropped
+        ::memset(&s, 0, sizeof(s));
+        s.msp = msp;
+        s.gen = gen;
+    }
+
+    return &s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///Return n blocks from the list to the mspace, under a single lock
+static void release(mspace msp, tc_list& l, uint n)
+{
+    void* blocks[BATCH];
+
+    while (n > 0) {
+        uint k = n > BATCH ? BATCH : n;
+        for (uint i = 0; i < k; ++i) {
+            blocks[i] = l.head;
+            l.head = *(void**)l.head;
+        }
+
+        l.count -= k;
+        n -= k;
+
+        ::mspace_bulk_free(msp, blocks, k);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool thread_cache::enable(mspace msp)
+{
+    global_space();
+
+    if (find_slot(msp) >= 0)
+        return true;
+
+    for (uint i = 1; i < NSLOTS; ++i) {
+        mspace empty = 0;
+        if (_registry[i].msp.compare_exchange_strong(empty, msp)) {
+            ++_registry[i].gen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_cache::disable(mspace msp)
+{
+    int slot = find_slot(msp);
+    if (slot <= 0)
+        return;
+
+    //return own blocks, other threads drop theirs on next access
+    tc_space& s = _tc.spaces[slot];
+    if (s.msp == msp && s.gen == _registry[slot].gen) {
+        for (tc_list& l : s.lists)
+            release(msp, l, l.count);
+    }
+    ::memset(&s, 0, sizeof(s));
+
+    _registry[slot].msp = 0;
+    ++_registry[slot].gen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* thread_cache::alloc(mspace msp, size_t size)
+{
+    if (!msp)
+        msp = global_space();
+
+    if (size <= MAX_CACHED) {
+        uint c = size ? uint((size + GRANULARITY - 1) / GRANULARITY) : 1;
+        int slot = find_slot(msp);
+        tc_space* s = slot >= 0 ? local_space(slot, msp) : 0;
+
+        if (s) {
+            tc_list& l = s->lists[c];
+            void* p = l.head;
+            if (p) {
+                l.head = *(void**)p;
+                --l.count;
+#ifdef _DEBUG
+                ::memset(p, 0xcd, size);
+#endif
+                return p;
+            }
+
+            //allocate the full class size, so that the block returns to the same class when freed
+            return ::mspace_malloc(msp, c * GRANULARITY);
+        }
+    }
+
+    return ::mspace_malloc(msp, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_cache::free(void* p)
+{
+    if (!p)
+        return;
+
+    size_t u = ::mspace_usable_size(p);
+
+    if (u >= GRANULARITY && u < MAX_CACHED + GRANULARITY && !::mspace_virtual_size(p)) {
+        mspace msp = ::mspace_from_ptr(p);
+        global_space();
+
+        int slot = find_slot(msp);
+        tc_space* s = slot >= 0 ? local_space(slot, msp) : 0;
+
+        if (s) {
+            uint c = uint(u / GRANULARITY);
+            tc_list& l = s->lists[c];
+
+            *(void**)p = l.head;
+            l.head = p;
+
+            uint lmax = list_max(c);
+            if (++l.count > lmax)
+                release(msp, l, lmax / 2);
+            return;
+        }
+    }
+
+    ::mspace_free(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void thread_cache::flush()
+{
+    tc_thread& t = _tc;
+    if (t.state <= 0)
+        return;
+
+    for (uint i = 0; i < NSLOTS; ++i) {
+        tc_space& s = t.spaces[i];
+        if (!s.msp)
+            continue;
+
+        //blocks of mspaces that were disabled in the meantime are just dropped
+        if (_registry[i].msp == s.msp && _registry[i].gen == s.gen) {
+            for (tc_list& l : s.lists)
+                release(s.msp, l, l.count);
+        }
+
+        ::memset(&s, 0, sizeof(s));
+    }
+}
+
+COID_NAMESPACE_END
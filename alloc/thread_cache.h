@@ -0,0 +1,82 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_THREAD_CACHE__HEADER_FILE__
+#define __COID_COMM_THREAD_CACHE__HEADER_FILE__
+
+#include "../namespace.h"
+#include "../commtypes.h"
+#include "_malloc.h"
+
+COID_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+///Thread caching front end for small dlmalloc/mspace allocations
+/// Freed small blocks are kept in per-thread size class lists and handed out again without
+/// taking the mspace lock, overflowing lists are returned to their mspace in a single batch.
+/// Cached blocks stay allocated in their mspace, so mspace_usable_size, realloc_in_place,
+/// mspace_from_ptr and memtrack accounting work on them unchanged.
+/// Blocks can be freed by any thread, or directly with mspace_free/dlfree.
+struct thread_cache
+{
+    static const uint GRANULARITY = 16;     //< size class granularity
+    static const uint MAX_CACHED = 512;     //< max usable size of a cached block
+    static const uint MAX_SPACES = 4;       //< max mspaces that can be cached, besides the dlmalloc one
+
+    ///Enable caching of blocks from given mspace
+    //@return false if there are no free registry slots left
+    static bool enable(mspace msp);
+
+    ///Disable caching of blocks from given mspace, must be called before destroy_mspace
+    //@note blocks cached by other threads are dropped, not returned to the mspace
+    static void disable(mspace msp);
+
+    ///Allocate memory block
+    //@param msp mspace to allocate from, 0 for the global dlmalloc space
+    //@return allocated block, 0 if out of memory
+    static void* alloc(mspace msp, size_t size);
+
+    ///Free memory block allocated from any mspace
+    static void free(void* p);
+
+    ///Return blocks cached by the current thread to their mspaces
+    static void flush();
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_THREAD_CACHE__HEADER_FILE__
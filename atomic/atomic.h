@@ -85,6 +85,8 @@
 
 namespace atomic {
 
+///Size of the cache line, used to pad frequently modified shared members
+static const int cache_line_size = 64;
 
 
 inline coid::int32 inc(volatile coid::int32 * ptr)
@@ -32,248 +32,477 @@
  *
  * ***** END LICENSE BLOCK ***** */
 
+
 #ifndef __COMM_ATOMIC_QUEUE_BASE_H__
 #define __COMM_ATOMIC_QUEUE_BASE_H__
 
 #include "atomic.h"
-#include "basic_pool.h"
-#include "../ref.h"
-#include "../ref_helpers.h"
-
-#include "../list.h"
-#include "../sync/mutex.h"
-#include "../sync/guard.h"
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace atomic {
 
-/*
-#ifdef SYSTYPE_64
-	typedef coid::uint64 tag_t;
-#else 
-	typedef coid::uint32 tag_t;
-#endif
+/**
+    Bounded lock-free MPMC FIFO queue.
 
-/// lock-free double linked list FIFO queue don't use with T as ref or iref use queue_r instead
-/// beacuse node will hold reference until it is used again... maybe it can be solved by trait...
+    Items are stored in a preallocated ring of cells, each cell carries a sequence number telling
+    producers and consumers whether it's free or filled in the current lap around the ring
+    (D. Vyukov's algorithm). Push and pop take a single CAS on their position in the common case.
+**/
 template <class T>
+class bounded_queue
+{
+public:
+
+    //@param capacity max number of items, rounded up to a power of two
+    explicit bounded_queue(coid::uints capacity = 1024)
+    {
+        coid::uints cap = 2;
+        while (cap < capacity)
+            cap <<= 1;
+
+        _mask = cap - 1;
+        _cells = new cell[cap];
+        for (coid::uints i = 0; i < cap; ++i)
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+
+        _enqueue_pos.store(0, std::memory_order_relaxed);
+        _dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+
+    ~bounded_queue()
+    {
+        coid::uints e = _enqueue_pos.load(std::memory_order_relaxed);
+        for (coid::uints i = _dequeue_pos.load(std::memory_order_relaxed); i != e; ++i)
+            _cells[i & _mask].item()->~T();
+
+        delete[] _cells;
+    }
+
+    ///Push item to the queue
+    //@return false if the queue was full
+    bool push(const T& item) { return emplace(item); }
+
+    ///Push item to the queue
+    //@return false if the queue was full
+    bool push(T&& item) { return emplace(std::forward<T>(item)); }
+
+    ///Pop item from the queue
+    //@return false if the queue was empty
+    bool pop(T& item)
+    {
+        cell* c;
+        coid::uints pos = _dequeue_pos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            c = &_cells[pos & _mask];
+            coid::uints seq = c->seq.load(std::memory_order_acquire);
+            coid::ints dif = coid::ints(seq) - coid::ints(pos + 1);
+
+            if (dif == 0) {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+        }
+
+        T* p = c->item();
+        item = std::move(*p);
+        p->~T();
+
+        c->seq.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    //@return true if the queue was empty at the time of the call
+    bool is_empty() const {
+        return _dequeue_pos.load(std::memory_order_acquire) >= _enqueue_pos.load(std::memory_order_acquire);
+    }
+
+    coid::uints capacity() const { return _mask + 1; }
+
+private:
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator = (const bounded_queue&) = delete;
+
+    struct cell
+    {
+        std::atomic<coid::uints> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+        T* item() { return reinterpret_cast<T*>(&data); }
+    };
+
+    template <class V>
+    bool emplace(V&& v)
+    {
+        cell* c;
+        coid::uints pos = _enqueue_pos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            c = &_cells[pos & _mask];
+            coid::uints seq = c->seq.load(std::memory_order_acquire);
+            coid::ints dif = coid::ints(seq) - coid::ints(pos);
+
+            if (dif == 0) {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+        }
+
+        new(c->item()) T(std::forward<V>(v));
+
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    coid::uint8 _pad0[cache_line_size];
+
+    cell* _cells;
+    coid::uints _mask;
+    coid::uint8 _pad1[cache_line_size - sizeof(cell*) - sizeof(coid::uints)];
+
+    std::atomic<coid::uints> _enqueue_pos;
+    coid::uint8 _pad2[cache_line_size - sizeof(std::atomic<coid::uints>)];
+
+    std::atomic<coid::uints> _dequeue_pos;
+    coid::uint8 _pad3[cache_line_size - sizeof(std::atomic<coid::uints>)];
+};
+
+
+/**
+    Unbounded lock-free MPMC FIFO queue, a drop-in replacement for coid::queue.
+
+    Items are stored in a linked list of fixed-size segments instead of per-item nodes. Producers
+    claim slots in the tail segment and append a new segment once it's full, consumers advance
+    through the head segment and unlink it once it's drained.
+
+    Drained segments can still be referenced by threads that were inside push/pop at the time.
+    Operations are counted in one of two alternating epochs, a segment is released once the threads
+    of the epoch it was retired in are done, which doesn't need the queue to go idle. The last
+    released segment is kept for reuse.
+
+    Pop returns false also when the next item has been claimed by a producer that hasn't finished
+    writing it yet.
+**/
+template <class T, int SEGMENT = 256>
 class queue
 {
-protected:
-    struct node;
+public:
 
-    //! helper pointer with tag
-    atomic_align struct ptr_t
+    queue()
     {
-    #ifdef SYSTYPE_64
-	    typedef coid::uint64 tag_t;
-    #else 
-	    typedef coid::uint32 tag_t;
-    #endif
+        _epoch.store(1, std::memory_order_relaxed);
+        _nactive[0].store(0, std::memory_order_relaxed);
+        _nactive[1].store(0, std::memory_order_relaxed);
+        _retired.store(0, std::memory_order_relaxed);
+        _spare.store(0, std::memory_order_relaxed);
+
+        segment* s = alloc_segment();
+        _head.store(s, std::memory_order_relaxed);
+        _tail.store(s, std::memory_order_relaxed);
+    }
+
+    ~queue()
+    {
+        segment* s = _head.load(std::memory_order_relaxed);
+        while (s) {
+            segment* n = s->next.load(std::memory_order_relaxed);
+            s->destroy_items();
+            delete s;
+            s = n;
+        }
 
-	    union {
-		    struct {
-			    node * volatile _ptr;
-			    volatile tag_t _tag;
-		    };
-		    struct {
-			    volatile coid::int64 _data;
-    #ifdef SYSTYPE_64
-			    volatile coid::int64 _datah;
-    #endif
-		    };
-	    };
+        s = _retired.load(std::memory_order_relaxed);
+        while (s) {
+            segment* n = s->retired_next;
+            delete s;
+            s = n;
+        }
+
+        delete _spare.load(std::memory_order_relaxed);
+    }
 
-	    explicit ptr_t(node * const p) : _ptr(p) , _tag(0) {}
+    ///Push item to the end of the queue
+    void push(const T& item) { emplace(item); }
 
-	    ptr_t(node * const p, const tag_t t) : _ptr(p), _tag(t) {}
+    ///Push item to the end of the queue
+    void push(T&& item) { emplace(std::forward<T>(item)); }
 
-	    ptr_t() : _ptr(0) , _tag(0) {}
+    ///Pop item from the front of the queue
+    //@return false if there was no item ready
+    bool pop(T& item)
+    {
+        op_scope scope(*this);
+
+        for (;;) {
+            segment* h = _head.load();
+            coid::uints pos = h->deq.load(std::memory_order_relaxed);
+
+            while (pos < SEGMENT) {
+                if (pos >= h->enq.load(std::memory_order_acquire))
+                    return false;
+
+                cell& c = h->cells[pos];
+                if (!c.ready.load(std::memory_order_acquire))
+                    return false;
+
+                if (h->deq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = c.item();
+                    item = std::move(*p);
+                    p->~T();
+                    return true;
+                }
+            }
+
+            //segment drained, move to the next one
+            segment* next = h->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+
+            if (_head.compare_exchange_strong(h, next)) {
+                //tail may still point to the drained segment
+                segment* t = h;
+                _tail.compare_exchange_strong(t, next);
+
+                retire(h);
+            }
+        }
+    }
 
-	    void set(node * const p, const tag_t t) { _ptr=p; _tag=t; }
+    //@return true if the queue was empty at the time of the call
+    bool is_empty() const
+    {
+        op_scope scope(*this);
 
-	    bool operator == (const ptr_t & p) { return (_ptr==p._ptr) && (_tag==p._tag); }
+        segment* s = _head.load();
+        while (s) {
+            coid::uints pos = s->deq.load(std::memory_order_acquire);
+            if (pos < s->enq.load(std::memory_order_acquire))
+                return false;
+            if (pos < SEGMENT)
+                return true;
 
-	    bool operator != (const ptr_t & p) { return !operator == (p); }
+            s = s->next.load(std::memory_order_acquire);
+        }
 
-	    ptr_t(const ptr_t &p) { *this=p; }
+        return true;
+    }
 
-	    void operator=(const ptr_t &p) {
-    #ifdef SYSTYPE_64
-		    __movsq((uint64*)&_data,(uint64*)&p._data,2);
-    #else
-		    _data=p._data;
-    #endif
-	    }
+    ///Pop and discard all items
+    void clear() {
+        T tmp;
+        while (pop(tmp));
+    }
 
+private:
+
+    queue(const queue&) = delete;
+    queue& operator = (const queue&) = delete;
+
+    struct cell
+    {
+        std::atomic<bool> ready;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+        T* item() { return reinterpret_cast<T*>(&data); }
     };
 
-    struct node
+    struct segment
     {
-	    ptr_t _next;
-	    ptr_t _prev;
-        T _item;
-        node* _next_basic_pool;
-
-	    node() 
-            : _next(0)
-            , _prev(0)
-            , _item()
-            , _next_basic_pool(0) 
-        {}
+        std::atomic<coid::uints> enq;       //< next slot to be claimed by a producer
+        coid::uint8 _pad0[cache_line_size - sizeof(std::atomic<coid::uints>)];
 
-	    node(const bool) 
-            : _next(0)
-            , _prev(0)
-            , _item()
-            , _next_basic_pool((node*)-1) 
-        {}
+        std::atomic<coid::uints> deq;       //< next slot to be consumed
+        coid::uint8 _pad1[cache_line_size - sizeof(std::atomic<coid::uints>)];
+
+        std::atomic<segment*> next;
+        segment* retired_next;
+        coid::uints retire_epoch;           //< epoch in which the segment was unlinked
 
-        bool is_dummy() const { return _next_basic_pool==(node*)-1; }
+        cell cells[SEGMENT];
 
-        void set_dummy() { _next_basic_pool=(node*)-1; }
+        void reset() {
+            enq.store(0, std::memory_order_relaxed);
+            deq.store(0, std::memory_order_relaxed);
+            next.store(0, std::memory_order_relaxed);
+            retired_next = 0;
 
-        void operator = (const node &n) {
-            _next=n._next;
-            _prev=n._prev;
-            _item=n.item;
-            _next_basic_pool=n._next_basic_pool;
+            for (int i = 0; i < SEGMENT; ++i)
+                cells[i].ready.store(false, std::memory_order_relaxed);
+        }
+
+        void destroy_items() {
+            coid::uints e = enq.load(std::memory_order_relaxed);
+            for (coid::uints i = deq.load(std::memory_order_relaxed); i < e && i < SEGMENT; ++i)
+                if (cells[i].ready.load(std::memory_order_relaxed))
+                    cells[i].item()->~T();
         }
     };
 
-public:
-	//! last pushed item
-	ptr_t _tail;
+    ///Marks a thread running an operation that can access segments
+    struct op_scope
+    {
+        const queue& q;
+        coid::uints epoch;
+
+        op_scope(const queue& q) : q(q), epoch(q.enter())
+        {}
+
+        ~op_scope() {
+            q.leave(epoch);
+        }
+    };
 
-	//! first pushed item
-	ptr_t _head;
+    template <class V>
+    void emplace(V&& v)
+    {
+        op_scope scope(*this);
+
+        for (;;) {
+            segment* t = _tail.load();
+            coid::uints pos = t->enq.load(std::memory_order_relaxed);
+
+            while (pos < SEGMENT) {
+                if (t->enq.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell& c = t->cells[pos];
+                    new(c.item()) T(std::forward<V>(v));
+                    c.ready.store(true, std::memory_order_release);
+                    return;
+                }
+            }
+
+            //segment full, append a new one or help to move the tail
+            segment* next = t->next.load(std::memory_order_acquire);
+            if (!next) {
+                segment* s = alloc_segment();
+                if (t->next.compare_exchange_strong(next, s))
+                    next = s;
+                else
+                    free_segment(s);
+            }
+
+            _tail.compare_exchange_strong(t, next);
+        }
+    }
 
-protected:
-	basic_pool<node> _node_pool;
+    segment* alloc_segment() const
+    {
+        segment* s = _spare.exchange(0);
+        if (!s)
+            s = new segment;
 
-protected:
+        s->reset();
+        return s;
+    }
 
-	//! optimistic fix called when prev pointer is not set
-	void fixList(ptr_t & tail, ptr_t & head)
-	{
-		ptr_t curNode, curNodeNext, nextNodePrev;
+    void free_segment(segment* s) const
+    {
+        segment* expected = 0;
+        if (!_spare.compare_exchange_strong(expected, s))
+            delete s;
+    }
 
-		curNode = tail;
+    void retire(segment* s)
+    {
+        //read after unlinking, threads entering a later epoch can't reach the segment
+        s->retire_epoch = _epoch.load();
 
-		while ((head == _head) && (curNode != head)) {
-			curNodeNext = curNode._ptr->_next;
+        segment* head = _retired.load(std::memory_order_relaxed);
+        do {
+            s->retired_next = head;
+        }
+        while (!_retired.compare_exchange_weak(head, s));
+    }
 
-			if (curNodeNext._tag != curNode._tag)
-				return;
+    ///Start of an operation, counted in the current epoch
+    //@return epoch to pass to leave()
+    coid::uints enter() const
+    {
+        for (;;) {
+            coid::uints e = _epoch.load();
+            _nactive[e & 1].fetch_add(1);
 
-			nextNodePrev = curNodeNext._ptr->_prev;
-			if (nextNodePrev != ptr_t(curNode._ptr, curNode._tag - 1))
-				curNodeNext._ptr->_prev.set(curNode._ptr, curNode._tag - 1);
+            //the epoch may have moved on before the thread got counted
+            if (_epoch.load() == e)
+                return e;
 
-			curNode.set(curNodeNext._ptr, curNode._tag - 1);
-		};
-	}
+            _nactive[e & 1].fetch_sub(1);
+        }
+    }
 
-public:
-	//!	constructor
-	queue() : _tail(new node(true)) , _head(_tail._ptr) , _node_pool() {}
-
-	//!	destructor also clear node pool
-	~queue() { node* p; while ((p = _node_pool.pop()) != 0) delete p; } 
-
-protected:
-
-	inline bool internal_b_cas( volatile coid::int64 *ptr, const volatile coid::int64 *val, volatile coid::int64 *cmp )
-	{
-#ifdef SYSTYPE_64
-		return atomic::b_cas128(
-			ptr,
-			*(val+1),
-			*val,
-			const_cast<coid::int64*>(cmp));
-#else
-		return atomic::b_cas(ptr,*val,*cmp);
-#endif
-	}
+    ///End of an operation, frees retired segments that no other thread can hold
+    void leave(coid::uints e) const
+    {
+        _nactive[e & 1].fetch_sub(1);
 
-public:
+        if (_retired.load(std::memory_order_relaxed))
+            reclaim();
+    }
+
+    ///Release segments retired before the current epoch once no thread of the previous epoch is
+    /// inside, then advance the epoch so that the ones retired in the current epoch can follow
+    void reclaim() const
+    {
+        coid::uints e = _epoch.load();
+
+        //the epoch advances only after the one before it was done, so this covers all older threads
+        if (_nactive[(e + 1) & 1].load() != 0)
+            return;
+
+        segment* list = _retired.exchange(0);
+        segment* keep = 0;
+        segment* last = 0;
+
+        while (list) {
+            segment* n = list->retired_next;
+            if (list->retire_epoch < e)
+                free_segment(list);
+            else {
+                if (!keep)
+                    last = list;
+                list->retired_next = keep;
+                keep = list;
+            }
+            list = n;
+        }
+
+        if (keep) {
+            //put back
+            segment* head = _retired.load(std::memory_order_relaxed);
+            do {
+                last->retired_next = head;
+            }
+            while (!_retired.compare_exchange_weak(head, keep));
+        }
+
+        _epoch.compare_exchange_strong(e, e + 1);
+    }
+
+    coid::uint8 _pad0[cache_line_size];
+
+    std::atomic<segment*> _head;
+    coid::uint8 _pad1[cache_line_size - sizeof(std::atomic<segment*>)];
+
+    std::atomic<segment*> _tail;
+    coid::uint8 _pad2[cache_line_size - sizeof(std::atomic<segment*>)];
 
-    /// push item to queue
-	void push(T& item,const bool take=false)
-	{
-		ptr_t tail;
-        node* newnode=_node_pool.pop_new();
-
-        if( !take )
-            newnode->_item=item;
-        else
-            coid::queue_helper_trait<T>::take(newnode->_item,item);
-
-		newnode->_prev.set(0, 0);
-
-		for (;;) {
-			tail = _tail;
-			newnode->_next.set(tail._ptr, tail._tag + 1);
-			ptr_t np(newnode, tail._tag + 1);
-			if (internal_b_cas(&_tail._data, &np._data, &tail._data)) {
-				tail._ptr->_prev.set(newnode, tail._tag);
-				return;
-			}
-		}
-	}
-
-    /// pop item from queue returns false when queue is empty
-	bool pop(T& item)
-	{
-		ptr_t head, tail;
-		node * dummy;
-
-		for( ;; ) {
-			head=_head;
-			tail=_tail;
-			if( head==_head ) {
-				if( !head._ptr->is_dummy() ) {
-					if( tail!=head ) {
-						if( head._ptr->_prev._tag!=head._tag ) {
-							fixList(tail,head);
-							continue;
-						}
-					} 
-					else {
-						dummy=_node_pool.pop_new();
-                        dummy->set_dummy();
-
-						dummy->_next.set( tail._ptr,tail._tag+1 );
-						ptr_t np( dummy,tail._tag+1 );
-						if( internal_b_cas( &_tail._data,&np._data,&tail._data ) )
-							head._ptr->_prev.set(dummy,tail._tag);
-						else
-							_node_pool.push(dummy);
-						continue;
-					}
-					ptr_t np( head._ptr->_prev._ptr,head._tag+1 );
-					if( internal_b_cas( &_head._data,&np._data,&head._data ) ) {
-                        coid::queue_helper_trait<T>::take(item,head._ptr->_item);
-                        _node_pool.push(head._ptr);
-						return true;
-					}
-				} 
-				else {
-					if( tail._ptr==head._ptr )
-						return false;
-					else {	
-						if( head._ptr->_prev._tag!=head._tag ) {
-							fixList( tail,head );
-							continue;
-						}
-						ptr_t np(head._ptr->_prev._ptr,head._tag+1);
-						if( internal_b_cas( &_head._data,&np._data,&head._data ) )
-							_node_pool.push( head._ptr );
-					}
-				} 
-			}
-		}
-	}
-};*/
+    mutable std::atomic<coid::uints> _epoch;        //< current epoch of push/pop operations
+    mutable std::atomic<int> _nactive[2];           //< threads inside push/pop, by epoch parity
+    mutable std::atomic<segment*> _retired;         //< drained segments waiting to be released
+    mutable std::atomic<segment*> _spare;           //< released segment kept for reuse
+    coid::uint8 _pad3[cache_line_size - sizeof(std::atomic<coid::uints>) - 2 * sizeof(std::atomic<int>) - 2 * sizeof(std::atomic<segment*>)];
+};
 
 } // end of namespace atomic
 
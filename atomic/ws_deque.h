@@ -0,0 +1,208 @@
+/* ***** BEGIN LICENSE BLOCK *****
+* Version: MPL 1.1/GPL 2.0/LGPL 2.1
+*
+* The contents of this file are subject to the Mozilla Public License Version
+* 1.1 (the "License"); you may not use this file except in compliance with
+* the License. You may obtain a copy of the License at
+* http://www.mozilla.org/MPL/
+*
+* Software distributed under the License is distributed on an "AS IS" basis,
+* WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+* for the specific language governing rights and limitations under the
+* License.
+*
+* The Original Code is COID/comm module.
+*
+* The Initial Developer of the Original Code is
+* Outerra.
+* Portions created by the Initial Developer are Copyright (C) 2017
+* the Initial Developer. All Rights Reserved.
+*
+* Contributor(s):
+* Brano Kemen
+*
+* Alternatively, the contents of this file may be used under the terms of
+* either the GNU General Public License Version 2 or later (the "GPL"), or
+* the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+* in which case the provisions of the GPL or the LGPL are applicable instead
+* of those above. If you wish to allow use of your version of this file only
+* under the terms of either the GPL or the LGPL, and not to allow others to
+* use your version of this file under the terms of the MPL, indicate your
+* decision by deleting the provisions above and replace them with the notice
+* and other provisions required by the GPL or the LGPL. If you do not delete
+* the provisions above, a recipient may use your version of this file under
+* the terms of any one of the MPL, the GPL or the LGPL.
+*
+* ***** END LICENSE BLOCK ***** */
+
+#ifndef __COMM_ATOMIC_WS_DEQUE_H__
+#define __COMM_ATOMIC_WS_DEQUE_H__
+
+#include "atomic.h"
+#include <atomic>
+#include <type_traits>
+
+namespace atomic {
+
+/**
+    Chase-Lev work-stealing deque.
+
+    The owner thread pushes and pops items at the bottom end, any other thread can steal items
+    from the top end. Push and pop are wait-free in the common case, steal takes a single CAS.
+    The ring buffer grows when full; retired buffers are kept until the deque is destroyed,
+    since a concurrent thief may still be reading from them.
+
+    T must be trivially copyable, typically a pointer.
+**/
+template <class T>
+class ws_deque
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ws_deque item must be trivially copyable");
+
+public:
+
+    //@param capacity initial capacity, rounded up to a power of two
+    explicit ws_deque(coid::uints capacity = 256)
+    {
+        coid::uints cap = 16;
+        while (cap < capacity)
+            cap <<= 1;
+
+        _top.store(0, std::memory_order_relaxed);
+        _bottom.store(0, std::memory_order_relaxed);
+        _array.store(new ring(cap, 0), std::memory_order_relaxed);
+    }
+
+    ~ws_deque()
+    {
+        ring* r = _array.load(std::memory_order_relaxed);
+        while (r) {
+            ring* p = r->prev;
+            delete r;
+            r = p;
+        }
+    }
+
+    ///Push item to the bottom end
+    //@note owner thread only
+    void push(const T& item)
+    {
+        coid::int64 b = _bottom.load(std::memory_order_relaxed);
+        coid::int64 t = _top.load(std::memory_order_acquire);
+        ring* r = _array.load(std::memory_order_relaxed);
+
+        if (b - t > coid::int64(r->mask))
+            r = grow(r, t, b);
+
+        r->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    ///Pop item from the bottom end (LIFO order)
+    //@note owner thread only
+    //@return false if the deque was empty
+    bool pop(T& item)
+    {
+        coid::int64 b = _bottom.load(std::memory_order_relaxed) - 1;
+        ring* r = _array.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        coid::int64 t = _top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            //empty
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = r->get(b);
+
+        if (t == b) {
+            //last item, race against thieves
+            bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    ///Steal item from the top end (FIFO order)
+    //@note can be called from any thread
+    //@return false if the deque was empty or another thread won the race for the item
+    bool steal(T& item)
+    {
+        coid::int64 t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        coid::int64 b = _bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return false;
+
+        ring* r = _array.load(std::memory_order_acquire);
+        item = r->get(t);
+
+        return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    //@return approximate number of items in the deque
+    coid::uints size() const {
+        coid::int64 b = _bottom.load(std::memory_order_relaxed);
+        coid::int64 t = _top.load(std::memory_order_relaxed);
+        return b > t ? coid::uints(b - t) : 0;
+    }
+
+    bool is_empty() const { return size() == 0; }
+
+private:
+
+    ws_deque(const ws_deque&) = delete;
+    ws_deque& operator = (const ws_deque&) = delete;
+
+    struct ring
+    {
+        coid::uints mask;
+        ring* prev;                     //< retired smaller ring
+        std::atomic<T>* items;
+
+        ring(coid::uints capacity, ring* prev)
+            : mask(capacity - 1)
+            , prev(prev)
+            , items(new std::atomic<T>[capacity])
+        {}
+
+        ~ring() {
+            delete[] items;
+        }
+
+        T get(coid::int64 i) const {
+            return items[coid::uints(i) & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(coid::int64 i, const T& v) {
+            items[coid::uints(i) & mask].store(v, std::memory_order_relaxed);
+        }
+    };
+
+    ring* grow(ring* r, coid::int64 t, coid::int64 b)
+    {
+        ring* nr = new ring((r->mask + 1) << 1, r);
+        for (coid::int64 i = t; i < b; ++i)
+            nr->put(i, r->get(i));
+
+        _array.store(nr, std::memory_order_release);
+        return nr;
+    }
+
+    std::atomic<coid::int64> _top;
+    coid::uint8 _pad0[cache_line_size - sizeof(std::atomic<coid::int64>)];
+
+    std::atomic<coid::int64> _bottom;
+    std::atomic<ring*> _array;
+    coid::uint8 _pad1[cache_line_size - sizeof(std::atomic<coid::int64>) - sizeof(std::atomic<ring*>)];
+};
+
+} // end of namespace atomic
+
+#endif // __COMM_ATOMIC_WS_DEQUE_H__
@@ -0,0 +1,507 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#include "asyncfilestream.h"
+#include "../singleton.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+
+#ifdef SYSTYPE_WIN
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+# include <io.h>
+# include <share.h>
+#else
+# include <errno.h>
+# include <unistd.h>
+#endif
+
+#ifdef SYSTYPE_LINUX
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+# if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+#  define COMM_ASYNCFILE_URING
+# endif
+#endif
+
+COID_NAMESPACE_BEGIN
+
+#ifdef COMM_ASYNCFILE_URING
+
+////////////////////////////////////////////////////////////////////////////////
+///io_uring backend, submitting from the calling threads and reaping completions in a dedicated thread
+class uring_file_io : public async_file_io
+{
+public:
+
+    enum { ENTRIES = 256 };
+
+    uring_file_io()
+    {
+        io_uring_params p;
+        ::memset(&p, 0, sizeof(p));
+
+        _fd = (int)::syscall(__NR_io_uring_setup, ENTRIES, &p);
+        if (_fd < 0)
+            return;
+
+        //plain read and write opcodes came along with the fast poll feature
+        if (!(p.features & IORING_FEAT_FAST_POLL) || !map_rings(p)) {
+            unmap_rings();
+            ::close(_fd);
+            _fd = -1;
+            return;
+        }
+
+        _reaper = std::thread(&uring_file_io::reap, this);
+    }
+
+    ~uring_file_io()
+    {
+        if (_fd < 0)
+            return;
+
+        //null request stops the reaper
+        push(0);
+        _reaper.join();
+
+        unmap_rings();
+        ::close(_fd);
+    }
+
+    bool is_valid() const { return _fd >= 0; }
+
+    virtual void submit( async_file_request* req ) override
+    {
+        DASSERT(req);
+        push(req);
+    }
+
+    virtual const char* name() const override { return "io_uring"; }
+
+private:
+
+    int _fd = -1;
+
+    void* _sq_ring = 0;
+    void* _cq_ring = 0;
+    uints _sq_ring_size = 0;
+    uints _cq_ring_size = 0;
+    io_uring_sqe* _sqes = 0;
+    uints _sqes_size = 0;
+
+    uint* _sq_head = 0;
+    uint* _sq_tail = 0;
+    uint* _sq_mask = 0;
+    uint* _sq_array = 0;
+    uint* _cq_head = 0;
+    uint* _cq_tail = 0;
+    uint* _cq_mask = 0;
+    io_uring_cqe* _cqes = 0;
+    uint _entries = 0;
+
+    std::mutex _mx;
+    std::condition_variable _cv;
+    uint _inflight = 0;                 //< limited to the queue size, so the completion queue can't overflow
+    std::thread _reaper;
+
+    bool map_rings( const io_uring_params& p )
+    {
+        _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint);
+        _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            if (_cq_ring_size > _sq_ring_size)
+                _sq_ring_size = _cq_ring_size;
+            _cq_ring_size = _sq_ring_size;
+        }
+
+        _sq_ring = ::mmap(0, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            _sq_ring = 0;
+            return false;
+        }
+
+        if (single)
+            _cq_ring = _sq_ring;
+        else {
+            _cq_ring = ::mmap(0, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                _cq_ring = 0;
+                return false;
+            }
+        }
+
+        _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(0, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        _sqes = (io_uring_sqe*)sqes;
+
+        uint8* sq = (uint8*)_sq_ring;
+        _sq_head = (uint*)(sq + p.sq_off.head);
+        _sq_tail = (uint*)(sq + p.sq_off.tail);
+        _sq_mask = (uint*)(sq + p.sq_off.ring_mask);
+        _sq_array = (uint*)(sq + p.sq_off.array);
+
+        uint8* cq = (uint8*)_cq_ring;
+        _cq_head = (uint*)(cq + p.cq_off.head);
+        _cq_tail = (uint*)(cq + p.cq_off.tail);
+        _cq_mask = (uint*)(cq + p.cq_off.ring_mask);
+        _cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+
+        _entries = p.sq_entries;
+        return true;
+    }
+
+    void unmap_rings()
+    {
+        if (_sqes)
+            ::munmap(_sqes, _sqes_size);
+        if (_cq_ring && _cq_ring != _sq_ring)
+            ::munmap(_cq_ring, _cq_ring_size);
+        if (_sq_ring)
+            ::munmap(_sq_ring, _sq_ring_size);
+
+        _sqes = 0;
+        _sq_ring = _cq_ring = 0;
+    }
+
+    int enter( uint to_submit, uint min_complete, uint flags )
+    {
+        int r;
+        do r = (int)::syscall(__NR_io_uring_enter, _fd, to_submit, min_complete, flags, 0, 0);
+        while (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+        return r;
+    }
+
+    ///Queue request and submit it to the kernel
+    void push( async_file_request* req )
+    {
+        std::unique_lock<std::mutex> lock(_mx);
+        _cv.wait(lock, [this]() { return _inflight < _entries; });
+        ++_inflight;
+
+        queue_sqe(req);
+    }
+
+    ///Fill submission entry for the request and submit it
+    //@note called under the lock with an in-flight slot already taken for the request
+    void queue_sqe( async_file_request* req )
+    {
+        uint tail = *_sq_tail;
+        uint idx = tail & *_sq_mask;
+
+        io_uring_sqe* sqe = _sqes + idx;
+        ::memset(sqe, 0, sizeof(*sqe));
+
+        if (req) {
+            sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = req->handle;
+            sqe->addr = (uint64)req->buf;
+            sqe->len = req->size;
+            sqe->off = req->offset;
+        }
+        else
+            sqe->opcode = IORING_OP_NOP;
+
+        sqe->user_data = (uint64)req;
+
+        _sq_array[idx] = idx;
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        enter(1, 0, 0);
+    }
+
+    ///Reaper thread, dispatching completions
+    void reap()
+    {
+        bool quit = false;
+
+        while (!quit)
+        {
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+
+            uint head = *_cq_head;
+            uint tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+            uint n = tail - head;
+
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+                async_file_request* req = (async_file_request*)cqe.user_data;
+                int res = cqe.res;
+
+                __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+
+                if (!req) {
+                    quit = true;
+                    continue;
+                }
+
+                if (res > 0 && uint(res) < req->size) {
+                    //short transfer, resubmit the rest until the end of file as the pool backend does
+                    req->result += res;
+                    req->buf = (uint8*)req->buf + res;
+                    req->offset += res;
+                    req->size -= res;
+
+                    //keeps its in-flight slot, waiting for capacity here would block the only thread freeing it
+                    {
+                        std::lock_guard<std::mutex> lock(_mx);
+                        queue_sqe(req);
+                    }
+                    --n;
+                    continue;
+                }
+
+                if (res < 0)
+                    req->result = res;
+                else
+                    req->result += res;
+
+                req->complete(req);
+            }
+
+            if (n) {
+                std::lock_guard<std::mutex> lock(_mx);
+                _inflight -= n;
+                _cv.notify_all();
+            }
+        }
+    }
+};
+
+#endif //COMM_ASYNCFILE_URING
+
+
+////////////////////////////////////////////////////////////////////////////////
+///Thread pool backend, running blocking positional reads and writes
+class pool_file_io : public async_file_io
+{
+public:
+
+    enum { NTHREADS = 4 };
+
+    pool_file_io()
+    {
+        for (std::thread& t : _threads)
+            t = std::thread(&pool_file_io::run, this);
+    }
+
+    ~pool_file_io()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mx);
+            _quit = true;
+        }
+        _cv.notify_all();
+
+        for (std::thread& t : _threads)
+            t.join();
+    }
+
+    virtual void submit( async_file_request* req ) override
+    {
+        DASSERT(req);
+        {
+            std::lock_guard<std::mutex> lock(_mx);
+            *_queue.add() = req;
+        }
+        _cv.notify_one();
+    }
+
+    virtual const char* name() const override { return "thread pool"; }
+
+private:
+
+    std::mutex _mx;
+    std::condition_variable _cv;
+    dynarray<async_file_request*> _queue;
+    bool _quit = false;
+
+    std::thread _threads[NTHREADS];
+
+    void run()
+    {
+        for (;;)
+        {
+            async_file_request* req;
+            {
+                std::unique_lock<std::mutex> lock(_mx);
+                _cv.wait(lock, [this]() { return _quit || _queue.size() > 0; });
+                if (_queue.size() == 0)
+                    return;
+
+                req = _queue[0];
+                _queue.del(0);
+            }
+
+            process(req);
+            req->complete(req);
+        }
+    }
+
+    ///Transfer the whole block, stopping only at the end of file or on error
+    static void process( async_file_request* req )
+    {
+        uint8* p = (uint8*)req->buf;
+        uint64 offset = req->offset;
+        uint size = req->size;
+
+        while (size > 0)
+        {
+#ifdef SYSTYPE_WIN
+            HANDLE h = (HANDLE)::_get_osfhandle(req->handle);
+            OVERLAPPED ov;
+            ::memset(&ov, 0, sizeof(ov));
+            ov.Offset = DWORD(offset);
+            ov.OffsetHigh = DWORD(offset >> 32);
+
+            DWORD k = 0;
+            BOOL ok = req->write
+                ? ::WriteFile(h, p, size, &k, &ov)
+                : ::ReadFile(h, p, size, &k, &ov);
+
+            if (!ok) {
+                if (!req->write && ::GetLastError() == ERROR_HANDLE_EOF)
+                    break;
+                req->result = -int64(::GetLastError());
+                return;
+            }
+            int64 r = k;
+#else
+            int64 r = req->write
+                ? ::pwrite64(req->handle, p, size, offset)
+                : ::pread64(req->handle, p, size, offset);
+
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                req->result = -errno;
+                return;
+            }
+#endif
+            if (r == 0)
+                break;
+
+            req->result += r;
+            p += r;
+            offset += r;
+            size -= uint(r);
+        }
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+async_file_io* async_file_io::uring()
+{
+#ifdef COMM_ASYNCFILE_URING
+    LOCAL_PROCWIDE_SINGLETON_DEF(uring_file_io) io;
+    return io->is_valid() ? io.get() : 0;
+#else
+    return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+async_file_io* async_file_io::pool()
+{
+    LOCAL_PROCWIDE_SINGLETON_DEF(pool_file_io) io;
+    return io.get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+async_file_io* async_file_io::get()
+{
+    static async_file_io* io = uring() ? uring() : pool();
+    return io;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+int asyncfilestream::open_file( const char* name, bool writable, bool create, bool excl, bool trunc )
+{
+    int handle = -1;
+
+#ifdef SYSTYPE_WIN
+    int flg = _O_BINARY | (writable ? _O_WRONLY : _O_RDONLY);
+    if (create) flg |= _O_CREAT;
+    if (excl)   flg |= _O_EXCL;
+    if (trunc)  flg |= _O_TRUNC;
+
+    ::_sopen_s(&handle, name, flg, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+#else
+    int flg = writable ? O_WRONLY : O_RDONLY;
+    if (create) flg |= O_CREAT;
+    if (excl)   flg |= O_EXCL;
+    if (trunc)  flg |= O_TRUNC;
+
+    handle = ::open(name, flg, 0644);
+#endif
+
+    return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void asyncfilestream::close_file( int handle )
+{
+#ifdef SYSTYPE_WIN
+    ::_close(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64 asyncfilestream::file_size( int handle )
+{
+#ifdef SYSTYPE_WIN
+    struct _stat64 s;
+    return 0 == ::_fstat64(handle, &s) ? s.st_size : 0;
+#else
+    struct stat64 s;
+    return 0 == ::fstat64(handle, &s) ? s.st_size : 0;
+#endif
+}
+
+COID_NAMESPACE_END
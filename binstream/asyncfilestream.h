@@ -0,0 +1,582 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_ASYNCFILESTREAM__HEADER_FILE__
+#define __COID_COMM_ASYNCFILESTREAM__HEADER_FILE__
+
+#include "../namespace.h"
+
+#include "binstream.h"
+#include "../str.h"
+#include "../mathi.h"
+#include "../taskmaster.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+COID_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+///Asynchronous read or write of a file block
+struct async_file_request
+{
+    typedef void (*fn_complete)( async_file_request* req );
+
+    int handle = -1;                    //< file descriptor
+    bool write = false;                 //< write, otherwise read
+    void* buf = 0;
+    uint size = 0;
+    uint64 offset = 0;                  //< file offset
+
+    int64 result = 0;                   //< bytes transferred, or a negative error code; zeroed before submitting
+    fn_complete complete = 0;           //< invoked once from an I/O thread when the request finishes
+    void* context = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+///Process-wide asynchronous file I/O backend
+/// Uses io_uring where the kernel provides it, otherwise a pool of threads running blocking
+/// positional reads and writes.
+class async_file_io
+{
+public:
+
+    virtual ~async_file_io() {}
+
+    ///Submit request, blocks only when the backend queue is full
+    //@note the request must stay valid until its completion callback was invoked
+    virtual void submit( async_file_request* req ) = 0;
+
+    ///Backend name, for diagnostics
+    virtual const char* name() const = 0;
+
+    ///io_uring backend, or the thread pool where io_uring is unavailable
+    static async_file_io* get();
+
+    ///io_uring backend, null if not supported by the platform or kernel
+    static async_file_io* uring();
+
+    ///Thread pool backend
+    static async_file_io* pool();
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+///Binstream reading or writing a file asynchronously
+/// Reading keeps a window of blocks in flight ahead of the read position, so that parsing the
+/// data overlaps with the I/O. Writing fills blocks and submits them while the next block is
+/// being filled.
+/// Completion can be awaited through the binstream interface, which blocks in read_raw or
+/// reports readiness in peek_read, or through taskmaster signals of the blocks when
+/// a taskmaster was set with set_taskmaster.
+/// The stream is opened either for reading or for writing, not both.
+class asyncfilestream : public binstream
+{
+public:
+
+    COIDNEWDELETE(asyncfilestream);
+
+    enum {
+        DEFAULT_WINDOW = 4,
+        DEFAULT_BLOCK_SIZE = 256 << 10,
+    };
+
+    virtual uint binstream_attributes( bool in0out1 ) const override
+    {
+        return 0;
+    }
+
+    virtual opcd write_raw( const void* p, uints& len ) override
+    {
+        if (!_writing)
+            return ersUNAVAILABLE "not opened for writing";
+
+        while (len > 0)
+        {
+            block& b = _blocks[_head];
+            if (b.pending) {
+                //all blocks are in flight, wait for the oldest one
+                opcd e = wait_block(b);
+                if (e)
+                    return e;
+            }
+
+            uints n = _block_size - b.pos;
+            if (n > len)
+                n = len;
+
+            xmemcpy(b.data + b.pos, p, n);
+            b.pos += n;
+            p = (const uint8*)p + n;
+            len -= n;
+            _wpos += n;
+
+            if (b.pos == _block_size)
+                submit_write(b);
+        }
+
+        return _err;
+    }
+
+    virtual opcd read_raw( void* p, uints& len ) override
+    {
+        if (_writing)
+            return ersUNAVAILABLE "not opened for reading";
+
+        while (len > 0)
+        {
+            if (_nqueued == 0 && !fill())
+                break;
+
+            block& b = _blocks[_head];
+            opcd e = wait_block(b);
+            if (e)
+                return e;
+
+            uints n = uints(b.result) - b.pos;
+            if (n > len)
+                n = len;
+
+            xmemcpy(p, b.data + b.pos, n);
+            b.pos += n;
+            p = (uint8*)p + n;
+            len -= n;
+            _rpos += n;
+
+            if (b.pos == uints(b.result)) {
+                //block consumed, reuse it for reading further ahead
+                pop_block();
+                fill();
+            }
+        }
+
+        if (len > 0)
+            return ersNO_MORE "required more data than available";
+        return 0;
+    }
+
+    virtual opcd read_until( const substring& ss, binstream* bout, uints max_size=UMAXS ) override
+    {   return ersUNAVAILABLE; }
+
+    ///Check if data at the read position are available
+    //@param timeout 0 to check without waiting, otherwise the time in ms to wait for the data
+    //@return 0 if data are available, ersTIMEOUT if still in flight, ersNO_MORE at the end of file
+    virtual opcd peek_read( uint timeout ) override
+    {
+        if (_writing)
+            return ersUNAVAILABLE;
+
+        if (_nqueued == 0 && !fill())
+            return ersNO_MORE;
+
+        block& b = _blocks[_head];
+
+        std::unique_lock<std::mutex> lock(_mx);
+        if (timeout && b.pending)
+            _cv.wait_for(lock, std::chrono::milliseconds(timeout), [&b]() { return !b.pending; });
+
+        if (b.pending)
+            return ersTIMEOUT;
+        return b.result > 0 || b.result < 0 ? opcd(0) : ersNO_MORE;
+    }
+
+    virtual opcd peek_write( uint timeout ) override {
+        return _writing ? opcd(0) : ersUNAVAILABLE;
+    }
+
+
+    virtual bool is_open() const        override { return _handle != -1; }
+    virtual void acknowledge( bool eat=false ) override { }
+
+    ///Submit the partially filled block and wait until all written data reach the file
+    virtual void flush() override
+    {
+        if (!_writing || _handle == -1)
+            return;
+
+        block& b = _blocks[_head];
+        if (!b.pending && b.pos > 0)
+            submit_write(b);
+
+        drain();
+    }
+
+    virtual void reset_read() override {
+        set_read_pos(0);
+    }
+
+    virtual void reset_write() override {
+        set_write_pos(0);
+    }
+
+    //@{ Get and set current reading and writing position
+    uint64 get_read_pos() const override { return _rpos; }
+    uint64 get_write_pos() const override { return _wpos; }
+
+    ///Set read position, restarting the read-ahead from there
+    bool set_read_pos( uint64 pos ) override
+    {
+        if (_writing || _handle == -1)
+            return false;
+
+        drain();
+
+        _head = 0;
+        _nqueued = 0;
+        _rpos = _next = pos;
+        fill();
+        return pos <= _size;
+    }
+
+    ///Set write position, flushing the data written so far
+    bool set_write_pos( uint64 pos ) override
+    {
+        if (!_writing || _handle == -1)
+            return false;
+
+        flush();
+        _wpos = pos;
+        return true;
+    }
+    //@}
+
+    virtual opcd seek( int type, int64 pos ) override
+    {
+        if (type & fSEEK_CURRENT)
+            pos += (type & fSEEK_READ) ? _rpos : _wpos;
+
+        if (pos < 0)
+            return ersOUT_OF_RANGE;
+
+        bool ok = (type & fSEEK_READ) ? set_read_pos(pos) : set_write_pos(pos);
+        return ok ? opcd(0) : ersFAILED;
+    }
+
+    ///Set the backend and the read-ahead or write-behind window, takes effect on the next open
+    //@param io I/O backend, 0 for the default one
+    //@param window number of blocks in flight
+    //@param block_size size of a block, rounded up to 4kB
+    void set_window( uint window, uint block_size = DEFAULT_BLOCK_SIZE, async_file_io* io = 0 )
+    {
+        _window = window ? window : 1;
+        _block_size = align_value_up(block_size ? block_size : uint(DEFAULT_BLOCK_SIZE), 4096);
+        _io = io;
+    }
+
+    ///Use taskmaster signals to report completion of blocks, takes effect on the next open
+    void set_taskmaster( taskmaster* tm ) {
+        _tm = tm;
+    }
+
+    ///Signal of the block holding data at the read position, for taskmaster::wait or co_await
+    //@return invalid signal if there's no taskmaster or no data in flight
+    taskmaster::signal_handle read_signal()
+    {
+        if (_writing || !_tm || (_nqueued == 0 && !fill()))
+            return taskmaster::invalid_signal;
+
+        return _blocks[_head].signal;
+    }
+
+    ///Open file
+    //@param name file name
+    //@param attr open attributes
+    /// r - open for reading
+    /// w - open for writing
+    /// e - fail if file already exists
+    /// c - create
+    /// t,- - truncate
+    virtual opcd open( const zstring& name, const token& attr = "r" ) override
+    {
+        close();
+
+        int rw = 0;
+        bool create = false, excl = false, trunc = false;
+
+        token attrx = attr;
+        while (attrx)
+        {
+            char c = ++attrx;
+            if (c == 'r')       rw |= 1;
+            else if (c == 'w')  rw |= 2;
+            else if (c == 'e')  excl = true;
+            else if (c == 'c')  create = true;
+            else if (c == 't' || c == '-')  trunc = true;
+
+            //other letters ignored for forward compatibility
+        }
+
+        if (rw == 3)
+            return ersINVALID_PARAMS "can't open for both reading and writing";
+
+        _writing = rw == 2;
+        _handle = open_file(name.c_str(), _writing, create, excl, trunc);
+        if (_handle == -1)
+            return ersIO_ERROR;
+
+        if (!_io)
+            _io = async_file_io::get();
+
+        _buffer.alloc(uints(_window) * _block_size);
+        _blocks.alloc(_window);
+
+        for (uint i = 0; i < _window; ++i) {
+            block& b = _blocks[i];
+            b.handle = _handle;
+            b.write = _writing;
+            b.data = _buffer.ptr() + uints(i) * _block_size;
+            b.complete = &on_complete;
+            b.context = this;
+        }
+
+        _size = file_size(_handle);
+        _rpos = _wpos = _next = 0;
+        _head = _nqueued = 0;
+        _err = 0;
+
+        if (!_writing)
+            fill();
+
+        return 0;
+    }
+
+    virtual opcd close( bool linger=false ) override
+    {
+        opcd e;
+
+        if (_handle != -1) {
+            if (_writing)
+                flush();
+            else
+                drain();
+
+            e = _err;
+            close_file(_handle);
+            _handle = -1;
+        }
+
+        _rpos = _wpos = _next = _size = 0;
+        _head = _nqueued = 0;
+        _err = 0;
+
+        return e;
+    }
+
+    ///Get file size at the time of opening, or the current size when writing
+    uint64 get_size() const {
+        return _writing ? (_wpos > _size ? _wpos : _size) : _size;
+    }
+
+    asyncfilestream() {}
+
+    explicit asyncfilestream( const token& s, const token& attr = "r" )
+    {
+        open(s, attr);
+    }
+
+    asyncfilestream( const char* s, const token& attr )
+    {
+        open(s, attr);
+    }
+
+    ~asyncfilestream() { close(); }
+
+private:
+
+    ///Block of the read-ahead or write-behind window
+    struct block : async_file_request
+    {
+        uint8* data = 0;
+        uints pos = 0;                  //< consumed or filled bytes
+        bool pending = false;           //< submitted and not completed yet
+        taskmaster::signal_handle signal;
+    };
+
+    async_file_io* _io = 0;
+    taskmaster* _tm = 0;
+
+    int _handle = -1;
+    bool _writing = false;
+    uint _window = DEFAULT_WINDOW;
+    uint _block_size = DEFAULT_BLOCK_SIZE;
+
+    dynarray<block> _blocks;            //< ring of blocks, _head is the oldest one
+    dynarray<uint8> _buffer;
+    uint _head = 0;
+    uint _nqueued = 0;                  //< read blocks submitted or holding unconsumed data
+
+    uint64 _size = 0;                   //< file size
+    uint64 _rpos = 0;
+    uint64 _wpos = 0;
+    uint64 _next = 0;                   //< file offset of the next read-ahead block
+    opcd _err;                          //< first error of a write-behind block
+
+    std::mutex _mx;
+    std::condition_variable _cv;
+    uint _pending = 0;                  //< blocks in flight
+
+    ///Submit reads of blocks ahead until the window is full
+    //@return false if there's nothing more to read
+    bool fill()
+    {
+        while (_nqueued < _window && _next < _size)
+        {
+            block& b = _blocks[(_head + _nqueued) % _window];
+            uint64 n = _size - _next;
+
+            b.offset = _next;
+            b.size = n < _block_size ? uint(n) : _block_size;
+            b.pos = 0;
+            submit(b);
+
+            _next += b.size;
+            ++_nqueued;
+        }
+
+        return _nqueued > 0;
+    }
+
+    ///Release the consumed head block
+    void pop_block()
+    {
+        if (++_head == _window)
+            _head = 0;
+        --_nqueued;
+    }
+
+    void submit_write( block& b )
+    {
+        b.offset = _wpos - b.pos;
+        b.size = uint(b.pos);
+        b.pos = 0;
+        submit(b);
+
+        if (++_head == _window)
+            _head = 0;
+    }
+
+    void submit( block& b )
+    {
+        if (_tm)
+            b.signal = _tm->create_signal();
+
+        b.buf = b.data;
+        b.result = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(_mx);
+            b.pending = true;
+            ++_pending;
+        }
+
+        _io->submit(&b);
+    }
+
+    ///Wait for the block to complete
+    //@return error if the block failed
+    opcd wait_block( block& b )
+    {
+        //taskmaster worker processes other tasks meanwhile
+        if (_tm && b.pending)
+            _tm->wait(b.signal);
+
+        std::unique_lock<std::mutex> lock(_mx);
+        _cv.wait(lock, [&b]() { return !b.pending; });
+        lock.unlock();
+
+        if (b.result < 0) {
+            set_error(b);
+            return _err;
+        }
+
+        if (!b.write && uint64(b.result) < b.size) {
+            //file shrunk after opening, the blocks further ahead are not contiguous anymore
+            drain();
+            _size = b.offset + b.result;
+            _nqueued = 1;
+            _next = _size;
+        }
+
+        return 0;
+    }
+
+    ///Wait for all blocks in flight
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(_mx);
+        _cv.wait(lock, [this]() { return _pending == 0; });
+        lock.unlock();
+
+        for (block& b : _blocks) {
+            if (b.write && b.result < 0)
+                set_error(b);
+        }
+    }
+
+    void set_error( block& b )
+    {
+        if (!_err)
+            _err = ersIO_ERROR "asynchronous file operation failed";
+        b.result = 0;
+    }
+
+    static void on_complete( async_file_request* req )
+    {
+        block* b = static_cast<block*>(req);
+        asyncfilestream* s = (asyncfilestream*)req->context;
+
+        std::lock_guard<std::mutex> lock(s->_mx);
+        b->pending = false;
+        --s->_pending;
+
+        if (s->_tm)
+            s->_tm->trigger_signal(b->signal);
+
+        s->_cv.notify_all();
+    }
+
+    //platform specific, asyncfilestream.cpp
+    static int open_file( const char* name, bool writable, bool create, bool excl, bool trunc );
+    static void close_file( int handle );
+    static uint64 file_size( int handle );
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_ASYNCFILESTREAM__HEADER_FILE__
@@ -511,6 +511,31 @@ public:
     //@         all data has been read
     virtual opcd read_raw( void* p, uints& len ) = 0;
 
+    ///Memory span for vectored writes
+    struct span
+    {
+        const void* ptr;
+        uints len;
+    };
+
+    ///Write data from multiple memory spans, in order
+    /// Streams with a native scatter-gather path (writev, sendmsg) write the spans in one call
+    /// instead of copying them together, layered streams forward them to the bound stream.
+    //@return 0 (no error) when all data were written, ersNO_MORE when not all data could be written
+    virtual opcd write_vec( const span* spans, uints nspans )
+    {
+        for (uints i = 0; i < nspans; ++i)
+        {
+            uints len = spans[i].len;
+            opcd e = write_raw(spans[i].ptr, len);
+            if (e)
+                return e;
+            if (len)
+                return ersNO_MORE "not all data written";
+        }
+        return 0;
+    }
+
     ///Write raw data.
     //@note This method is provided just for the symetry, write_raw specification doesn't allow returning ersRETRY error code
     //@      to specify that only partial data has been written, this may change in the future if it turns out being needed
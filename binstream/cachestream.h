@@ -57,9 +57,12 @@ protected:
     dynarray<uchar> _cin;
     dynarray<uchar> _cot;
     uints _tcotwritten;
+    uints _climit;                  //< ceiling for the adaptive growth of the input cache
 
     enum {
         DEFAULT_CACHE_SIZE = 512,
+        DEFAULT_CACHE_LIMIT = 1 << 20,
+        FORWARD_SPANS = 16,             //< max spans forwarded together with the cached data
     };
 
     bool eois;                      //< end of the input stream already read
@@ -73,6 +76,7 @@ public:
         _cinread = other._cinread;
         _tcinread = other._tcinread;
         _tcotwritten = other._tcotwritten;
+        _climit = other._climit;
         _cin.takeover(other._cin);
         _cot.takeover(other._cot);
         eois = other.eois;
@@ -89,6 +93,7 @@ public:
         std::swap(_cinread, b._cinread);
         std::swap(_tcinread, b._tcinread);
         std::swap(_tcotwritten, b._tcotwritten);
+        std::swap(_climit, b._climit);
         std::swap(_cin, b._cin);
         std::swap(_cot, b._cot);
         std::swap(eois, b.eois);
@@ -105,6 +110,12 @@ public:
         _cot.reserve(nearest_high_pow2(sizew ? sizew : sizer), false);
     }
 
+    ///Set ceiling for the adaptive growth of the input cache
+    //@note the input cache grows to twice the size of reads larger than the cache, and doubles each
+    /// time the bound stream fills it entirely, which happens on sequential reading of files.
+    /// Reads larger than the ceiling bypass the cache.
+    void set_cache_limit(uints size) { _climit = size; }
+
     uints len() const { return _tcotwritten + _cot.size(); }
 
     uints size_read() const { return _tcinread + _cinread; }
@@ -195,6 +206,60 @@ public:
         return e;
     }
 
+    ///Write spans, small writes are cached while larger ones are forwarded to the bound stream
+    /// along with the cached data, without copying them into the cache
+    virtual opcd write_vec(const span* spans, uints nspans) override
+    {
+        if (_cot.reserved_total() == 0)
+            _cot.reserve(DEFAULT_CACHE_SIZE, false);
+
+        uints total = 0;
+        for (uints i = 0; i < nspans; ++i)
+            total += spans[i].len;
+
+        if (total <= _cot.reserved_remaining())
+            return binstream::write_vec(spans, nspans);
+
+        opcd e = on_cache_flush(_cot.ptr(), _cot.size(), false);
+        if (e == ersNOT_IMPLEMENTED)  e = 0;
+        if (e)
+        {
+            //enlarge the cache instead
+            _cot.reserve(nearest_high_pow2(_cot.size() + total), true);
+            return binstream::write_vec(spans, nspans);
+        }
+
+        uints n = _cot.size();
+
+        if (n == 0)
+            e = _bin->write_vec(spans, nspans);
+        else if (nspans < FORWARD_SPANS)
+        {
+            span v[FORWARD_SPANS];
+            v[0].ptr = _cot.ptr();
+            v[0].len = n;
+            xmemcpy(v + 1, spans, nspans * sizeof(span));
+
+            e = _bin->write_vec(v, nspans + 1);
+        }
+        else
+        {
+            e = _bin->write_raw(_cot.ptr(), n);
+            if (!e && n)
+                e = ersNO_MORE "not all data written";
+            if (!e)
+                e = _bin->write_vec(spans, nspans);
+        }
+
+        if (e)
+            return e;
+
+        _tcotwritten += _cot.size() + total;
+        _cot.reset();
+
+        return 0;
+    }
+
     virtual opcd read_raw(void* p, uints& len)
     {
         opcd e;
@@ -216,16 +281,21 @@ public:
                 len -= rm;
                 _cinread += rm;
 
-                //there would be something still
-                return eois ? ersNO_MORE : ersRETRY;
+                //there would be something still, large remainder is read directly below
+                if (eois || len < _cin.reserved_total())
+                    return eois ? ersNO_MORE : ersRETRY;
             }
 
             if (eois)
                 return ersNO_MORE;
 
+            uints cr = _cin.reserved_total();
+            if (len >= cr && len < _climit)
+                grow_cache(len);
+
             if (len >= _cin.reserved_total())
             {
-                //direct read
+                //direct read, bypassing the cache
                 uints olen = len;
                 e = fill_cache_line(p, len);
 
@@ -389,6 +459,7 @@ public:
         _cin.reserve(DEFAULT_CACHE_SIZE, false);
         _cinread = _tcinread = 0;
         _tcotwritten = 0;
+        _climit = DEFAULT_CACHE_LIMIT;
         eois = false;
     }
     cachestream(binstream* bin)
@@ -397,6 +468,7 @@ public:
         _cin.reserve(DEFAULT_CACHE_SIZE, false);
         _cinread = _tcinread = 0;
         _tcotwritten = 0;
+        _climit = DEFAULT_CACHE_LIMIT;
         eois = false;
     }
     cachestream(binstream& bin)
@@ -405,6 +477,7 @@ public:
         _cin.reserve(DEFAULT_CACHE_SIZE, false);
         _cinread = _tcinread = 0;
         _tcotwritten = 0;
+        _climit = DEFAULT_CACHE_LIMIT;
         eois = false;
     }
 
@@ -427,6 +500,29 @@ public:
     }
 
 
+    ///Get view of the next \a n bytes of input without consuming them, filling the cache as needed
+    //@return view into the cache, shorter than requested at the end of input; valid until the next read
+    token peek(uints n)
+    {
+        uints rm = _cin.size() - _cinread;
+
+        while (rm < n && !eois) {
+            uints k = fetch_forward(n);
+            if (k == rm)
+                break;
+            rm = k;
+        }
+
+        return token((const char*)_cin.ptr() + _cinread, rm < n ? rm : n);
+    }
+
+    ///Consume \a n bytes of input returned by peek
+    void consume(uints n)
+    {
+        DASSERT(n <= _cin.size() - _cinread);
+        _cinread += n;
+    }
+
     virtual opcd peek_read(uint timeout) {
         return _cin.size() > _cinread ? opcd(0) : _bin->peek_read(timeout);
     }
@@ -521,8 +617,15 @@ private:
 
     opcd read_cache_line()
     {
-        if (_cin.reserved_total() == 0)
+        uints cr = _cin.reserved_total();
+
+        if (cr == 0)
             _cin.reserve(DEFAULT_CACHE_SIZE, false);
+        else if (_cin.size() == cr && cr < _climit)
+        {
+            //the last fill took the whole cache, grow it for sequential reading
+            grow_cache(cr);
+        }
 
         uints cs = _cin.reserved_total();
         opcd e = _bin->read_raw_any(_cin.ptr(), cs);
@@ -537,6 +640,18 @@ private:
         return e;
     }
 
+    ///Grow the input cache to twice the read size, up to the limit
+    //@note drops the cached data, these must have been consumed already
+    void grow_cache(uints len)
+    {
+        uints size = nearest_high_pow2(len) * 2;
+
+        _tcinread += _cinread;
+        _cinread = 0;
+        _cin.reset();
+        _cin.reserve(size < _climit ? size : _climit, false);
+    }
+
     opcd fill_cache_line(void* p, uints& size)
     {
         opcd e = _bin
@@ -52,6 +52,8 @@
 # endif
 #else
 # include <unistd.h>
+# include <errno.h>
+# include <sys/uio.h>
 #endif
 
 #include <fcntl.h>
@@ -89,6 +91,61 @@ public:
         return 0;
     }
 
+#ifndef SYSTYPE_WIN
+    ///Write spans with writev, in batches of up to 64 spans
+    virtual opcd write_vec( const span* spans, uints nspans ) override
+    {
+        DASSERT( _handle != -1 );
+
+        if(_op>0 )
+            upd_rpos();
+
+        iovec iov[64];
+
+        while (nspans > 0)
+        {
+            int n = 0;
+            for (; n < 64 && uints(n) < nspans; ++n) {
+                iov[n].iov_base = (void*)spans[n].ptr;
+                iov[n].iov_len = spans[n].len;
+            }
+            spans += n;
+            nspans -= n;
+
+            iovec* v = iov;
+            for (;;)
+            {
+                while (n > 0 && v->iov_len == 0)
+                    ++v, --n;
+                if (n == 0)
+                    break;
+
+                ssize_t k = ::writev(_handle, v, n);
+                if (k < 0 && errno == EINTR)
+                    continue;
+                if (k < 0)
+                    return ersIO_ERROR;
+                if (k == 0)
+                    return ersNO_MORE "not all data written";
+
+                _wpos += k;
+
+                //skip the written spans and advance within a partially written one
+                while (n > 0 && uints(k) >= v->iov_len) {
+                    k -= v->iov_len;
+                    ++v, --n;
+                }
+                if (n > 0) {
+                    v->iov_base = (uint8*)v->iov_base + k;
+                    v->iov_len -= k;
+                }
+            }
+        }
+
+        return 0;
+    }
+#endif
+
     virtual opcd read_raw( void* p, uints& len ) override
     {
         DASSERT( _handle != -1 );
@@ -0,0 +1,197 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#include "mmapstream.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef SYSTYPE_WIN
+# define WIN32_LEAN_AND_MEAN
+# include <Windows.h>
+# include <io.h>
+# include <share.h>
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+COID_NAMESPACE_BEGIN
+
+#ifdef SYSTYPE_WIN
+
+////////////////////////////////////////////////////////////////////////////////
+int mmapstream::open_file( const char* name, bool writable, bool create, bool excl, bool trunc )
+{
+    int flg = _O_BINARY | (writable ? _O_RDWR : _O_RDONLY);
+    if (create) flg |= _O_CREAT;
+    if (excl)   flg |= _O_EXCL;
+    if (trunc)  flg |= _O_TRUNC;
+
+    int handle = -1;
+    ::_sopen_s(&handle, name, flg, _SH_DENYNO, _S_IREAD | _S_IWRITE);
+    return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::close_file( int handle )
+{
+    ::_close(handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64 mmapstream::file_size( int handle )
+{
+    struct _stat64 s;
+    return 0 == ::_fstat64(handle, &s) ? s.st_size : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool mmapstream::resize_file( int handle, uint64 size )
+{
+    return 0 == ::_chsize_s(handle, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* mmapstream::map_view( int handle, uint64 size, bool writable, void*& mapping )
+{
+    HANDLE fh = (HANDLE)::_get_osfhandle(handle);
+    HANDLE mh = ::CreateFileMappingA(fh, 0, writable ? PAGE_READWRITE : PAGE_READONLY,
+        DWORD(size >> 32), DWORD(size), 0);
+    if (!mh)
+        return 0;
+
+    void* p = ::MapViewOfFile(mh, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size_t(size));
+    if (!p) {
+        ::CloseHandle(mh);
+        return 0;
+    }
+
+    mapping = mh;
+    return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::unmap_view( void* base, uint64 size, void* mapping )
+{
+    if (base)
+        ::UnmapViewOfFile(base);
+    if (mapping)
+        ::CloseHandle((HANDLE)mapping);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::advise_view( void* base, uint64 size, access acc )
+{
+    //sequential access is hinted by prefetching the range, there's no equivalent of random
+    if (acc == access::sequential) {
+        WIN32_MEMORY_RANGE_ENTRY range = { base, size_t(size) };
+        ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::sync_view( void* base, uint64 size )
+{
+    ::FlushViewOfFile(base, size_t(size));
+}
+
+#else //SYSTYPE_WIN
+
+////////////////////////////////////////////////////////////////////////////////
+int mmapstream::open_file( const char* name, bool writable, bool create, bool excl, bool trunc )
+{
+    int flg = writable ? O_RDWR : O_RDONLY;
+    if (create) flg |= O_CREAT;
+    if (excl)   flg |= O_EXCL;
+    if (trunc)  flg |= O_TRUNC;
+
+    return ::open(name, flg, 0644);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::close_file( int handle )
+{
+    ::close(handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64 mmapstream::file_size( int handle )
+{
+    struct stat64 s;
+    return 0 == ::fstat64(handle, &s) ? s.st_size : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool mmapstream::resize_file( int handle, uint64 size )
+{
+    return 0 == ::ftruncate64(handle, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* mmapstream::map_view( int handle, uint64 size, bool writable, void*& mapping )
+{
+    void* p = ::mmap(0, size_t(size), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED, handle, 0);
+    return p != MAP_FAILED ? p : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::unmap_view( void* base, uint64 size, void* mapping )
+{
+    if (base)
+        ::munmap(base, size_t(size));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::advise_view( void* base, uint64 size, access acc )
+{
+    int advice = acc == access::sequential ? MADV_SEQUENTIAL
+        : (acc == access::random ? MADV_RANDOM : MADV_NORMAL);
+
+    ::madvise(base, size_t(size), advice);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void mmapstream::sync_view( void* base, uint64 size )
+{
+    ::msync(base, size_t(size), MS_ASYNC);
+}
+
+#endif //SYSTYPE_WIN
+
+COID_NAMESPACE_END
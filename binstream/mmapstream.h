@@ -0,0 +1,401 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_MMAPSTREAM__HEADER_FILE__
+#define __COID_COMM_MMAPSTREAM__HEADER_FILE__
+
+#include "../namespace.h"
+
+#include "binstream.h"
+#include "../str.h"
+
+
+COID_NAMESPACE_BEGIN
+
+
+////////////////////////////////////////////////////////////////////////////////
+///Binstream over a memory mapped file
+/// Reads and writes are plain memory copies without syscalls. The mapped content can also be
+/// accessed directly through token views, so that parsers can work on the file without copying
+/// it into a buffer first.
+/// Writing past the end grows the file and remaps it, which invalidates earlier views.
+/// On close, a written file is truncated to the highest written position.
+class mmapstream : public binstream
+{
+public:
+
+    COIDNEWDELETE(mmapstream);
+
+    ///Access pattern hint for the mapped range
+    enum class access {
+        normal,
+        sequential,                     //< aggressive read-ahead, pages can be dropped after use
+        random,                         //< no read-ahead
+    };
+
+    virtual uint binstream_attributes( bool in0out1 ) const override
+    {
+        return fATTR_READ_UNTIL;
+    }
+
+    virtual opcd write_raw( const void* p, uints& len ) override
+    {
+        if (!_writable)
+            return ersUNAVAILABLE "read-only mapping";
+
+        if (_wpos + len > _capacity && !grow(_wpos + len))
+            return ersIO_ERROR "failed to grow the mapped file";
+
+        xmemcpy(_base + _wpos, p, len);
+        _wpos += len;
+        if (_wpos > _size)
+            _size = _wpos;
+
+        len = 0;
+        return 0;
+    }
+
+    virtual opcd read_raw( void* p, uints& len ) override
+    {
+        uints n = uints(_size > _rpos ? _size - _rpos : 0);
+        if (n > len)
+            n = len;
+
+        xmemcpy(p, _base + _rpos, n);
+        _rpos += n;
+        len -= n;
+
+        if (len > 0)
+            return ersNO_MORE "required more data than available";
+        return 0;
+    }
+
+    ///Advance past substring, preceding part pushing to \a bout (if nonzero)
+    virtual opcd read_until( const substring& ss, binstream* bout, uints max_size=UMAXS ) override
+    {
+        token t = read_view(max_size);
+        if (!t)
+            return ersNO_MORE;
+
+        uints n = t.count_until_substring(ss);
+        bool found = n < t.len();
+
+        if (bout) {
+            uints len = n;
+            bout->write_raw(t.ptr(), len);
+        }
+
+        _rpos += found ? n + ss.len() : n;
+        return found ? opcd(0) : ersNOT_FOUND;
+    }
+
+    virtual opcd peek_read( uint timeout ) override {
+        if (timeout)  return ersINVALID_PARAMS;
+        return _rpos < _size  ?  opcd(0) : ersNO_MORE;
+    }
+
+    virtual opcd peek_write( uint timeout ) override {
+        return _writable ? opcd(0) : ersUNAVAILABLE;
+    }
+
+    ///Write the mapped data directly to another binstream
+    virtual opcd transfer_to( binstream& bin, uints datasize=UMAXS, uints* size_written=0, uints blocksize = 32768 ) override
+    {
+        token t = read_view(datasize);
+        uints len = t.len();
+
+        opcd e = bin.write_raw(t.ptr(), len);
+
+        uints n = t.len() - len;
+        _rpos += n;
+
+        if (size_written)
+            *size_written = n;
+        return e;
+    }
+
+
+    virtual bool is_open() const        override { return _handle != -1; }
+    virtual void acknowledge( bool eat=false ) override { }
+
+    ///Schedule writing of the modified pages to the file
+    virtual void flush() override
+    {
+        if (_writable && _size)
+            sync_view(_base, _size);
+    }
+
+    virtual void reset_read() override  { _rpos = 0; }
+    virtual void reset_write() override { _wpos = 0; }
+
+    //@{ Get and set current reading and writing position
+    uint64 get_read_pos() const override { return _rpos; }
+    uint64 get_write_pos() const override { return _wpos; }
+
+    bool set_read_pos(uint64 pos) override {
+        bool over = pos > _size;
+        _rpos = over ? _size : pos;
+        return !over;
+    }
+
+    bool set_write_pos(uint64 pos) override {
+        if (!_writable)
+            return false;
+        _wpos = pos;
+        return true;
+    }
+    //@}
+
+    virtual opcd seek( int type, int64 pos ) override
+    {
+        if (type & fSEEK_CURRENT)
+            pos += (type & fSEEK_READ) ? _rpos : _wpos;
+
+        if (pos < 0)
+            return ersOUT_OF_RANGE;
+
+        if (type & fSEEK_READ)
+            return set_read_pos(pos) ? opcd(0) : ersOUT_OF_RANGE;
+
+        return set_write_pos(pos) ? opcd(0) : ersUNAVAILABLE;
+    }
+
+    ///Open and map file
+    //@param name file name
+    //@param attr open attributes
+    /// r - map for reading
+    /// w - map for writing, the file grows as needed
+    /// rw - map for reading and writing, preserving the existing content
+    /// e - fail if file already exists
+    /// c - create
+    /// t,- - truncate
+    /// S - sequential access hint
+    /// R - random access hint
+    virtual opcd open( const zstring& name, const token& attr = "r" ) override
+    {
+        close();
+
+        int rw = 0;
+        bool create = false, excl = false, trunc = false;
+        access acc = access::normal;
+
+        token attrx = attr;
+        while (attrx)
+        {
+            char c = ++attrx;
+            if (c == 'r')       rw |= 1;
+            else if (c == 'w')  rw |= 2;
+            else if (c == 'e')  excl = true;
+            else if (c == 'c')  create = true;
+            else if (c == 't' || c == '-')  trunc = true;
+            else if (c == 'S')  acc = access::sequential;
+            else if (c == 'R')  acc = access::random;
+
+            //other letters ignored for forward compatibility
+        }
+
+        _writable = (rw & 2) != 0;
+
+        //writable mappings need read access to the file too
+        _handle = open_file(name.c_str(), _writable, create, excl, trunc);
+        if (_handle == -1)
+            return ersIO_ERROR;
+
+        _size = file_size(_handle);
+        _rpos = _wpos = 0;
+        _access = acc;
+
+        if (_size > 0 && !remap(_size)) {
+            close();
+            return ersIO_ERROR "failed to map the file";
+        }
+
+        return 0;
+    }
+
+    virtual opcd close( bool linger=false ) override
+    {
+        if (_handle != -1) {
+            bool trim = _writable && _capacity != _size;
+            unmap();
+
+            //drop the unused capacity from growing
+            if (trim)
+                resize_file(_handle, _size);
+
+            close_file(_handle);
+            _handle = -1;
+        }
+
+        _size = _capacity = 0;
+        _rpos = _wpos = 0;
+        _writable = false;
+
+        return 0;
+    }
+
+    ///Set access pattern hint for the mapped range
+    void advise( access acc )
+    {
+        _access = acc;
+        if (_base)
+            advise_view(_base, _capacity, acc);
+    }
+
+    ///Get size of the file content
+    uint64 get_size() const { return _size; }
+
+    ///Pointer to the mapped data, valid until the mapping grows or closes
+    const uint8* data() const { return _base; }
+
+    ///View of the whole mapped content
+    operator token() const {
+        return token((const char*)_base, uints(_size));
+    }
+
+    ///View of a range of the mapped content, clamped to the data size
+    token view( uint64 offset, uints len = UMAXS ) const
+    {
+        if (offset >= _size)
+            return token();
+
+        uint64 n = _size - offset;
+        if (len > n)
+            len = uints(n);
+
+        return token((const char*)_base + offset, len);
+    }
+
+    ///View of the unread content, up to \a len bytes, not advancing the read position
+    token read_view( uints len = UMAXS ) const {
+        return view(_rpos, len);
+    }
+
+    ///Read \a len bytes as a view into the mapping, advancing the read position
+    //@return view of the read data, can be shorter at the end of file
+    token read_token( uints len )
+    {
+        token t = view(_rpos, len);
+        _rpos += t.len();
+        return t;
+    }
+
+    mmapstream() {}
+
+    explicit mmapstream( const token& s, const token& attr = "r" )
+    {
+        open(s, attr);
+    }
+
+    mmapstream( const char* s, const token& attr )
+    {
+        open(s, attr);
+    }
+
+    ~mmapstream() { close(); }
+
+private:
+
+    int _handle = -1;
+    void* _mapping = 0;                 //< platform mapping object, if any
+    uint8* _base = 0;                   //< mapped memory
+    uint64 _size = 0;                   //< size of the file content
+    uint64 _capacity = 0;               //< size of the mapped range
+    uint64 _rpos = 0;
+    uint64 _wpos = 0;
+    bool _writable = false;
+    access _access = access::normal;
+
+    ///Grow the file and its mapping to hold at least \a size bytes
+    bool grow( uint64 size )
+    {
+        uint64 cap = _capacity < 65536 ? 65536 : _capacity;
+        while (cap < size)
+            cap *= 2;
+
+        //the file can't be resized while mapped on Windows
+        uint64 old = _capacity;
+        unmap();
+
+        if (!resize_file(_handle, cap)) {
+            remap(old);
+            return false;
+        }
+
+        return remap(cap);
+    }
+
+    ///Map the first \a size bytes of the file
+    bool remap( uint64 size )
+    {
+        unmap();
+
+        if (size == 0)
+            return false;
+
+        _base = (uint8*)map_view(_handle, size, _writable, _mapping);
+        _capacity = _base ? size : 0;
+
+        if (_base && _access != access::normal)
+            advise_view(_base, _capacity, _access);
+
+        return _base != 0;
+    }
+
+    ///Release the view and the mapping, the file stays open
+    void unmap()
+    {
+        unmap_view(_base, _capacity, _mapping);
+        _base = 0;
+        _mapping = 0;
+        _capacity = 0;
+    }
+
+    //platform specific, mmapstream.cpp
+    static int open_file( const char* name, bool writable, bool create, bool excl, bool trunc );
+    static void close_file( int handle );
+    static uint64 file_size( int handle );
+    static bool resize_file( int handle, uint64 size );
+    static void* map_view( int handle, uint64 size, bool writable, void*& mapping );
+    static void unmap_view( void* base, uint64 size, void* mapping );
+    static void advise_view( void* base, uint64 size, access acc );
+    static void sync_view( void* base, uint64 size );
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_MMAPSTREAM__HEADER_FILE__
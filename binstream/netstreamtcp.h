@@ -247,6 +247,60 @@ public:
 		return 0;
 	}
 
+    ///Send spans with sendmsg, in batches of up to 64 spans
+    virtual opcd write_vec( const span* spans, uints nspans )
+    {
+        if( !_socket.isValid() )  return ersDISCONNECTED;
+
+        span v[64];
+
+        while( nspans > 0 )
+        {
+            int n = 0;
+            for( ; n < 64 && uints(n) < nspans; ++n )
+                v[n] = spans[n];
+            spans += n;
+            nspans -= n;
+
+            span* p = v;
+            int blk = 0;
+            for(;;)
+            {
+                while( n > 0 && p->len == 0 )
+                    ++p, --n;
+                if( n == 0 )
+                    break;
+
+                int k = _socket.sendv( p, n );
+                if( k == -1 )
+                {
+                    if( errno == EAGAIN )
+                        continue;
+                    close();
+                    return ersDISCONNECTED "while sending data";
+                }
+
+                if( k == 0 )
+                {
+                    if( blk++ ) return ersUNAVAILABLE "connection closed";
+                    _socket.setBlocking( true );
+                }
+
+                //skip the sent spans and advance within a partially sent one
+                while( n > 0 && uints(k) >= p->len ) {
+                    k -= int(p->len);
+                    ++p, --n;
+                }
+                if( n > 0 ) {
+                    p->ptr = (const char*)p->ptr + k;
+                    p->len -= k;
+                }
+            }
+        }
+
+        return 0;
+    }
+
 	virtual opcd read_raw( void* p, uints& len )
 	{
         if( !_socket.isValid() )  return ersDISCONNECTED;
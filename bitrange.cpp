@@ -0,0 +1,348 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#include "bitrange.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define COID_BITSCAN_X86
+#include <immintrin.h>
+#endif
+
+#ifdef COID_BITSCAN_X86
+#if defined(SYSTYPE_MSVC) && !defined(SYSTYPE_CLANG)
+//MSVC compiles intrinsics of any instruction set without extra flags
+#include <intrin.h>
+#define COID_TARGET(isa)
+#else
+//cpu detection through __builtin_cpu_supports, no header needed
+#define COID_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace coid {
+namespace bitscan {
+
+////////////////////////////////////////////////////////////////////////////////
+//scalar kernels
+
+static const uint8* find_byte_not_scalar( const uint8* p, const uint8* e, uint8 v )
+{
+    const uint64 v8 = v ? ~uint64(0) : uint64(0);
+
+    for (; e - p >= 8; p += 8) {
+        uint64 x;
+        ::memcpy(&x, p, 8);
+        if (x != v8)
+            break;
+    }
+
+    for (; p < e && *p == v; ++p);
+    return p;
+}
+
+static uints population_count_scalar( const uint8* p, const uint8* e )
+{
+    uints n = 0;
+
+    for (; e - p >= 8; p += 8) {
+        uint64 x;
+        ::memcpy(&x, p, 8);
+        n += population_count(x);
+    }
+
+    for (; p < e; ++p)
+        n += population_count(uint16(*p));
+    return n;
+}
+
+static void update_changeset_scalar( uint16* p, uint16* e, uint16 sel )
+{
+    const uint16 keep = uint16(0xff00 & ~sel);
+    sel |= 0x00ff;
+
+    for (; p < e; ++p) {
+        uint16 v = *p;
+        uint16 vs = (v << 1) & 0xaeff;                 //shifted bits
+        uint16 va = ((v << 1) | (v << 2)) & 0x5100;    //aggregated bits
+
+        *p = uint16(((vs | va) & sel) | (v & keep));
+    }
+}
+
+static const kernels _scalar = {
+    level::scalar,
+    "scalar",
+    &find_byte_not_scalar,
+    &population_count_scalar,
+    &update_changeset_scalar,
+};
+
+#ifdef COID_BITSCAN_X86
+
+////////////////////////////////////////////////////////////////////////////////
+//SSE4.2 kernels
+
+COID_TARGET("sse4.2,popcnt")
+static const uint8* find_byte_not_sse4( const uint8* p, const uint8* e, uint8 v )
+{
+    const __m128i vv = _mm_set1_epi8(char(v));
+
+    for (; e - p >= 16; p += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), vv);
+        if (!_mm_testz_si128(x, x))
+            break;
+    }
+
+    return find_byte_not_scalar(p, e, v);
+}
+
+COID_TARGET("sse4.2,popcnt")
+static uints population_count_sse4( const uint8* p, const uint8* e )
+{
+    uints n = 0;
+
+#ifdef SYSTYPE_64
+    for (; e - p >= 8; p += 8) {
+        uint64 x;
+        ::memcpy(&x, p, 8);
+        n += uints(_mm_popcnt_u64(x));
+    }
+#endif
+
+    for (; e - p >= 4; p += 4) {
+        uint x;
+        ::memcpy(&x, p, 4);
+        n += uints(_mm_popcnt_u32(x));
+    }
+
+    for (; p < e; ++p)
+        n += uints(_mm_popcnt_u32(*p));
+    return n;
+}
+
+COID_TARGET("sse4.2,popcnt")
+static void update_changeset_sse4( uint16* p, uint16* e, uint16 sel )
+{
+    const __m128i mshift = _mm_set1_epi16(short(0xaeff));
+    const __m128i maggr = _mm_set1_epi16(short(0x5100));
+    const __m128i msel = _mm_set1_epi16(short(sel | 0x00ff));
+    const __m128i mkeep = _mm_set1_epi16(short(0xff00 & ~sel));
+
+    for (; e - p >= 8; p += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        __m128i v1 = _mm_slli_epi16(v, 1);
+        __m128i v2 = _mm_slli_epi16(v, 2);
+
+        __m128i vs = _mm_and_si128(v1, mshift);
+        __m128i va = _mm_and_si128(_mm_or_si128(v1, v2), maggr);
+        __m128i r = _mm_or_si128(
+            _mm_and_si128(_mm_or_si128(vs, va), msel),
+            _mm_and_si128(v, mkeep));
+
+        _mm_storeu_si128((__m128i*)p, r);
+    }
+
+    update_changeset_scalar(p, e, sel);
+}
+
+static const kernels _sse4 = {
+    level::sse4,
+    "sse4",
+    &find_byte_not_sse4,
+    &population_count_sse4,
+    &update_changeset_sse4,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//AVX2 kernels
+
+COID_TARGET("avx2,popcnt")
+static const uint8* find_byte_not_avx2( const uint8* p, const uint8* e, uint8 v )
+{
+    const __m256i vv = _mm256_set1_epi8(char(v));
+
+    for (; e - p >= 64; p += 64) {
+        __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), vv);
+        __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p + 32)), vv);
+        __m256i x = _mm256_or_si256(a, b);
+        if (!_mm256_testz_si256(x, x))
+            break;
+    }
+
+    for (; e - p >= 32; p += 32) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), vv);
+        if (!_mm256_testz_si256(x, x))
+            break;
+    }
+
+    return find_byte_not_scalar(p, e, v);
+}
+
+COID_TARGET("avx2,popcnt")
+static uints population_count_avx2( const uint8* p, const uint8* e )
+{
+    //nibble lookup, summed by vpsadbw into 64 bit lanes
+    const __m256i lookup = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i acc = zero;
+
+    for (; e - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        __m256i cnt = _mm256_add_epi8(
+            _mm256_shuffle_epi8(lookup, lo),
+            _mm256_shuffle_epi8(lookup, hi));
+
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, zero));
+    }
+
+    uint64 lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+
+    return uints(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + population_count_sse4(p, e);
+}
+
+COID_TARGET("avx2,popcnt")
+static void update_changeset_avx2( uint16* p, uint16* e, uint16 sel )
+{
+    const __m256i mshift = _mm256_set1_epi16(short(0xaeff));
+    const __m256i maggr = _mm256_set1_epi16(short(0x5100));
+    const __m256i msel = _mm256_set1_epi16(short(sel | 0x00ff));
+    const __m256i mkeep = _mm256_set1_epi16(short(0xff00 & ~sel));
+
+    for (; e - p >= 16; p += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i v1 = _mm256_slli_epi16(v, 1);
+        __m256i v2 = _mm256_slli_epi16(v, 2);
+
+        __m256i vs = _mm256_and_si256(v1, mshift);
+        __m256i va = _mm256_and_si256(_mm256_or_si256(v1, v2), maggr);
+        __m256i r = _mm256_or_si256(
+            _mm256_and_si256(_mm256_or_si256(vs, va), msel),
+            _mm256_and_si256(v, mkeep));
+
+        _mm256_storeu_si256((__m256i*)p, r);
+    }
+
+    update_changeset_sse4(p, e, sel);
+}
+
+static const kernels _avx2 = {
+    level::avx2,
+    "avx2",
+    &find_byte_not_avx2,
+    &population_count_avx2,
+    &update_changeset_avx2,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static bool cpu_supports( level lvl )
+{
+#if defined(SYSTYPE_MSVC) && !defined(SYSTYPE_CLANG)
+    int info[4];
+    __cpuid(info, 0);
+    int nids = info[0];
+
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    bool popcnt = (info[2] & (1 << 23)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    if (lvl == level::sse4)
+        return sse42 && popcnt;
+
+    if (nids < 7 || !osxsave || !avx || !popcnt)
+        return false;
+
+    //OS saves the ymm registers
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+
+    if (lvl == level::sse4)
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+}
+
+#endif //COID_BITSCAN_X86
+
+////////////////////////////////////////////////////////////////////////////////
+const kernels* get( level lvl )
+{
+    switch (lvl) {
+    case level::scalar: return &_scalar;
+#ifdef COID_BITSCAN_X86
+    case level::sse4:   return cpu_supports(level::sse4) ? &_sse4 : 0;
+    case level::avx2:   return cpu_supports(level::avx2) ? &_avx2 : 0;
+#endif
+    default:            return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static const kernels& select()
+{
+#ifdef COID_BITSCAN_X86
+    if (cpu_supports(level::avx2))
+        return _avx2;
+    if (cpu_supports(level::sse4))
+        return _sse4;
+#endif
+    return _scalar;
+}
+
+const kernels& best()
+{
+    static const kernels& k = select();
+    return k;
+}
+
+} //namespace bitscan
+} //namespace coid
@@ -179,6 +179,42 @@ inline uint8 population_count(uint16 val) { return uint8(__popcnt16(val)); }
 inline uint8 population_count(uint32 val) { return uint8(__popcnt(val)); }
 inline uint8 population_count(uint64 val) { return uint8(__popcnt64(val)); }
 
+////////////////////////////////////////////////////////////////////////////////
+///Vectorized kernels for scanning of bit masks, selected at runtime by cpu capabilities
+namespace bitscan {
+
+enum class level {
+    scalar,
+    sse4,
+    avx2,
+};
+
+struct kernels
+{
+    level lvl;
+    const char* name;
+
+    ///Find first byte that differs from v
+    //@param v 0 or 0xff
+    //@return pointer to the byte, or e if none
+    const uint8* (*find_byte_not)(const uint8* p, const uint8* e, uint8 v);
+
+    ///Count bits set in byte range
+    uints (*population_count)(const uint8* p, const uint8* e);
+
+    ///Shift changeset frame bits in slotalloc, aggregating the bits of selected frames
+    //@param sel mask of frame bits to aggregate (0xc000, 0x3000 and 0x0f00 groups)
+    void (*update_changeset)(uint16* p, uint16* e, uint16 sel);
+};
+
+///Best kernels supported by the cpu
+const kernels& best();
+
+//@return kernels of given level, or null if not supported by the cpu
+const kernels* get( level lvl );
+
+} //namespace bitscan
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #if !defined(SYSTYPE_MSVC) || SYSTYPE_MSVC >= 1800
@@ -219,6 +255,62 @@ template <class T>
 using underlying_bitrange_type_t = typename underlying_bitrange_type<T>::type;
 
 
+///Find first word in range that differs from v
+//@param v 0 or all bits set
+//@note atomic and volatile ranges are read word by word
+template <class T, class U>
+inline const T* find_word_not( const T* p, const T* end, U v )
+{
+    if coid_constexpr_if (std::is_integral<T>::value && !std::is_volatile<T>::value) {
+        DASSERT(T(v) == T(0) || T(v) == T(-1));
+
+        //short runs are common, check few words before calling the kernel
+        for (int i = 0; i < 4; ++i, ++p)
+            if (p == end || *p != T(v))
+                return p;
+
+        const uint8* b = bitscan::best().find_byte_not((const uint8*)p, (const uint8*)end, uint8(v));
+        return p + (b - (const uint8*)p) / sizeof(T);
+    }
+    else {
+        using W = underlying_bitrange_type_t<T>;
+        for (; p < end && W(*p) == W(v); ++p);
+        return p;
+    }
+}
+
+//@return count of bits set to 1 in range of words
+template <class T>
+inline uints population_count( const T* begin, const T* end )
+{
+    if coid_constexpr_if (std::is_integral<T>::value && !std::is_volatile<T>::value) {
+        return bitscan::best().population_count((const uint8*)begin, (const uint8*)end);
+    }
+    else {
+        using W = underlying_bitrange_type_t<T>;
+        uints n = 0;
+        for (; begin < end; ++begin)
+            n += population_count(uint64(W(*begin)));
+        return n;
+    }
+}
+
+///Invoke fn(bit) for each bit set in the range of words, skipping empty words
+template <class T, class Fn>
+inline void for_each_set_bit( const T* begin, const T* end, Fn fn )
+{
+    static const uints NBITS = 8 * sizeof(T);
+    using W = underlying_bitrange_type_t<T>;
+
+    for (const T* p = find_word_not(begin, end, W(0)); p < end; p = find_word_not(p + 1, end, W(0))) {
+        uints base = (p - begin) * NBITS;
+
+        for (W w = W(*p); w; w &= w - 1)
+            fn(base + lsb_bit_set(uint64(w)));
+    }
+}
+
+
 //@return starting bit number of a contiguous range of n bits that are set to 0
 template <class T>
 inline uints find_zero_bitrange( uints n, const T* begin, const T* end )
@@ -235,7 +327,7 @@ inline uints find_zero_bitrange( uints n, const T* begin, const T* end )
 
     do {
         if (bit >= NBITS) {
-            for (++p; p < end && *p == UMAXS; ++p);
+            p = find_word_not(p + 1, end, U(-1));
 
             if (p == end)
                 return (p - begin) * NBITS;
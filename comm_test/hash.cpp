@@ -0,0 +1,324 @@
+#include "../hash/hashmap.h"
+#include "../hash/hashkeyset.h"
+#include "../hash/swisstable.h"
+#include "../hash/concurrent_keyset.h"
+#include "../hash/slothash.h"
+#include "../log/logger.h"
+#include "../interface.h"
+#include "../timer.h"
+#include "../str.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace coid;
+
+struct keyed {
+    charstr key;
+    int value = 0;
+
+    operator token() const { return key; }
+};
+
+///Swiss table semantics, including tombstone reuse and erase during iteration
+static void test_swisstable_semantics()
+{
+    swiss_map<uint, uint> map;
+    DASSERT(map.empty() && map.begin() == map.end());
+
+    for (uint i = 0; i < 1000; ++i) {
+        bool inserted = map.insert_key_value(i, i * 2) != 0;
+        DASSERT(inserted);
+    }
+    bool inserted = map.insert_key_value(10, 0) != 0;
+    DASSERT(!inserted);
+    DASSERT(map.size() == 1000);
+
+    for (uint i = 0; i < 1000; i += 2) {
+        uints n = map.erase(i);
+        DASSERT(n == 1);
+    }
+    uints nerased = map.erase(0);
+    DASSERT(nerased == 0);
+
+    for (uint i = 0; i < 1000; ++i) {
+        const uint* v = map.find_value(i);
+        DASSERT(i & 1 ? v && *v == i * 2 : !v);
+    }
+
+    //churn through deleted slots without growing unboundedly
+    for (uint r = 0; r < 20; ++r) {
+        for (uint i = 0; i < 500; ++i)
+            map.insert_key_value(1000 + r * 500 + i, i);
+        for (uint i = 0; i < 500; ++i)
+            map.erase(1000 + r * 500 + i);
+    }
+    DASSERT(map.size() == 500 && map.bucket_count() <= 2048);
+
+    uints n = 0;
+    for (auto it = map.begin(); it != map.end(); ) {
+        DASSERT(it->second == it->first * 2);
+        map.erase(it);
+        ++n;
+    }
+    DASSERT(n == 500 && map.empty());
+
+    swiss_keyset<keyed, _Select_Copy<keyed, token>> set;
+    for (int i = 0; i < 100; ++i) {
+        keyed* k = set.insert_value_slot(charstr() << "key" << i);
+        k->key = charstr() << "key" << i;
+        k->value = i;
+    }
+
+    keyed* dup = set.insert_value_slot("key7");
+    DASSERT(!dup);
+    DASSERT(set.find_value("key42")->value == 42);
+
+    swiss_keyset<keyed, _Select_Copy<keyed, token>> copy = set;
+    set.clear();
+    DASSERT(set.empty() && !set.find_value("key42"));
+    DASSERT(copy.size() == 100 && copy.find_value("key99")->value == 99);
+}
+
+///Compile time and runtime string hashes agree, insensitive hash folds case
+static void test_string_hash()
+{
+    static constexpr uint short_hash = literal_hash("abc");
+    static constexpr uint long_hash = literal_hash("a string literal long enough to take the 48 byte loop");
+
+    DASSERT(short_hash == token("abc").hash());
+    DASSERT(long_hash == tokenhash(token("a string literal long enough to take the 48 byte loop")).hash());
+    DASSERT(string_hash("abc") == short_hash);
+
+    const char* mixed = "Some MIXED case String with [brackets] @ and `quotes` 0123456789";
+    charstr lower = mixed;
+    lower.tolower();
+
+    for (uints n = 0; n <= lower.len(); ++n) {
+        DASSERT(__coid_hash_string_insensitive(mixed, n) == __coid_hash_string(lower.ptr(), n));
+        DASSERT(n == 0 || __coid_hash_string(lower.ptr(), n) != __coid_hash_string(lower.ptr(), n - 1));
+    }
+
+    DASSERT((hasher<charstr, true>()(charstr(mixed)) == hasher<charstr>()(lower)));
+}
+
+struct pair_item {
+    uint key;
+    uint value;
+
+    operator uint() const { return key; }
+};
+
+///Readers look up stable keys while a writer inserts and erases others, growing the table
+static void test_concurrent_keyset()
+{
+    static const uint NSTABLE = 100;
+    static const uint NCHURN = 5000;
+
+    concurrent_keyset<pair_item, _Select_Copy<pair_item, uint>> set;
+
+    for (uint i = 0; i < NSTABLE; ++i) {
+        bool inserted = set.insert_value(pair_item{i, i * 3}) != 0;
+        DASSERT(inserted);
+    }
+    bool inserted = set.insert_value(pair_item{0, 0}) != 0;
+    DASSERT(!inserted);
+
+    std::atomic_bool done(false);
+    std::atomic_uint errors(0);
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                for (uint i = 0; i < NSTABLE; ++i) {
+                    uint v = 0;
+                    if (!set.find(i, [&v](const pair_item& p) { v = p.value; }) || v != i * 3)
+                        ++errors;
+                }
+
+                set.for_each([&](const pair_item& p) {
+                    if (p.value != p.key * 3)
+                        ++errors;
+                });
+            }
+        });
+    }
+
+    for (uint r = 0; r < 4; ++r) {
+        for (uint i = 0; i < NCHURN; ++i)
+            set.insert_value_slot(NSTABLE + i, [i](pair_item& p) { p.key = NSTABLE + i; p.value = (NSTABLE + i) * 3; });
+        for (uint i = 0; i < NCHURN; i += 2) {
+            bool erased = set.erase(NSTABLE + i);
+            DASSERT(erased);
+        }
+        uints n = set.erase_if([](const pair_item& p) { return p.key >= NSTABLE; });
+        DASSERT(n == NCHURN / 2);
+    }
+
+    done = true;
+    for (std::thread& t : readers)
+        t.join();
+
+    DASSERT(errors == 0);
+    DASSERT(set.size() == NSTABLE);
+}
+
+///Lookups, iteration, erasure and copying while an incremental rehash is pending
+static void test_incremental_rehash()
+{
+    static const uint N = 20000;
+
+    hash_map<uint, uint> map;
+    map.set_incremental_rehash(2);
+
+    bool pending = false;
+    for (uint i = 0; i < N; ++i) {
+        const uint* v = map.insert_key_value(i, i + 1);
+        DASSERT(v);
+        pending |= map.rehash_pending();
+
+        if ((i & 1023) == 1023 && map.rehash_pending()) {
+            for (uint k = 0; k <= i; k += 7)
+                DASSERT(map.find_value(k) && *map.find_value(k) == k + 1);
+
+            uints n = 0;
+            for (auto it = map.begin(); it != map.end(); ++it, ++n)
+                DASSERT(it->second == it->first + 1);
+            DASSERT(n == map.size());
+
+            hash_map<uint, uint> copy = map;
+            DASSERT(copy.size() == map.size() && copy.find_value(i));
+        }
+    }
+    DASSERT(pending);
+
+    for (uint i = 0; i < N; i += 2) {
+        uints n = map.erase(i);
+        DASSERT(n == 1);
+    }
+    DASSERT(map.size() == N / 2);
+
+    while (map.rehash_step(16));
+    DASSERT(!map.rehash_pending());
+
+    for (uint i = 0; i < N; ++i)
+        DASSERT(i & 1 ? map.find_value(i) != 0 : map.find_value(i) == 0);
+
+    //same for slothash
+    slothash<pair_item, uint> sh;
+    sh.set_incremental_rehash(2);
+
+    pending = false;
+    for (uint i = 0; i < N; ++i) {
+        pair_item* p = sh.push(pair_item{i, i * 3});
+        DASSERT(p && p->value == i * 3);
+        pending |= sh.rehash_pending();
+
+        if ((i & 1023) == 1023)
+            for (uint k = 0; k <= i; k += 7)
+                DASSERT(sh.find_value(k) && sh.find_value(k)->value == k * 3);
+    }
+    DASSERT(pending);
+    pair_item* dup = sh.push(pair_item{5, 0});
+    DASSERT(!dup);
+
+    for (uint i = 0; i < N; i += 2) {
+        uints n = sh.erase(i);
+        DASSERT(n == 1);
+    }
+
+    sh.set_incremental_rehash(0);
+    DASSERT(!sh.rehash_pending());
+
+    for (uint i = 0; i < N; ++i)
+        DASSERT(i & 1 ? sh.find_value(i) != 0 : sh.find_value(i) == 0);
+}
+
+///Worst case insert time with a full and an incremental rehash
+static void bench_incremental_rehash()
+{
+    static const uint N = 1 << 20;
+
+    for (uint budget : {0, 4}) {
+        hash_map<uint, uint> map;
+        map.set_incremental_rehash(budget);
+
+        uint64 worst = 0;
+        uint64 t0 = nsec_timer::current_time_ns();
+
+        for (uint i = 0; i < N; ++i) {
+            uint64 t = nsec_timer::current_time_ns();
+            map.insert_key_value(i * 2654435761u, i);
+            uint64 d = nsec_timer::current_time_ns() - t;
+            if (d > worst)
+                worst = d;
+        }
+
+        uint64 t1 = nsec_timer::current_time_ns();
+
+        coidlog_info("hashtest", "hash_map rehash budget " << budget << ": insert " << double(t1 - t0) / N
+            << "ns, worst insert " << double(worst) / 1e6 << "ms");
+    }
+
+    interface_register::getlog()->flush();
+}
+
+template <class MAP>
+static void bench_map(const char* name, const dynarray<uint>& keys)
+{
+    MAP map;
+    uints n = keys.size();
+
+    uint64 t0 = nsec_timer::current_time_ns();
+    for (uint k : keys)
+        map.insert_key_value(k, k);
+
+    uint64 t1 = nsec_timer::current_time_ns();
+    uint sum = 0;
+    for (uint k : keys)
+        sum += *map.find_value(k);
+    for (uint k : keys)
+        sum += map.find_value(~k) ? 1 : 0;
+
+    uint64 t2 = nsec_timer::current_time_ns();
+    for (uint k : keys)
+        map.erase(k);
+
+    uint64 t3 = nsec_timer::current_time_ns();
+    DASSERT(map.size() == 0);
+
+    coidlog_info("hashtest", name << ": insert " << double(t1 - t0) / n << "ns, find "
+        << double(t2 - t1) / (2 * n) << "ns, erase " << double(t3 - t2) / n << "ns (" << sum << ")");
+}
+
+///Compare chained and open addressing tables on random keys
+static void bench_swisstable()
+{
+    static const uint N = 200000;
+
+    dynarray<uint> keys;
+    keys.alloc(N);
+
+    uint x = 1;
+    for (uint i = 0; i < N; ++i) {
+        //xorshift, keys with the top bit clear so that ~k is never a key
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        keys[i] = (x & 0x7fffffff) | i;
+    }
+
+    bench_map<hash_map<uint, uint>>("hash_map", keys);
+    bench_map<swiss_map<uint, uint>>("swiss_map", keys);
+
+    interface_register::getlog()->flush();
+}
+
+void test_hash()
+{
+    test_string_hash();
+    test_concurrent_keyset();
+    test_incremental_rehash();
+    test_swisstable_semantics();
+    bench_swisstable();
+    bench_incremental_rehash();
+}
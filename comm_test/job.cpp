@@ -1,6 +1,8 @@
 
 #include "../taskmaster.h"
 #include "../log/logger.h"
+#include "../timer.h"
+#include <thread>
 
 struct jobtest
 {
@@ -10,6 +12,439 @@ struct jobtest
 };
 
 
+static void test_work_stealing()
+{
+    coid::taskmaster task(4, 1, coid::taskmaster::EScheduler::WORK_STEALING);
+    std::atomic_int count(0);
+
+    //tasks spawned from workers go to their local deques and get stolen by idle workers
+    task.parallel_for(0, 16, [&](int) {
+        coid::taskmaster::signal_handle inner;
+        for (int i = 0; i < 100; ++i)
+            task.push_functor(coid::taskmaster::EPriority::NORMAL, &inner, [&count]() { ++count; });
+        task.wait(inner);
+    });
+
+    DASSERT(count == 16 * 100);
+
+    task.terminate(true);
+}
+
+static void test_parallel_range()
+{
+    coid::taskmaster task(4, 1);
+
+    const int n = 100000;
+    coid::dynarray<int> data;
+    data.alloc(n);
+
+    task.parallel_for(0, n, 1000, [&](int i) { data[i] = i & 7; });
+
+    int64 sum = task.parallel_reduce<int64>(0, n, 0, 0,
+        [&](int b, int e, int64 acc) {
+            for (; b < e; ++b) acc += data[b];
+            return acc;
+        },
+        [](int64 a, int64 b) { return a + b; });
+
+    DASSERT(sum == int64(n / 8) * 28);
+
+    coid::dynarray<int64> prefix;
+    prefix.alloc(n);
+
+    int64 total = task.parallel_scan<int64>(0, n, 0, 0,
+        [&](int b, int e, int64 acc, bool final) {
+            for (; b < e; ++b) {
+                acc += data[b];
+                if (final) prefix[b] = acc;
+            }
+            return acc;
+        },
+        [](int64 a, int64 b) { return a + b; });
+
+    DASSERT(total == sum);
+    DASSERT(prefix[n - 1] == sum && prefix[0] == 0 && prefix[9] == 29);
+
+    task.terminate(true);
+}
+
+static void test_push_range()
+{
+    coid::taskmaster task(4, 1);
+    std::atomic_int count(0);
+
+    //spans several allocation blocks
+    coid::taskmaster::signal_handle signal;
+    task.push_range(coid::taskmaster::EPriority::NORMAL, &signal, 0, 1000, [&count](int i) { count += i; });
+    task.push_range(coid::taskmaster::EPriority::LOW, &signal, 0, 10, [&count](int i) { count += i; });
+    task.wait(signal);
+
+    DASSERT(count == 999 * 1000 / 2 + 45);
+
+    task.terminate(true);
+}
+
+static void test_task_graph()
+{
+    coid::taskmaster task(4, 1);
+    coid::taskmaster::task_graph graph;
+
+    //diamond a -> (b, c) -> d, with d also waiting for an external signal
+    int order[4];
+    std::atomic_int step;
+    auto a = graph.add(coid::taskmaster::EPriority::NORMAL, [&]() { order[0] = step++; }, "a");
+    auto b = graph.add(coid::taskmaster::EPriority::NORMAL, [&]() { order[1] = step++; }, "b");
+    auto c = graph.add(coid::taskmaster::EPriority::LOW, [&]() { order[2] = step++; }, "c");
+    auto d = graph.add(coid::taskmaster::EPriority::HIGH, [&]() { order[3] = step++; }, "d");
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+
+    coid::taskmaster::signal_handle external;
+    graph.depend(d, &external);
+
+    //graph is reused without rebuilding
+    for (int i = 0; i < 3; ++i) {
+        step = 0;
+        external = task.create_signal();
+
+        coid::taskmaster::signal_handle done;
+        task.push_graph(graph, &done);
+
+        coid::taskmaster::signal_handle other;
+        task.push_after(external, coid::taskmaster::EPriority::NORMAL, &other, [&]() { DASSERT(step >= 3); });
+
+        while (step < 3)
+            coid::thread::wait(0);
+
+        task.trigger_signal(external);
+        task.wait(done);
+        task.wait(other);
+
+        DASSERT(order[0] == 0 && order[1] > 0 && order[2] > 0 && order[3] == 3);
+    }
+
+    coid::dynarray<coid::taskmaster::task_graph::node_id> path;
+    graph.critical_path(path);
+    DASSERT(path.size() == 3 && path[0] == a && path[2] == d);
+
+    coid::charstr str;
+    coidlog_info("jobtest", graph.dump_critical_path(str));
+
+    task.terminate(true);
+}
+
+static void test_affinity()
+{
+    coid::taskmaster task(4, 1, coid::taskmaster::EScheduler::WORK_STEALING, coid::taskmaster::EAffinity::NUMA_NODE);
+    DASSERT(task.get_node_count() >= 1);
+
+    std::atomic_int count(0);
+    coid::taskmaster::signal_handle signal;
+
+    for (int i = 0; i < 100; ++i)
+        task.push(coid::taskmaster::affinity_hint::worker_thread(2), coid::taskmaster::EPriority::NORMAL, &signal, [&count]() { ++count; });
+    for (int i = 0; i < 100; ++i)
+        task.push(coid::taskmaster::affinity_hint::numa_node(0), coid::taskmaster::EPriority::LOW, &signal, [&count]() { ++count; });
+    task.wait(signal);
+
+    DASSERT(count == 200);
+
+    //tasks hinted to a worker are taken only by workers
+    uint64 ntasks = 0;
+    for (uint i = 0; i < task.get_workers_count(); ++i) {
+        coid::taskmaster::worker_stats stats = task.get_worker_stats(i);
+        ntasks += stats.ntasks;
+        coidlog_info("jobtest", "worker " << i << " node " << stats.node << ": " << stats.ntasks << " tasks, "
+            << stats.nsteals << " steals, idle " << (stats.idle_ns / 1000) << "us");
+    }
+    DASSERT(ntasks >= 100);
+
+    task.terminate(true);
+}
+
+///Tasks hinted to a busy worker get stolen by the idle ones
+static void test_affinity_busy()
+{
+    coid::taskmaster task(4, 1, coid::taskmaster::EScheduler::WORK_STEALING);
+
+    std::atomic_bool started(false), release(false);
+    task.push(coid::taskmaster::affinity_hint::worker_thread(2), coid::taskmaster::EPriority::NORMAL, nullptr, [&]() {
+        started = true;
+        while (!release)
+            coid::thread::wait(1);
+    });
+    while (!started)
+        coid::thread::wait(1);
+
+    int busy = -1;
+    for (uint i = 0; i < task.get_workers_count(); ++i)
+        if (task.get_worker_stats(i).ntasks == 1)
+            busy = int(i);
+    DASSERT(busy >= 0);
+
+    //not waiting on a signal, the main thread would run the tasks itself
+    std::atomic_int count(0);
+    for (int i = 0; i < 200; ++i)
+        task.push(coid::taskmaster::affinity_hint::worker_thread(busy), coid::taskmaster::EPriority::NORMAL, nullptr, [&count]() { ++count; });
+
+    for (int ms = 0; count < 200 && ms < 5000; ++ms)
+        coid::thread::wait(1);
+
+    int done = count;
+    release = true;
+    DASSERT(done == 200);
+
+    task.terminate(true);
+}
+
+///Measure push + run round trip of small tasks
+static void bench_task_roundtrip()
+{
+    //batches stay well within the task storage of the taskmaster
+    static const int NBATCH = 1000;
+    static const int N = 1000 * NBATCH;
+    coid::taskmaster task(1, 1, coid::taskmaster::EScheduler::WORK_STEALING);
+    std::atomic_int count(0);
+
+    //pushed by the worker into its own deque and run by it while waiting
+    //the main thread doesn't wait on the signal, it would keep stealing from the worker
+    uint64 local_ns = 0;
+    std::atomic_bool done(false);
+    task.push(coid::taskmaster::EPriority::HIGH, nullptr, [&]() {
+        uint64 t0 = coid::nsec_timer::current_time_ns();
+        for (int b = 0; b < N; b += NBATCH) {
+            coid::taskmaster::signal_handle inner;
+            for (int i = 0; i < NBATCH; ++i)
+                task.push(coid::taskmaster::EPriority::NORMAL, &inner, [&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+            task.wait(inner);
+        }
+        local_ns = coid::nsec_timer::current_time_ns() - t0;
+        done = true;
+    });
+    while (!done)
+        coid::thread::wait(1);
+
+    //pushed from outside to the shared queue
+    uint64 t0 = coid::nsec_timer::current_time_ns();
+    for (int b = 0; b < N; b += NBATCH) {
+        coid::taskmaster::signal_handle signal;
+        for (int i = 0; i < NBATCH; ++i)
+            task.push(coid::taskmaster::EPriority::NORMAL, &signal, [&count]() { count.fetch_add(1, std::memory_order_relaxed); });
+        task.wait(signal);
+    }
+    uint64 shared_ns = coid::nsec_timer::current_time_ns() - t0;
+
+    DASSERT(count == 2 * N);
+    coidlog_info("jobtest", "push+run round trip: worker deque " << (double(local_ns) / N) << "ns, shared queue "
+        << (double(shared_ns) / N) << "ns per task");
+
+    task.terminate(true);
+}
+
+#ifdef COID_TASKMASTER_COROUTINES
+
+static coid::taskmaster::co_task<int> co_double(int v)
+{
+    co_return 2 * v;
+}
+
+static coid::taskmaster::co_task<> co_job(coid::taskmaster& task, coid::taskmaster::critical_section& cs, std::atomic_int& sum, int& guarded)
+{
+    std::atomic_int count(0);
+    coid::taskmaster::signal_handle signal;
+    for (int i = 0; i < 10; ++i)
+        task.push(coid::taskmaster::EPriority::NORMAL, &signal, [&count]() { ++count; });
+    co_await signal;
+
+    DASSERT(count == 10);
+    sum += co_await co_double(count);
+
+    //suspending inside a critical section doesn't block the workers that wait for it
+    co_await cs;
+    signal = coid::taskmaster::invalid_signal;
+    task.push(coid::taskmaster::EPriority::HIGH, &signal, [&guarded]() { ++guarded; });
+    co_await signal;
+    task.leave_critical_section(cs);
+}
+
+static void test_coroutines()
+{
+    coid::taskmaster task(2, 1, coid::taskmaster::EScheduler::WORK_STEALING);
+    coid::taskmaster::critical_section cs;
+    std::atomic_int sum(0);
+    int guarded = 0;
+
+    coid::taskmaster::signal_handle signal;
+    for (int i = 0; i < 50; ++i)
+        task.push_co(coid::taskmaster::EPriority::NORMAL, &signal, co_job, std::ref(task), std::ref(cs), std::ref(sum), std::ref(guarded));
+    task.wait(signal);
+
+    DASSERT(sum == 50 * 20);
+    DASSERT(guarded == 50);
+
+    task.terminate(true);
+}
+
+#endif //COID_TASKMASTER_COROUTINES
+
+static void test_slotalloc_parallel()
+{
+    coid::taskmaster task(4, 1);
+    coid::slotalloc_tracking<int> data;
+
+    const int N = 10000;
+    for (int i = 0; i < N; ++i)
+        data.push(i);
+    for (int i = 0; i < N; i += 3)
+        data.del_item(i);
+
+    data.advance_frame();
+
+    data.parallel_for_each(task, [](int& v, uints id) { v = int(id) * 2; });
+
+    std::atomic<int64> psum(0);
+    data.parallel_for_each(task, [&psum](const int& v) { psum += v; });
+
+    int64 sum = 0;
+    data.for_each([&sum](const int& v, uints id) { DASSERT(v == int(id) * 2); sum += v; });
+    DASSERT(psum == sum);
+
+    std::atomic_int pmod(0);
+    data.parallel_for_each_modified(task, coid::slotalloc_detail::changeset::bitplane_mask(0), [&pmod](const int* p) { if (p) ++pmod; });
+
+    int nmod = 0;
+    data.for_each_modified(coid::slotalloc_detail::changeset::bitplane_mask(0), [&nmod](const int* p) { if (p) ++nmod; });
+    DASSERT(pmod == nmod && nmod == N - (N + 2) / 3);
+
+    const int* p = data.parallel_find_if(task, [](const int& v) { return v == 2 * 5000; });
+    DASSERT(p && *p == 2 * 5000);
+    DASSERT(!data.parallel_find_if(task, [](const int& v) { return v < 0; }));
+}
+
+///Threads insert and delete items concurrently, taking slots from their magazines
+static void test_slotalloc_multi()
+{
+    static const int NTHREADS = 4;
+    static const int NITEMS = 2000;
+    static const int NROUNDS = 4;
+
+    coid::slotalloc_versioning_multi<int> data;
+    data.reserve_virtual(NTHREADS * NITEMS * 2);
+
+    std::thread threads[NTHREADS];
+    for (int t = 0; t < NTHREADS; ++t) {
+        threads[t] = std::thread([&data, t]() {
+            coid::dynarray<coid::versionid> vids;
+
+            for (int r = 0; r < NROUNDS; ++r) {
+                vids.reset();
+
+                for (int i = 0; i < NITEMS; ++i) {
+                    uints id;
+                    *data.add(&id) = t * NITEMS + i;
+                    *vids.add() = data.get_item_versionid(id);
+                }
+
+                //slots are not shared with other threads
+                for (int i = 0; i < NITEMS; ++i)
+                    DASSERT(*data.get_item(vids[i]) == t * NITEMS + i);
+
+                if (r + 1 < NROUNDS) {
+                    for (const coid::versionid& vid : vids)
+                        data.del_item(vid);
+                }
+            }
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    DASSERT(data.count() == NTHREADS * NITEMS);
+
+    uints n = 0;
+    data.for_each([&n](const int& v) { ++n; });
+    DASSERT(n == NTHREADS * NITEMS);
+}
+
+///Vectorized bit scanning kernels must match the scalar ones
+static void test_bitscan()
+{
+    const coid::bitscan::kernels* scalar = coid::bitscan::get(coid::bitscan::level::scalar);
+
+    coid::uint8 buf[300];
+    coid::uint16 chs[77], chr[77];
+
+    for (int lvl = 0; lvl <= int(coid::bitscan::level::avx2); ++lvl)
+    {
+        const coid::bitscan::kernels* k = coid::bitscan::get(coid::bitscan::level(lvl));
+        if (!k)
+            continue;
+
+        for (uints n = 0; n < sizeof(buf); n += 7) {
+            for (coid::uint8 v : { coid::uint8(0), coid::uint8(0xff) }) {
+                ::memset(buf, v, sizeof(buf));
+                DASSERT(k->find_byte_not(buf, buf + n, v) == buf + n);
+
+                for (uints i = 0; i < n; i += 5) {
+                    buf[i] = v ^ 0x10;
+                    DASSERT(k->find_byte_not(buf, buf + n, v) == buf + i);
+                    DASSERT(k->find_byte_not(buf + 1, buf + n, v) == (i ? buf + i : buf + n));
+                    buf[i] = v;
+                }
+            }
+
+            for (uints i = 0; i < sizeof(buf); ++i)
+                buf[i] = coid::uint8(i * 37 + n);
+            DASSERT(k->population_count(buf, buf + n) == scalar->population_count(buf, buf + n));
+            DASSERT(k->population_count(buf + 3, buf + n) == scalar->population_count(buf + 3, buf + n));
+        }
+
+        //compare against the original changeset update for all frame residues
+        for (uint frame = 0; frame < 8; ++frame) {
+            bool b8 = (frame & 7) == 0;
+            bool b4 = (frame & 3) == 0;
+            bool b2 = (frame & 1) == 0;
+            coid::uint16 sel = coid::uint16((b8 ? 0xc000 : 0) | (b4 ? 0x3000 : 0) | (b2 ? 0x0f00 : 0));
+
+            for (int i = 0; i < 77; ++i)
+                chs[i] = chr[i] = coid::uint16(i * 2741 + frame * 977);
+
+            k->update_changeset(chs, chs + 77, sel);
+
+            for (int i = 0; i < 77; ++i) {
+                coid::uint16 v = chr[i];
+                coid::uint16 vs = (v << 1) & 0xaeff;
+                coid::uint16 va = ((v << 1) | (v << 2)) & 0x5100;
+                coid::uint16 vx = vs | va;
+
+                coid::uint16 r = ((b8 ? vx : v) & (3 << 14)) | ((b4 ? vx : v) & (3 << 12))
+                    | ((b2 ? vx : v) & (15 << 8)) | (vs & 0xff);
+                DASSERT(chs[i] == r);
+            }
+        }
+    }
+
+    //word level helpers on top of the best kernels
+    uints words[40] = {};
+    DASSERT(coid::find_word_not(words, words + 40, uints(0)) == words + 40);
+    words[33] = 0x80;
+    words[37] = uints(1) << (8 * sizeof(uints) - 1);
+    DASSERT(coid::find_word_not(words, words + 40, uints(0)) == words + 33);
+    DASSERT(coid::population_count(words, words + 40) == 2);
+
+    uints nbits = 0, sum = 0;
+    coid::for_each_set_bit(words, words + 40, [&](uints bit) { ++nbits; sum += bit; });
+    DASSERT(nbits == 2 && sum == 33 * 8 * sizeof(uints) + 7 + 38 * 8 * sizeof(uints) - 1);
+
+    ::memset(words, 0xff, sizeof(words));
+    words[21] = ~uints(0x30);
+    DASSERT(coid::find_zero_bitrange(2, words, words + 40) == 21 * 8 * sizeof(uints) + 4);
+    DASSERT(coid::find_zero_bitrange(3, words, words + 40) == 40 * 8 * sizeof(uints));
+}
+
 void test_job_queue()
 {
 #if 0
@@ -60,6 +495,8 @@ void test_job_queue()
     DASSERT( bits[0] == 0x00005c23 //0b00000000000000000101110000100010
         &&   bits[1] == 0 );
 
+    test_bitscan();
+
 
 
     coid::taskmaster task(7, 2);
@@ -74,5 +511,18 @@ void test_job_queue()
 
     task.terminate(true);
 
+    test_work_stealing();
+    test_parallel_range();
+    test_push_range();
+    test_task_graph();
+    test_affinity();
+    test_affinity_busy();
+    bench_task_roundtrip();
+    test_slotalloc_parallel();
+    test_slotalloc_multi();
+#ifdef COID_TASKMASTER_COROUTINES
+    test_coroutines();
+#endif
+
     //task.invoke();
 }
@@ -0,0 +1,130 @@
+#include "../log/logger.h"
+#include "../interface.h"
+#include "../timer.h"
+#include "../dir.h"
+#include "../binstream/filestream.h"
+#include "../binstream/binstreambuf.h"
+#include <atomic>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+using namespace coid;
+
+///Threads log more messages than fit into their rings, a filter counts them
+static void test_logger_threads()
+{
+    static const int NTHREADS = 4;
+    static const int NMSGS = 100;
+
+    logger* log = interface_register::getlog();
+
+    std::atomic_int nfiltered(0);
+    uints filter = log->register_filter(log_filter([&nfiltered](ref<logmsg>&) { ++nfiltered; }, "logtest", log::last));
+
+    uint64 t0 = nsec_timer::current_time_ns();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NTHREADS; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < NMSGS; ++i)
+                coidlog_debug("logtest", "thread " << t << " message " << i);
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    uint64 ns = nsec_timer::current_time_ns() - t0;
+
+    log->unregister_filter(filter);
+    log->flush();
+
+    DASSERT(nfiltered == NTHREADS * NMSGS);
+    coidlog_info("logtest", "logged " << NTHREADS * NMSGS << " messages from " << NTHREADS << " threads, "
+        << (double(ns) / (NTHREADS * NMSGS)) << "ns per message");
+    log->flush();
+}
+
+///A message held by the thread doesn't block the ones logged after it
+static void test_logger_held()
+{
+    logger* log = interface_register::getlog();
+
+    ref<logmsg> held = log->create_msg(log::debug, "logtest");
+    held->str() << "held message";
+
+    //more than a ring holds
+    for (int i = 0; i < 200; ++i)
+        coidlog_debug("logtest", "message " << i << " behind a held one");
+
+    uint64 t0 = nsec_timer::current_time_ns();
+    log->flush();
+    uint64 ms = (nsec_timer::current_time_ns() - t0) / 1000000;
+    DASSERT(ms < 1000);
+
+    held.release();
+    log->flush();
+}
+
+///Binary messages are formatted by the writer thread, or written to a binary log and decoded offline
+static void test_logger_binary()
+{
+    logger* lg = interface_register::getlog();
+
+    charstr text;
+    uints filter = lg->register_filter(log_filter([&text](ref<logmsg>& msg) { text = msg->str(); }, "bintest", log::last));
+
+    coidlog_bin(log::info, "bintest", "int {} str {} float {} ptr {} {}", -42, "abc", 0.5f, (const void*)0x1234, true);
+    lg->unregister_filter(filter);
+
+    DASSERT(text == "INFO: [bintest] int -42 str abc float 0.5 ptr 0x1234 true");
+
+    static const log_format fmt(log::debug, "bintest", "message {} of {} {}");
+    const char* path = "binlog.tmp";
+    {
+        logger blog(false, false);
+        blog.open_binary(path);
+
+        for (int i = 0; i < 3; ++i) {
+            ref<logmsg> msg = blog.create_msg(fmt);
+            log::write_arg(msg->args(), i);
+            log::write_arg(msg->args(), 3u);
+            log::write_arg(msg->args(), token("done"));
+        }
+
+        blog.flush();
+    }
+
+    bifstream bin(path);
+    binstreambuf out;
+    opcd e = logger::decode_binary(bin, out);
+    bin.close();
+    directory::delete_file(path);
+
+    DASSERT(!e);
+
+    //decoded time is the local time of day
+    time_t now = ::time(0);
+    struct tm const& tm = *localtime(&now);
+    uint minutes = tm.tm_hour * 60 + tm.tm_min;
+
+    token lines = out;
+    int n = 0;
+    while (lines) {
+        token line = lines.get_line();
+        token hrs = line.cut_left(':');
+        uint m = hrs.touint() * 60 + token(line.ptr(), 2).touint();
+        DASSERT(m == minutes || (m + 1) % 1440 == minutes);
+        DASSERT(line.ends_with(charstr() << "DEBUG: [bintest] message " << n << " of 3 done"));
+        ++n;
+    }
+    DASSERT(n == 3);
+}
+
+void test_logger()
+{
+    test_logger_threads();
+    test_logger_held();
+    test_logger_binary();
+}
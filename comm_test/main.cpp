@@ -8,6 +8,10 @@
 
 namespace coid {
 void std_test();
+void mmapstream_test();
+void asyncfilestream_test();
+void write_vec_test();
+void cachestream_test();
 void metastream_test();
 }
 
@@ -19,6 +23,9 @@ int main_atomic(int argc, char * argv[]);
 void regex_test();
 void test_malloc();
 void test_job_queue();
+void test_queue();
+void test_logger();
+void test_hash();
 
 void float_test()
 {
@@ -255,6 +262,55 @@ void test_slotalloc_virtual()
 #endif
 }
 
+///Column spans over the main and ext arrays
+void test_slotalloc_soa()
+{
+    struct velocity {
+        float x, y;
+    };
+
+    slotalloc<float, velocity, uint8> data;
+
+    for (uint i = 0; i < 1000; ++i) {
+        uints id;
+        *data.add(&id) = float(i);
+        data.value<0>(id) = velocity{ 1.0f, 2.0f };
+        data.value<1>(id) = uint8(i & 1);
+    }
+
+    for (uint i = 0; i < 1000; i += 5)
+        data.del_item(i);
+
+    uints nitems = 0;
+    data.for_each_run([&](uints id, uints n, float* pos, velocity* vel, uint8* flags) {
+        DASSERT(id / 256 == (id + n - 1) / 256);
+
+        for (uints i = 0; i < n; ++i)
+            pos[i] += vel[i].x * flags[i];
+        nitems += n;
+    });
+    DASSERT(nitems == data.count());
+
+    const uints NBITS = 8 * sizeof(uints);
+    uints npages = 0, nmasked = 0;
+    data.for_each_page([&](uints id, uints n, const uints* mask, float* pos, velocity* vel, uint8* flags) {
+        DASSERT(id % 256 == 0 && n <= 256);
+
+        for (uints i = 0; i < n; ++i) {
+            if (mask[i / NBITS] & (uints(1) << (i % NBITS))) {
+                pos[i] += vel[i].y;
+                ++nmasked;
+            }
+        }
+        ++npages;
+    });
+    DASSERT(npages == 4 && nmasked == data.count());
+
+    data.for_each([](const float& v, uints id) {
+        DASSERT(v == float(id + (id & 1) + 2));
+    });
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #ifdef COID_CONSTEXPR_IF
@@ -312,15 +368,26 @@ int main( int argc, char* argv[] )
 
     test_malloc();
     test_slotalloc_virtual();
+    test_slotalloc_soa();
 
     fntest(0);
 
     std_test();
+    mmapstream_test();
+    asyncfilestream_test();
+    write_vec_test();
+    cachestream_test();
 
     lambda_test();
 
     test_job_queue();
 
+    test_queue();
+
+    test_logger();
+
+    test_hash();
+
 #if 0
     static_assert( std::is_trivially_move_constructible<dynarray<char>>::value, "non-trivial move");
     static_assert( std::is_trivially_move_constructible<charstr>::value, "non-trivial move");
@@ -1,5 +1,13 @@
 
 #include "../dynarray.h"
+#include "../alloc/thread_cache.h"
+#include "../alloc/scope_arena.h"
+#include "../str.h"
+#include "../log/logger.h"
+#include "../interface.h"
+#include "../timer.h"
+#include <thread>
+#include <vector>
 
 using namespace coid;
 
@@ -40,8 +48,272 @@ static void test_miki()
     }
 }
 
+///Cached blocks keep working with usable size, in-place realloc and cross-thread frees
+static void test_thread_cache()
+{
+    mspace msp = SINGLETON(comm_array_mspace).msp;
+
+    void* p = thread_cache::alloc(msp, 100);
+    DASSERT(mspace_from_ptr(p) == msp && mspace_usable_size(p) >= 100);
+    thread_cache::free(p);
+
+    void* q = thread_cache::alloc(msp, 100);
+    DASSERT(q == p && mspace_usable_size(q) >= 100);
+    thread_cache::free(q);
+
+    //dynarray blocks go through the cache, growing in place must still work
+    dynarray<uint> a;
+    a.alloc(20);
+    uint* pa = a.ptr();
+    a.discard();
+    a.alloc(20);
+    DASSERT(a.ptr() == pa);
+    uint* pr = comm_array_allocator::realloc_in_place(a.ptr(), 22);
+    DASSERT(pr == pa && a.size() == 22);
+
+    //blocks allocated in one thread and freed in another
+    std::vector<void*> blocks;
+    for (uint i = 0; i < 1000; ++i)
+        blocks.push_back(thread_cache::alloc(i & 1 ? 0 : msp, 16 + i % 500));
+
+    std::thread t([&]() {
+        for (void* b : blocks)
+            thread_cache::free(b);
+    });
+    t.join();
+
+    thread_cache::flush();
+}
+
+///Arrays allocated inside the scope go into the arena, the last one grows in place
+static void test_scope_arena()
+{
+    dynarray<uint> outer;
+    outer.alloc(10);
+    mspace central = mspace_from_ptr((uints*)outer.ptr() - 1);
+
+    {
+        scope_arena arena;
+
+        charstr str = "parsed token";
+        dynarray<uint> a;
+        a.alloc(100);
+
+        DASSERT(mspace_from_ptr((uints*)str.ptr() - 1) == arena.space());
+        DASSERT(mspace_from_ptr((uints*)a.ptr() - 1) == arena.space());
+
+        uint* pa = a.ptr();
+        for (uint i = 0; i < 100000; ++i)
+            *a.add() = i;
+        DASSERT(a.ptr() == pa && a[100099] == 99999);
+
+        //existing arrays keep their memory space
+        outer.add(10000);
+        DASSERT(mspace_from_ptr((uints*)outer.ptr() - 1) == central);
+
+        //explicit use without installing
+        scope_arena nested(false);
+        dynarray<uint8> b;
+        b.reserve(64, false, nested.space());
+        DASSERT(mspace_from_ptr((uints*)b.ptr() - 1) == nested.space());
+
+        //long-lived state opts out of the arena
+        {
+            shared_mspace_guard shared;
+            outer.discard();
+            outer.alloc(10);
+        }
+        DASSERT(mspace_from_ptr((uints*)outer.ptr() - 1) == central);
+        DASSERT(comm_array_allocator::thread_mspace() == arena.space());
+
+        b.discard();
+        str.discard();
+        a.discard();
+    }
+
+    charstr after = "back in the shared space";
+    DASSERT(mspace_from_ptr((uints*)after.ptr() - 1) == central);
+}
+
+struct tracked_item {
+    COIDNEWDELETE(tracked_item);
+
+    uint8 data[48];
+};
+
+static const memtrack* find_tracked(const dynarray<memtrack>& list, const char* name)
+{
+    for (const memtrack& m : list)
+        if (m.name == name)
+            return &m;
+    return 0;
+}
+
+///Counters from multiple threads are aggregated on listing, samples follow live blocks
+static void test_memtrack()
+{
+    static const uint N = 1000;
+    const char* name = typeid(tracked_item).name();
+
+    bool was_enabled = memtrack_enable(true);
+    memtrack_reset();
+
+    std::vector<tracked_item*> items(N);
+    std::vector<std::thread> threads;
+    for (uint t = 0; t < 4; ++t) {
+        threads.emplace_back([&items, t]() {
+            for (uint i = t; i < N; i += 4)
+                items[i] = new tracked_item;
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    //free half of them in another thread than allocated
+    for (uint i = 0; i < N / 2; ++i)
+        delete items[i];
+
+    dynarray<memtrack> list;
+    list.alloc(memtrack_count());
+    list.resize(memtrack_list(list.ptr(), uint(list.size())));
+
+    const memtrack* m = find_tracked(list, name);
+    DASSERT(m && m->nallocs == N && m->ncurallocs == N / 2);
+    DASSERT(m->cursize == m->size / 2);
+
+    //second listing reports only changes since the first one
+    list.alloc(memtrack_count());
+    list.resize(memtrack_list(list.ptr(), uint(list.size())));
+    DASSERT(find_tracked(list, name) == 0);
+
+    for (uint i = N / 2; i < N; ++i)
+        delete items[i];
+
+    //sample all allocations
+    memtrack_sampling(1);
+    tracked_item* x = new tracked_item;
+
+    dynarray<memtrack_sample> samples;
+    samples.alloc(1000);
+    samples.resize(memtrack_samples(samples.ptr(), uint(samples.size())));
+
+    uints found = 0;
+    for (const memtrack_sample& s : samples)
+        if (s.name == name)
+            found += s.nframes > 0 ? 1 : 0;
+    DASSERT(found == 1);
+
+    delete x;
+    samples.alloc(1000);
+    samples.resize(memtrack_samples(samples.ptr(), uint(samples.size())));
+    for (const memtrack_sample& s : samples)
+        DASSERT(s.name != name);
+
+    memtrack_sampling(0);
+    memtrack_enable(was_enabled);
+}
+
+///Cost of tracked new/delete with tracking off and on
+static void bench_memtrack()
+{
+    static const uint N = 1000000;
+
+    bool was_enabled = memtrack_enable(false);
+
+    for (bool on : {false, true}) {
+        memtrack_enable(on);
+
+        for (uint nthreads : {1, 4}) {
+            uint64 t0 = nsec_timer::current_time_ns();
+
+            std::vector<std::thread> threads;
+            for (uint t = 0; t < nthreads; ++t) {
+                threads.emplace_back([]() {
+                    tracked_item* ring[64] = {};
+                    for (uint i = 0; i < N; ++i) {
+                        tracked_item*& slot = ring[i % 64];
+                        delete slot;
+                        slot = new tracked_item;
+                    }
+                    for (tracked_item* p : ring)
+                        delete p;
+                });
+            }
+            for (std::thread& t : threads)
+                t.join();
+
+            coidlog_info("malloc", "memtrack " << (on ? "on" : "off") << ", " << nthreads << " threads: "
+                << double(nsec_timer::current_time_ns() - t0) / N << "ns per new+delete");
+        }
+    }
+
+    memtrack_enable(was_enabled);
+    interface_register::getlog()->flush();
+}
+
+///Random size small allocations, each thread keeping a ring of live blocks
+template <class ALLOC, class FREE>
+static double bench_alloc_threads(uint nthreads, ALLOC alloc, FREE free)
+{
+    static const uint N = 1000000;
+    static const uint RING = 256;
+
+    uint64 t0 = nsec_timer::current_time_ns();
+
+    std::vector<std::thread> threads;
+    for (uint t = 0; t < nthreads; ++t) {
+        threads.emplace_back([=]() {
+            void* ring[RING] = {};
+            uint x = 1 + t;
+
+            for (uint i = 0; i < N; ++i) {
+                x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+                void*& slot = ring[i % RING];
+                free(slot);
+                slot = alloc(16 + x % 497);
+                *(uint*)slot = i;
+            }
+
+            for (void* p : ring)
+                free(p);
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    return double(nsec_timer::current_time_ns() - t0) / N;
+}
+
+///Compare direct mspace calls with the thread caching front end
+static void bench_thread_cache()
+{
+    mspace msp = SINGLETON(comm_array_mspace).msp;
+
+    for (uint nthreads : {1, 4}) {
+        double direct = bench_alloc_threads(nthreads,
+            [msp](size_t size) { return mspace_malloc(msp, size); },
+            [](void* p) { mspace_free(p); });
+
+        double cached = bench_alloc_threads(nthreads,
+            [msp](size_t size) { return thread_cache::alloc(msp, size); },
+            [](void* p) { thread_cache::free(p); });
+
+        coidlog_info("malloc", nthreads << " threads: mspace " << direct << "ns, thread cache "
+            << cached << "ns per alloc+free");
+    }
+
+    interface_register::getlog()->flush();
+}
+
 void test_malloc()
 {
+    test_thread_cache();
+    test_scope_arena();
+    test_memtrack();
+    bench_thread_cache();
+    bench_memtrack();
+
     //test_miki();
 
     /*while(1)
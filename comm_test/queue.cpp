@@ -0,0 +1,120 @@
+
+#include "../atomic/queue.h"
+#include "../sync/queue.h"
+#include "../timer.h"
+#include "../log/logger.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace coid;
+
+///Producers push nitems each, consumers pop until all items are consumed
+//@return elapsed time in ms
+template <class Q>
+static double contention(Q& q, int nproducers, int nconsumers, int nitems)
+{
+    std::atomic_int remaining(nproducers * nitems);
+    std::atomic<int64> sum(0);
+    std::vector<std::thread> threads;
+
+    uint64 t0 = nsec_timer::current_time_ns();
+
+    for (int p = 0; p < nproducers; ++p) {
+        threads.emplace_back([&q, nitems]() {
+            for (int i = 1; i <= nitems; ++i)
+                q.push(i);
+        });
+    }
+
+    for (int c = 0; c < nconsumers; ++c) {
+        threads.emplace_back([&q, &remaining, &sum]() {
+            int64 local = 0;
+            int v;
+            while (remaining > 0) {
+                if (q.pop(v)) {
+                    local += v;
+                    --remaining;
+                }
+                else
+                    std::this_thread::yield();
+            }
+            sum += local;
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    double ms = double(nsec_timer::current_time_ns() - t0) * 1e-6;
+
+    DASSERT(sum == int64(nproducers) * nitems * (nitems + 1) / 2);
+    DASSERT(q.is_empty());
+    return ms;
+}
+
+static void test_bounded_queue()
+{
+    atomic::bounded_queue<int> q(4);
+    DASSERT(q.capacity() == 4);
+
+    int v;
+    bool ok = q.pop(v);
+    DASSERT(!ok);
+
+    for (int i = 0; i < 4; ++i) {
+        ok = q.push(i);
+        DASSERT(ok);
+    }
+    ok = q.push(4);
+    DASSERT(!ok);
+
+    for (int i = 0; i < 4; ++i) {
+        ok = q.pop(v);
+        DASSERT(ok && v == i);
+    }
+    DASSERT(q.is_empty());
+}
+
+static void test_unbounded_queue()
+{
+    //fifo order across segments, non-trivial items
+    atomic::queue<charstr, 4> q;
+
+    for (int i = 0; i < 10; ++i)
+        q.push(charstr(i));
+
+    charstr v;
+    for (int i = 0; i < 10; ++i) {
+        bool ok = q.pop(v);
+        DASSERT(ok && v == charstr(i));
+    }
+
+    bool ok = q.pop(v);
+    DASSERT(!ok);
+    DASSERT(q.is_empty());
+
+    q.push("left in queue");
+}
+
+void test_queue()
+{
+    test_bounded_queue();
+    test_unbounded_queue();
+
+    const int nitems = 200000;
+    const int config[][2] = { {1, 1}, {4, 1}, {1, 4}, {4, 4} };
+
+    for (auto& c : config) {
+        coid::queue<int> mq;
+        atomic::queue<int> aq;
+        atomic::bounded_queue<int> bq(1 << 20);
+
+        double tm = contention(mq, c[0], c[1], nitems);
+        double ta = contention(aq, c[0], c[1], nitems);
+        double tb = contention(bq, c[0], c[1], nitems);
+
+        coidlog_info("queue", c[0] << "P/" << c[1] << "C, " << nitems << " items per producer: mutex "
+            << tm << "ms, lock-free " << ta << "ms, bounded " << tb << "ms");
+    }
+}
@@ -1,6 +1,10 @@
 
 #include "../binstream/stlstream.h"
 #include "../binstream/filestream.h"
+#include "../binstream/binstreambuf.h"
+#include "../binstream/cachestream.h"
+#include "../binstream/mmapstream.h"
+#include "../binstream/asyncfilestream.h"
 #include "../metastream/metastream.h"
 #include "../metastream/fmtstreamcxx.h"
 #include "../metastream/fmtstreamxml2.h"
@@ -78,4 +82,289 @@ void std_test()
     bif.close();
 }
 
+///Write a growing mapped file and read it back through views
+void mmapstream_test()
+{
+    {
+        mmapstream ms("mmap.test", "wct");
+        DASSERT(ms.is_open());
+
+        //several growth steps
+        for (uint i = 0; i < 40000; ++i)
+            ms.xwrite_token_raw(charstr() << "line " << i << "\n");
+        DASSERT(ms.get_size() > 65536);
+    }
+
+    mmapstream ms("mmap.test", "rS");
+    DASSERT(ms.is_open());
+
+    token all = ms;
+    DASSERT(all.begins_with("line 0\n") && all.ends_with("line 39999\n"));
+
+    binstreambuf line;
+    for (uint i = 0; i < 100; ++i) {
+        line.reset_write();
+        opcd e = ms.read_until(substring::newline(), &line);
+        DASSERT(e == 0);
+        DASSERT(token(line) == (charstr() << "line " << i));
+    }
+
+    token t = ms.read_token(9);
+    DASSERT(t == "line 100\n" && t.ptr() == all.ptr() + ms.get_read_pos() - 9);
+
+    ms.set_read_pos(all.len() - 6);
+    opcd e = ms.read_until(substring::newline(), 0);
+    DASSERT(e == 0);
+    e = ms.read_until(substring::newline(), 0);
+    DASSERT(e == ersNO_MORE);
+    ms.close();
+
+    //modify in place, preserving the content
+    {
+        mmapstream rw("mmap.test", "rw");
+        rw.set_write_pos(5);
+        rw.xwrite_raw("X", 1);
+        DASSERT(rw.read_view(7) == "line X\n");
+    }
+
+    ms.open("mmap.test");
+    DASSERT(ms.view(0, 7) == "line X\n" && ms.get_size() == all.len());
+}
+
+///Write and read back a file through both async backends, with odd sized chunks crossing blocks
+void asyncfilestream_test()
+{
+    static const uint N = 100000;
+
+    dynarray<uint> data;
+    data.alloc(N);
+    for (uint i = 0; i < N; ++i)
+        data[i] = i * 2654435761u;
+
+    async_file_io* backends[] = { async_file_io::uring(), async_file_io::pool() };
+
+    for (async_file_io* io : backends)
+    {
+        if (!io)
+            continue;
+
+        asyncfilestream out;
+        out.set_window(3, 4096, io);
+        opcd e = out.open("async.test", "wct");
+        DASSERT(e == 0);
+
+        const uint8* p = (const uint8*)data.ptr();
+        uints size = data.byte_size();
+        for (uints off = 0; off < size; ) {
+            uints n = off + 1000 < size ? 1000 : size - off;
+            uints len = n;
+            e = out.write_raw(p + off, len);
+            DASSERT(e == 0 && len == 0);
+            off += n;
+        }
+        e = out.close();
+        DASSERT(e == 0);
+
+        asyncfilestream in;
+        in.set_window(4, 8192, io);
+        e = in.open("async.test", "r");
+        DASSERT(e == 0);
+        DASSERT(in.get_size() == size);
+
+        dynarray<uint> back;
+        back.alloc(N);
+        uint8* q = (uint8*)back.ptr();
+        for (uints off = 0; off < size; ) {
+            e = in.peek_read(1000);
+            DASSERT(e == 0);
+            uints n = off + 777 < size ? 777 : size - off;
+            uints len = n;
+            e = in.read_raw(q + off, len);
+            DASSERT(e == 0);
+            off += n;
+        }
+        DASSERT(::memcmp(data.ptr(), back.ptr(), size) == 0);
+        e = in.peek_read(0);
+        DASSERT(e == ersNO_MORE);
+
+        uint v;
+        uints len = sizeof(v);
+        e = in.read_raw(&v, len);
+        DASSERT(e == ersNO_MORE);
+
+        //restart the read-ahead from a position
+        bool ok = in.set_read_pos(4 * 50000);
+        DASSERT(ok);
+        len = sizeof(v);
+        e = in.read_raw(&v, len);
+        DASSERT(e == 0 && v == data[50000]);
+    }
+
+    //completion through taskmaster signals
+    taskmaster tm(2, 0);
+
+    asyncfilestream in;
+    in.set_taskmaster(&tm);
+    in.set_window(2, 4096);
+    opcd e = in.open("async.test");
+    DASSERT(e == 0);
+
+    uint64 sum = 0, expected = 0;
+    for (uint i = 0; i < N; ++i)
+        expected += data[i];
+
+    for (;;) {
+        taskmaster::signal_handle sig = in.read_signal();
+        if (!sig.is_valid())
+            break;
+        tm.wait(sig);
+        e = in.peek_read(0);
+        DASSERT(e == 0);
+
+        uint buf[1024];
+        uints len = sizeof(buf);
+        e = in.read_raw(buf, len);
+        DASSERT(!e || e == ersNO_MORE);
+
+        for (uints i = 0; i < (sizeof(buf) - len) / sizeof(uint); ++i)
+            sum += buf[i];
+    }
+    DASSERT(sum == expected);
+}
+
+///Vectored writes through filestream and forwarded through cachestream
+void write_vec_test()
+{
+    charstr expected;
+    dynarray<charstr> parts;
+    dynarray<binstream::span> spans;
+
+    //more spans than a single writev batch, including empty ones
+    for (uint i = 0; i < 200; ++i) {
+        charstr& s = *parts.add();
+        if (i % 7)
+            s << "part" << i << ";";
+        expected << s;
+    }
+    for (const charstr& s : parts) {
+        binstream::span* v = spans.add();
+        v->ptr = s.ptr();
+        v->len = s.len();
+    }
+
+    {
+        bofstream bof("write_vec.test");
+        opcd e = bof.write_vec(spans.ptr(), spans.size());
+        DASSERT(e == 0);
+        DASSERT(bof.get_write_pos() == expected.len());
+    }
+
+    charstr back;
+    {
+        bifstream bif("write_vec.test");
+        uints len = uints(bif.get_size());
+        DASSERT(len == expected.len());
+        bif.read_raw(back.get_buf(len), len);
+        DASSERT(back == expected);
+    }
+
+    //small spans get cached, large ones forwarded together with the cached data
+    bofstream bof("write_vec.test");
+    cachestream cache(bof);
+
+    charstr large;
+    for (uint i = 0; i < 300; ++i)
+        large << "payload" << i;
+
+    binstream::span hdr[3] = { {"head", 4}, {large.ptr(), large.len()}, {"tail", 4} };
+    opcd e = cache.write_vec(hdr, 1);
+    DASSERT(e == 0);
+    e = cache.write_vec(hdr, 3);
+    DASSERT(e == 0);
+    e = cache.write_vec(spans.ptr(), spans.size());
+    DASSERT(e == 0);
+    e = cache.write_vec(hdr + 2, 1);
+    DASSERT(e == 0);
+    DASSERT(cache.get_write_pos() == 4 + 4 + large.len() + 4 + expected.len() + 4);
+    cache.flush();
+    bof.close();
+
+    expected = charstr() << "head" << "head" << large << "tail" << expected << "tail";
+
+    bifstream bif("write_vec.test");
+    uints len = uints(bif.get_size());
+    DASSERT(len == expected.len());
+    back.reset();
+    bif.read_raw(back.get_buf(len), len);
+    DASSERT(back == expected);
+}
+
+///File stream counting the reads
+class counting_ifstream : public bifstream
+{
+public:
+    uint reads = 0;
+
+    counting_ifstream(const zstring& name) : bifstream(name) {}
+
+    virtual opcd read_raw( void* p, uints& len ) override {
+        ++reads;
+        return bifstream::read_raw(p, len);
+    }
+};
+
+///Adaptive cache growth, cache bypass for large reads and zero-copy peek
+void cachestream_test()
+{
+    static const uint N = 1 << 20;
+
+    {
+        bofstream bof("cache.test");
+        for (uint i = 0; i < N; ++i)
+            bof.xwrite_raw(&i, sizeof(i));
+    }
+
+    //small sequential reads, the cache grows towards the limit
+    counting_ifstream bif("cache.test");
+    cachestream cache(bif);
+    cache.set_cache_limit(256 << 10);
+
+    for (uint i = 0; i < N / 2; ++i) {
+        uint v;
+        cache.xread_raw(&v, sizeof(v));
+        DASSERT(v == i);
+    }
+    DASSERT(bif.reads < 32);
+
+    //large reads bypass the cache
+    dynarray<uint> big;
+    big.alloc(N / 4);
+    uint reads = bif.reads;
+    cache.xread_raw(big.ptr(), big.byte_size());
+    DASSERT(big[0] == N / 2 && *big.last() == N / 2 + N / 4 - 1);
+    DASSERT(bif.reads - reads <= 2);
+
+    //peek within the cache and across its end
+    token t = cache.peek(8);
+    DASSERT(t.len() == 8 && ((const uint*)t.ptr())[1] == N / 2 + N / 4 + 1);
+    DASSERT(cache.peek(4).ptr() == t.ptr());
+    cache.consume(4);
+
+    t = cache.peek(300 << 10);
+    DASSERT(t.len() == 300 << 10);
+    DASSERT(((const uint*)t.ptr())[0] == N / 2 + N / 4 + 1);
+    cache.consume(t.len());
+
+    uint v;
+    cache.xread_raw(&v, sizeof(v));
+    DASSERT(v == N / 2 + N / 4 + 1 + (300 << 10) / 4);
+
+    //peek at the end of input is shorter
+    t = cache.peek(N);
+    DASSERT(t.len() == (N - v - 1) * sizeof(uint));
+    cache.consume(t.len());
+    DASSERT(cache.peek(1).len() == 0);
+    DASSERT(cache.size_read() == N * sizeof(uint));
+}
+
 } //namespace coid
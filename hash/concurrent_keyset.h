@@ -0,0 +1,522 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_CONCURRENT_KEYSET__HEADER_FILE__
+#define __COID_COMM_CONCURRENT_KEYSET__HEADER_FILE__
+
+#include "../namespace.h"
+#include "../alloc/commalloc.h"
+#include "hashkeyset.h"
+#include <atomic>
+#include <mutex>
+
+COID_NAMESPACE_BEGIN
+
+////////////////////////////////////////////////////////////////////////////////
+///Epoch based reclamation of memory unlinked by a writer while readers may still access it
+//@note readers announce the epoch they started in, retired memory is released once no reader
+// announced an epoch that is not newer than the one it was retired in
+class epoch_domain
+{
+public:
+
+    static const uint NSLOTS = 64;
+
+    ///Enter read side critical section
+    //@return slot to pass to leave()
+    uint enter() const
+    {
+        uint i = thread_ordinal();
+
+        for (;; ++i) {
+            slot& s = _slots[i % NSLOTS];
+            uint64 e = _epoch.load(std::memory_order_seq_cst);
+            uint64 z = 0;
+
+            if (!s.epoch.compare_exchange_strong(z, e, std::memory_order_seq_cst))
+                continue;
+
+            //the writer may have scanned the slots before the announcement became visible,
+            // re-announce until the epoch read afterwards matches
+            uint64 e2;
+            while ((e2 = _epoch.load(std::memory_order_seq_cst)) != e) {
+                s.epoch.store(e2, std::memory_order_seq_cst);
+                e = e2;
+            }
+
+            return i % NSLOTS;
+        }
+    }
+
+    ///Leave read side critical section
+    void leave(uint i) const {
+        _slots[i].epoch.store(0, std::memory_order_release);
+    }
+
+    ///Defer releasing memory until current readers leave
+    //@note must be called under writer's lock
+    void retire(void* p, void (*fn)(void*))
+    {
+        retired* r = (retired*)::dlmalloc(sizeof(retired));
+        r->p = p;
+        r->fn = fn;
+        r->epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+        r->next = 0;
+
+        *_tail = r;
+        _tail = &r->next;
+    }
+
+    ///Release retired memory that's no longer accessible by readers
+    //@note must be called under writer's lock
+    void collect()
+    {
+        if (!_head)
+            return;
+
+        uint64 min = _epoch.load(std::memory_order_seq_cst);
+
+        for (uint i = 0; i < NSLOTS; ++i) {
+            uint64 e = _slots[i].epoch.load(std::memory_order_seq_cst);
+            if (e && e < min)
+                min = e;
+        }
+
+        //retired in ascending epochs
+        while (_head && _head->epoch < min)
+            release_head();
+    }
+
+    epoch_domain() {
+        for (slot& s : _slots)
+            s.epoch.store(0, std::memory_order_relaxed);
+    }
+
+    ~epoch_domain()
+    {
+        while (_head)
+            release_head();
+    }
+
+private:
+
+    //padded to a cache line, but not over-aligned so that the owners can keep using COIDNEWDELETE
+    struct slot {
+        std::atomic<uint64> epoch;      //< epoch announced by a reader, 0 if unused
+        uint8 pad[64 - sizeof(std::atomic<uint64>)];
+    };
+
+    struct retired {
+        void* p;
+        void (*fn)(void*);
+        uint64 epoch;
+        retired* next;
+    };
+
+    mutable slot _slots[NSLOTS];
+    std::atomic<uint64> _epoch = {1};
+
+    //retired list allocated directly from dlmalloc, registries using this are created before
+    // and destroyed after the array allocator singleton
+    retired* _head = 0;
+    retired** _tail = &_head;
+
+    void release_head()
+    {
+        retired* r = _head;
+        _head = r->next;
+        if (!_head)
+            _tail = &_head;
+
+        r->fn(r->p);
+        ::dlfree(r);
+    }
+
+    ///Spread threads over the reader slots
+    static uint thread_ordinal() {
+        static std::atomic_uint nthreads = {0};
+        static thread_local uint order = nthreads++;
+        return order;
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+@class concurrent_keyset
+Hash keyset for read-mostly data, with lock-free lookups and writers serialized by a mutex.
+Values are never moved, erased values and replaced bucket arrays are released through an epoch_domain
+once the readers that could see them have left.
+@param VAL value type stored in hash table
+@param EXTRACTKEY key extractor from value type, EXTRACTKEY::ret_type is the type extracted
+@param HASHFUNC hash function, HASHFUNC::key_type should be the type used for lookup
+@param EQFUNC equality functor, comparing EXTRACTKEY::ret_type extracted from value with HASHFUNC::key_type lookup key
+**/
+template <
+    class VAL,
+    class EXTRACTKEY,
+    class HASHFUNC = hasher<typename type_base<typename EXTRACTKEY::ret_type>::type>,
+    class EQFUNC = equal_to<typename type_base<typename EXTRACTKEY::ret_type>::type, typename HASHFUNC::key_type>
+>
+class concurrent_keyset
+{
+public:
+
+    typedef typename HASHFUNC::key_type             key_type;
+    typedef VAL                                     value_type;
+    typedef EXTRACTKEY                              extractor;
+    typedef HASHFUNC                                hasherfn;
+    typedef EQFUNC                                  key_equal;
+
+    ///Read side critical section, values found inside stay valid until it ends
+    class read_guard
+    {
+        const epoch_domain& _domain;
+        uint _slot;
+
+    public:
+
+        explicit read_guard(const concurrent_keyset& set)
+            : _domain(set._domain), _slot(set._domain.enter())
+        {}
+
+        ~read_guard() {
+            _domain.leave(_slot);
+        }
+
+        read_guard(const read_guard&) = delete;
+        read_guard& operator = (const read_guard&) = delete;
+    };
+
+
+    ///Find value object corresponding to given key
+    //@note must be called within a read_guard scope or by a writer
+    const VAL* find_value(const key_type& k) const
+    {
+        uint64 h = _HASHFUNC(k);
+        const table* t = _table.load(std::memory_order_acquire);
+
+        for (const node* n = t->bucket(h).load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire))
+            if (n->hash == h && _EQFUNC(_EXTRACTKEY(n->val->value), k))
+                return &n->val->value;
+
+        return 0;
+    }
+
+    ///Find value object and invoke fn(const VAL&) on it inside a read side critical section
+    //@return true if found
+    template <class Fn>
+    bool find(const key_type& k, Fn fn) const
+    {
+        read_guard g(*this);
+
+        const VAL* v = find_value(k);
+        if (v)
+            fn(*v);
+        return v != 0;
+    }
+
+    ///Invoke fn(const VAL&) on all values inside a read side critical section
+    template <class Fn>
+    void for_each(Fn fn) const
+    {
+        read_guard g(*this);
+
+        const table* t = _table.load(std::memory_order_acquire);
+        for (uints i = 0; i <= t->mask; ++i)
+            for (const node* n = t->buckets[i].load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire))
+                fn(const_cast<const VAL&>(n->val->value));
+    }
+
+    ///Insert value if it's got an unique key
+    //@return NULL if the value could not be inserted, or a constant pointer to the value
+    const VAL* insert_value(const VAL& v) {
+        return insert_value_slot(_EXTRACTKEY(v), [&v](VAL& dst) { dst = v; });
+    }
+
+    ///Insert value if it's got an unique key
+    //@return NULL if the value could not be inserted, or a constant pointer to the value
+    const VAL* insert_value(VAL&& v) {
+        return insert_value_slot(_EXTRACTKEY(v), [&v](VAL& dst) { dst = std::move(v); });
+    }
+
+    ///Create a value under given key, initialized by fn(VAL&) before it's made visible to readers
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    //@return NULL if the key already exists, or a constant pointer to the value
+    template <class Fn>
+    const VAL* insert_value_slot(const key_type& key, Fn fn)
+    {
+        bool isnew;
+        const VAL* v = find_or_insert_value_slot(key, fn, &isnew);
+        return isnew ? v : 0;
+    }
+
+    ///Find or create a value under given key, a new value is initialized by fn(VAL&) before it's made visible to readers
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    template <class Fn>
+    const VAL* find_or_insert_value_slot(const key_type& key, Fn fn, bool* isnew = 0)
+    {
+        std::lock_guard<std::mutex> lock(_mx);
+
+        uint64 h = _HASHFUNC(key);
+        const VAL* v = find_value(key);
+        if (isnew)
+            *isnew = v == 0;
+        if (v)
+            return v;
+
+        item* it = new(::dlmalloc(sizeof(item))) item;
+        fn(it->value);
+        DASSERT(_EQFUNC(_EXTRACTKEY(it->value), key));
+
+        table* t = _table.load(std::memory_order_relaxed);
+        if (_count >= t->mask + 1)
+            t = grow(t);
+
+        link(t, new_node(h, it));
+        ++_count;
+
+        _domain.collect();
+        return &it->value;
+    }
+
+    ///Erase value by key
+    //@return true if the value was found
+    bool erase(const key_type& k)
+    {
+        std::lock_guard<std::mutex> lock(_mx);
+
+        bool found = erase_(_HASHFUNC(k), [&](const VAL& v) { return _EQFUNC(_EXTRACTKEY(v), k); });
+        _domain.collect();
+        return found;
+    }
+
+    ///Erase all values for which fn(const VAL&) returns true
+    //@note fn is invoked under writer's lock
+    //@return number of erased values
+    template <class Fn>
+    uints erase_if(Fn fn)
+    {
+        std::lock_guard<std::mutex> lock(_mx);
+
+        uints n = 0;
+        table* t = _table.load(std::memory_order_relaxed);
+
+        for (uints i = 0; i <= t->mask; ++i) {
+            std::atomic<node*>* pn = &t->buckets[i];
+            node* e;
+            while ((e = pn->load(std::memory_order_relaxed)) != 0) {
+                if (fn(const_cast<const VAL&>(e->val->value))) {
+                    unlink(pn, e);
+                    ++n;
+                }
+                else
+                    pn = &e->next;
+            }
+        }
+
+        _domain.collect();
+        return n;
+    }
+
+    ///Release object through fn(p) once the readers that could have accessed it have left
+    void retire(void* p, void (*fn)(void*))
+    {
+        std::lock_guard<std::mutex> lock(_mx);
+        _domain.retire(p, fn);
+        _domain.collect();
+    }
+
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+
+
+    concurrent_keyset()
+    {
+        _table.store(new_table(64), std::memory_order_relaxed);
+    }
+
+    concurrent_keyset(const concurrent_keyset&) = delete;
+    concurrent_keyset& operator = (const concurrent_keyset&) = delete;
+
+    ~concurrent_keyset()
+    {
+        table* t = _table.load(std::memory_order_relaxed);
+
+        for (uints i = 0; i <= t->mask; ++i)
+            for (node* n = t->buckets[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed))
+                free_item(n->val);
+
+        free_table(t);
+    }
+
+private:
+
+    struct item {
+        VAL value;
+    };
+
+    ///Bucket chain link, bucket arrays get new links on growth while the items stay in place
+    struct node {
+        std::atomic<node*> next;
+        item* val;
+        uint64 hash;
+    };
+
+    struct table {
+        uints mask;
+        uint shift;
+        std::atomic<node*> buckets[1];
+
+        std::atomic<node*>& bucket(uint64 hash) { return buckets[index(hash)]; }
+        const std::atomic<node*>& bucket(uint64 hash) const { return buckets[index(hash)]; }
+
+        uints index(uint64 hash) const {
+            //fibonacci hashing
+            hash ^= hash >> shift;
+            return uints((11400714819323198485llu * hash) >> shift);
+        }
+    };
+
+    std::atomic<table*> _table;
+    uints _count = 0;
+
+    std::mutex _mx;                     //< serializes writers
+    epoch_domain _domain;
+
+    HASHFUNC    _HASHFUNC;
+    EQFUNC      _EQFUNC;
+    EXTRACTKEY  _EXTRACTKEY;
+
+
+    static node* new_node(uint64 h, item* it)
+    {
+        node* n = (node*)::dlmalloc(sizeof(node));
+        n->next.store(0, std::memory_order_relaxed);
+        n->val = it;
+        n->hash = h;
+        return n;
+    }
+
+    static table* new_table(uints nbuckets)
+    {
+        table* t = (table*)::dlmalloc(sizeof(table) + (nbuckets - 1) * sizeof(std::atomic<node*>));
+        t->mask = nbuckets - 1;
+        t->shift = 64 - int_high_pow2(nbuckets);
+        for (uints i = 0; i < nbuckets; ++i)
+            t->buckets[i].store(0, std::memory_order_relaxed);
+        return t;
+    }
+
+    static void free_item(void* p)
+    {
+        static_cast<item*>(p)->~item();
+        ::dlfree(p);
+    }
+
+    ///Free bucket array with its links, items are kept
+    static void free_table(void* p)
+    {
+        table* t = static_cast<table*>(p);
+
+        for (uints i = 0; i <= t->mask; ++i) {
+            node* n = t->buckets[i].load(std::memory_order_relaxed);
+            while (n) {
+                node* next = n->next.load(std::memory_order_relaxed);
+                ::dlfree(n);
+                n = next;
+            }
+        }
+
+        ::dlfree(t);
+    }
+
+    ///Publish node at the head of its bucket
+    static void link(table* t, node* n)
+    {
+        std::atomic<node*>& b = t->bucket(n->hash);
+        n->next.store(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        b.store(n, std::memory_order_release);
+    }
+
+    ///Unlink node from the chain, readers standing on it can still continue to its successor
+    void unlink(std::atomic<node*>* pn, node* e)
+    {
+        pn->store(e->next.load(std::memory_order_relaxed), std::memory_order_release);
+        --_count;
+
+        _domain.retire(e->val, &free_item);
+        _domain.retire(e, &::dlfree);
+    }
+
+    template <class Fn>
+    bool erase_(uint64 h, Fn match)
+    {
+        table* t = _table.load(std::memory_order_relaxed);
+        std::atomic<node*>* pn = &t->bucket(h);
+        node* e;
+
+        while ((e = pn->load(std::memory_order_relaxed)) != 0) {
+            if (e->hash == h && match(e->val->value)) {
+                unlink(pn, e);
+                return true;
+            }
+            pn = &e->next;
+        }
+
+        return false;
+    }
+
+    ///Double the bucket array, new links are built while readers continue on the old ones
+    table* grow(table* t)
+    {
+        table* nt = new_table(2 * (t->mask + 1));
+
+        for (uints i = 0; i <= t->mask; ++i)
+            for (node* n = t->buckets[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed))
+                link(nt, new_node(n->hash, n->val));
+
+        _table.store(nt, std::memory_order_release);
+        _domain.retire(t, &free_table);
+
+        return nt;
+    }
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_CONCURRENT_KEYSET__HEADER_FILE__
@@ -72,46 +72,154 @@ template<class KEY, bool INSENSITIVE = false> struct hasher
     }
 };
 
-///FNV-1a hash
-inline coid_constexpr_for uint __coid_hash_c_string(const char* s, uint seed = 2166136261u)
+///FNV-1a hash, byte at a time
+//@note kept for hashes that are persisted, like the intergen interface ids
+inline coid_constexpr_for uint __coid_hash_string_fnv(const char* s, uints n, uint seed = 2166136261u)
 {
-    for (; *s; ++s)
+    for (; n > 0; ++s, --n)
         seed = (seed ^ *s) * 16777619u;
 
     return seed;
 }
 
-inline coid_constexpr_for uint __coid_hash_string(const char* s, uints n, uint seed = 2166136261u)
+////////////////////////////////////////////////////////////////////////////////
+//@{ word at a time string hash (wyhash), evaluable at compile time
+
+///64x64 -> 128 bit multiply, low and high halves returned in a and b
+inline coid_constexpr_for void __coid_hash_mum(uint64& a, uint64& b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = __uint128_t(a) * b;
+    a = uint64(r);
+    b = uint64(r >> 64);
+#else
+    uint64 ha = a >> 32, la = uint32(a), hb = b >> 32, lb = uint32(b);
+    uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64 t = rl + (rm0 << 32);
+    uint64 c = t < rl;
+    uint64 lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+inline coid_constexpr_for uint64 __coid_hash_mix(uint64 a, uint64 b)
+{
+    __coid_hash_mum(a, b);
+    return a ^ b;
+}
+
+///Lowercase ASCII letters in all 8 bytes at once
+inline constexpr uint64 __coid_hash_fold8(uint64 w)
+{
+    return w | (((((w & 0x7f7f7f7f7f7f7f7full) + 0x3f3f3f3f3f3f3f3full)
+        ^ ((w & 0x7f7f7f7f7f7f7f7full) + 0x2525252525252525ull))
+        & ~w & 0x8080808080808080ull) >> 2);
+}
+
+//little endian reads assembled from bytes, so that the result is the same in constant evaluation
+template<bool INSENSITIVE>
+inline coid_constexpr_for uint64 __coid_hash_read8(const char* p)
 {
-    //for( ; n>0; ++s,--n)
-    //    seed = (seed ^ *s)*16777619u;
+    uint64 v = uint64(uint8(p[0])) | uint64(uint8(p[1])) << 8 | uint64(uint8(p[2])) << 16 | uint64(uint8(p[3])) << 24
+        | uint64(uint8(p[4])) << 32 | uint64(uint8(p[5])) << 40 | uint64(uint8(p[6])) << 48 | uint64(uint8(p[7])) << 56;
+    return INSENSITIVE ? __coid_hash_fold8(v) : v;
+}
+
+template<bool INSENSITIVE>
+inline coid_constexpr_for uint64 __coid_hash_read4(const char* p)
+{
+    uint64 v = uint64(uint8(p[0])) | uint64(uint8(p[1])) << 8 | uint64(uint8(p[2])) << 16 | uint64(uint8(p[3])) << 24;
+    return INSENSITIVE ? __coid_hash_fold8(v) : v;
+}
+
+///Reads 1..3 bytes
+template<bool INSENSITIVE>
+inline coid_constexpr_for uint64 __coid_hash_read3(const char* p, uints n)
+{
+    uint64 v = uint64(uint8(p[0])) << 16 | uint64(uint8(p[n >> 1])) << 8 | uint64(uint8(p[n - 1]));
+    return INSENSITIVE ? __coid_hash_fold8(v) : v;
+}
 
-    //unrolled
-    for (uints i = 0; i < (n&-2); i += 2) {
-        seed = (seed ^ s[i]) * 16777619u;
-        seed = (seed ^ s[i + 1]) * 16777619u;
+template<bool INSENSITIVE>
+inline coid_constexpr_for uint __coid_hash_wy(const char* p, uints n, uint64 seed)
+{
+    const uint64 s0 = 0xa0761d6478bd642full, s1 = 0xe7037ed1a0b428dbull;
+    const uint64 s2 = 0x8ebc6af09c88c6e3ull, s3 = 0x589965cc75374cc3ull;
+
+    seed ^= __coid_hash_mix(seed ^ s0, s1);
+
+    uint64 a = 0, b = 0;
+    if (n <= 16) {
+        if (n >= 4) {
+            uints q = (n >> 3) << 2;
+            a = (__coid_hash_read4<INSENSITIVE>(p) << 32) | __coid_hash_read4<INSENSITIVE>(p + q);
+            b = (__coid_hash_read4<INSENSITIVE>(p + n - 4) << 32) | __coid_hash_read4<INSENSITIVE>(p + n - 4 - q);
+        }
+        else if (n > 0)
+            a = __coid_hash_read3<INSENSITIVE>(p, n);
+    }
+    else {
+        uints i = n;
+        if (i > 48) {
+            uint64 seed1 = seed, seed2 = seed;
+            do {
+                seed = __coid_hash_mix(__coid_hash_read8<INSENSITIVE>(p) ^ s1, __coid_hash_read8<INSENSITIVE>(p + 8) ^ seed);
+                seed1 = __coid_hash_mix(__coid_hash_read8<INSENSITIVE>(p + 16) ^ s2, __coid_hash_read8<INSENSITIVE>(p + 24) ^ seed1);
+                seed2 = __coid_hash_mix(__coid_hash_read8<INSENSITIVE>(p + 32) ^ s3, __coid_hash_read8<INSENSITIVE>(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            }
+            while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = __coid_hash_mix(__coid_hash_read8<INSENSITIVE>(p) ^ s1, __coid_hash_read8<INSENSITIVE>(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = __coid_hash_read8<INSENSITIVE>(p + i - 16);
+        b = __coid_hash_read8<INSENSITIVE>(p + i - 8);
     }
-    if (n & 1)
-        seed = (seed ^ s[n - 1]) * 16777619u;
 
-    return seed;
+    a ^= s1;
+    b ^= seed;
+    __coid_hash_mum(a, b);
+    return uint(__coid_hash_mix(a ^ s0 ^ n, b ^ s1));
 }
 
-inline coid_constexpr_for uint __coid_hash_c_string_insensitive(const char* s, uint seed = 2166136261u)
+//@}
+
+inline coid_constexpr_for uints __coid_hash_strlen(const char* s)
 {
-    for (; *s; ++s)
-        seed = (seed ^ ::tolower(*s)) * 16777619u;
+    uints n = 0;
+    while (s[n])
+        ++n;
+    return n;
+}
 
-    return seed;
+///String hash, 8 bytes per step
+inline coid_constexpr_for uint __coid_hash_string(const char* s, uints n, uint seed = 2166136261u)
+{
+    return __coid_hash_wy<false>(s, n, seed);
 }
 
+inline coid_constexpr_for uint __coid_hash_c_string(const char* s, uint seed = 2166136261u)
+{
+    return __coid_hash_wy<false>(s, __coid_hash_strlen(s), seed);
+}
 
+///Case insensitive string hash, ASCII letters folded 8 at a time
+//@note equals __coid_hash_string of the lowercased string
 inline coid_constexpr_for uint __coid_hash_string_insensitive(const char* s, uints n, uint seed = 2166136261u)
 {
-    for (; n > 0; ++s, --n)
-        seed = (seed ^ ::tolower(*s)) * 16777619u;
+    return __coid_hash_wy<true>(s, n, seed);
+}
 
-    return seed;
+inline coid_constexpr_for uint __coid_hash_c_string_insensitive(const char* s, uint seed = 2166136261u)
+{
+    return __coid_hash_wy<true>(s, __coid_hash_strlen(s), seed);
 }
 
 inline constexpr uint __coid_hash_string(char c, uint seed = 2166136261u)
@@ -164,24 +272,14 @@ DIRECT_HASH_FUNC(ulong);
 
 //String literal hashing
 
-template<size_t I>
-inline constexpr uint literal_hash(const char* str) {
-    return (literal_hash<I - 1>(str) ^ str[I - 1]) * 16777619ULL;
-}
-
-template<>
-inline constexpr uint literal_hash<0>(const char* str) {
-    return 2166136261U;
+template<size_t N>
+inline coid_constexpr_for uint literal_hash(const char(&str)[N]) {
+    return __coid_hash_string(str, N - 1);
 }
 
 template<size_t N>
-inline constexpr uint literal_hash(const char(&str)[N]) {
-    return literal_hash<N - 1>(str);
-}
-
-template<size_t N>
-inline constexpr uint literal_hash(char(&str)[N]) {
-    return literal_hash<N - 1>(str);
+inline coid_constexpr_for uint literal_hash(char(&str)[N]) {
+    return __coid_hash_string(str, N - 1);
 }
 
 uint string_hash(const token& tok);
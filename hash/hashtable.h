@@ -139,8 +139,12 @@ public:
 
 private:
     dynarray<Node*> _table;
+    dynarray<Node*> _otable;            //< previous bucket array while an incremental rehash is pending
     uints _nelem;
+    uints _omig = 0;                    //< next bucket of _otable to migrate
     uint _shift = 64;
+    uint _oshift = 64;
+    uint _rehash_budget = 0;            //< buckets migrated per insert or erase, 0 to rehash at once
 
     typedef hashtable<VAL, HASHFUNC, EQFUNC, GETKEYFUNC, ALLOC>  _Self;
 
@@ -169,6 +173,18 @@ protected:
         return uints((11400714819323198485llu * hash) >> shift);
     }
 
+    ///Bucket chain for given hash
+    //@note during incremental rehash the keys stay in the old bucket until it's migrated
+    Node* const* chain(uint64 hash) const
+    {
+        if (_otable.size()) {
+            Node* const* po = &_otable[bucket_from_hash(hash, _oshift)];
+            if (*po)
+                return po;
+        }
+        return &_table[bucket_from_hash(hash, _shift)];
+    }
+
 public:
 
     const HASHFUNC& hash_func() const { return _HASHFUNC; }
@@ -375,8 +391,7 @@ protected:
     ///Find first node that matches the key, provided hash value is given
     Node* find_node(uint64 hash, const LOOKUP& k) const
     {
-        uints h = bucket_from_hash(hash, _shift);
-        Node* n = (Node*)_table[h];
+        Node* n = *chain(hash);
         while (n)
         {
             if (_EQFUNC(_GETKEYFUNC(n->_val), k))
@@ -389,22 +404,7 @@ protected:
     ///Find first node that matches the key
     Node* find_node(const LOOKUP& k) const
     {
-        uints h = bucket(k, _shift);
-        Node* n = (Node*)_table[h];
-        while (n)
-        {
-            if (_EQFUNC(_GETKEYFUNC(n->_val), k))
-                return n;
-            n = n->_next;
-        }
-        return 0;
-    }
-
-    ///Find first node that matches the key
-    Node* find_node(const LOOKUP& k, uints& slot) const
-    {
-        slot = bucket(k, _shift);
-        Node* n = (Node*)_table[slot];
+        Node* n = *chain(_HASHFUNC(k));
         while (n)
         {
             if (_EQFUNC(_GETKEYFUNC(n->_val), k))
@@ -428,16 +428,22 @@ protected:
         return n;
     }
 
-    ///Find first node that matches the key
-    Node** find_socket(const LOOKUP& k) const {
+    ///Find first node that matches the key, for modification
+    //@note pending old bucket with the key is migrated first, so that the socket is in the current array
+    Node** find_socket(const LOOKUP& k)
+    {
+        if (_otable.size())
+            rehash_key(_HASHFUNC(k));
         return find_socket_ext(_table, _shift, k);
     }
 
     ///Find socket with given value
-    Node** find_socket_val(const VAL* val, uints socket = UMAXS) const
+    Node** find_socket_val(const VAL* val, uint64 hash)
     {
-        uints h = socket != UMAXS ? socket : bucket(_GETKEYFUNC(*val), _shift);
-        Node** pn = (Node**)&_table[h];
+        if (_otable.size())
+            rehash_key(hash);
+
+        Node** pn = &_table[bucket_from_hash(hash, _shift)];
         Node* n = *pn;
         while (n && &n->_val != val)
         {
@@ -472,9 +478,9 @@ protected:
     Node** get_socket(const Node* n) const
     {
         if (!n)  return 0;
-        uints h = bucket(_GETKEYFUNC(n->_val), _shift);
 
-        Node** pn = (Node**)&_table[h];
+        //no migration here, iterators over the old buckets must stay valid
+        Node** pn = (Node**)chain(_HASHFUNC(_GETKEYFUNC(n->_val)));
         while (*pn)
         {
             if (*pn == n)
@@ -526,21 +532,25 @@ public:
     {
         if (!cn)  return 0;
 
-        uints h = bucket(_GETKEYFUNC(cn->_val), _shift);
+        uint64 hash = _HASHFUNC(_GETKEYFUNC(cn->_val));
+
+        //pending old buckets are iterated first
+        if (_otable.size()) {
+            uints h = bucket_from_hash(hash, _oshift);
+            if (_otable[h]) {
+                Node* n = get_nonempty(_otable, h + 1);
+                return n ? n : get_nonempty(_table, 0);
+            }
+        }
+
+        uints h = bucket_from_hash(hash, _shift);
         DASSERTX(_table[h] != 0, "probably mixed keys and different hash functions used");
 
-        return get_nonempty(++h);
+        return get_nonempty(_table, ++h);
     }
 
-    Node* get_nonempty(uints slot) const
-    {
-        uints n = _table.size();
-        for (; slot < n; ++slot)
-        {
-            if (_table[slot])
-                return (Node*)_table[slot];
-        }
-        return 0;
+    Node* get_nonempty(uints slot) const {
+        return get_nonempty(_table, slot);
     }
 
     size_t size() const { return _nelem; }
@@ -553,16 +563,20 @@ public:
         std::swap(a._EQFUNC, b._EQFUNC);
         std::swap(a._GETKEYFUNC, b._GETKEYFUNC);
         std::swap(a._table, b._table);
+        std::swap(a._otable, b._otable);
         std::swap(a._nelem, b._nelem);
+        std::swap(a._omig, b._omig);
+        std::swap(a._shift, b._shift);
+        std::swap(a._oshift, b._oshift);
+        std::swap(a._rehash_budget, b._rehash_budget);
     }
 
     iterator begin()
     {
-        uints n = _table.size();
-        for (uints i = 0; i < n; ++i)
-            if (_table[i])
-                return iterator(_table[i], *this);
-        return end();
+        Node* n = get_nonempty(_otable, 0);
+        if (!n)
+            n = get_nonempty(_table, 0);
+        return n ? iterator(n, *this) : end();
     }
 
     iterator end() {
@@ -571,11 +585,10 @@ public:
 
     const_iterator begin() const
     {
-        uints n = _table.size();
-        for (uints i = 0; i < n; ++i)
-            if (_table[i])
-                return const_iterator(_table[i], *this);
-        return end();
+        const Node* n = get_nonempty(_otable, 0);
+        if (!n)
+            n = get_nonempty(_table, 0);
+        return n ? const_iterator(n, *this) : end();
     }
 
     const_iterator end() const {
@@ -591,6 +604,7 @@ public:
         return size_t(-1);
     }
 
+    //@note counts only the current bucket array during incremental rehash
     size_t elems_in_bucket(size_t k) const
     {
         Node* n = _table[k];
@@ -635,8 +649,7 @@ public:
 
     std::pair<iterator, iterator> equal_range(const LOOKUP& k)
     {
-        uints slot;
-        Node* f = find_node(k, slot);
+        Node* f = find_node(k);
         if (!f)
             return std::pair<iterator, iterator>(end(), end());
 
@@ -644,14 +657,13 @@ public:
         while (l  &&  _EQFUNC(_GETKEYFUNC(l->_val), k))
             l = l->_next;
 
-        if (!l)  l = get_nonempty(++slot);
+        if (!l)  l = get_next(f);
         return std::pair<iterator, iterator>(iterator(f, *this), iterator(l, *this));
     }
 
     std::pair<const_iterator, const_iterator> equal_range(const LOOKUP& k) const
     {
-        uints slot;
-        const Node* f = find_node(k, slot);
+        const Node* f = find_node(k);
         if (!f)
             return std::pair<const_iterator, const_iterator>(end(), end());
 
@@ -659,7 +671,7 @@ public:
         while (l  &&  _EQFUNC(_GETKEYFUNC(l->_val), k))
             l = l->_next;
 
-        if (!l)  l = get_nonempty(++slot);
+        if (!l)  l = get_next(f);
         return std::pair<const_iterator, const_iterator>(const_iterator(f, *this), const_iterator(l, *this));
     }
 
@@ -677,7 +689,7 @@ public:
 
     ///Erase value provided external key (if key in value was already destroyed)
     bool erase_value_slot(const VAL* dst, const LOOKUP& key) {
-        return this->__erase_value_slot(dst, bucket(key, _shift));
+        return this->__erase_value_slot(dst, _HASHFUNC(key));
     }
 
     size_t erase(const LOOKUP& k) {
@@ -714,6 +726,7 @@ public:
 
 
     //@return true if the underlying array was resized
+    //@note in incremental rehash mode the old bucket array is kept and migrated gradually
     bool resize(size_t bucketn)
     {
         uints ts = _table.size();
@@ -724,6 +737,21 @@ public:
 
             shift = 64 - shift;
 
+            //previous migration should have been finished long ago, unless growing by reserve
+            rehash_step(UMAXS);
+
+            if (_rehash_budget && _nelem)
+            {
+                std::swap(_otable, _table);
+                _oshift = _shift;
+                _omig = 0;
+
+                _table.need_newc(nb);
+                _ALLOC.reserve(nb);
+                _shift = shift;
+                return true;
+            }
+
             dynarray<Node*> temp;
             temp.need_newc(nb);
             _ALLOC.reserve(nb);
@@ -753,19 +781,47 @@ public:
         return false;
     }
 
+    ///Set incremental rehash mode, where growing keeps the old bucket array and migrates it gradually
+    //@param budget number of old buckets migrated by each insert or erase, 0 to rehash at once
+    //@note lookups on const tables don't migrate, so that concurrent readers stay safe
+    void set_incremental_rehash(uint budget)
+    {
+        _rehash_budget = budget;
+        if (!budget)
+            rehash_step(UMAXS);
+    }
+
+    ///Migrate given number of buckets from the old bucket array
+    //@return true if there are still buckets left to migrate
+    bool rehash_step(uints budget)
+    {
+        uints n = _otable.size();
+        if (!n)
+            return false;
+
+        for (; budget > 0 && _omig < n; --budget, ++_omig)
+            rehash_bucket(_omig);
+
+        if (_omig < n)
+            return true;
+
+        _otable.discard();
+        _omig = 0;
+        return false;
+    }
+
+    //@return true if an incremental rehash is pending
+    bool rehash_pending() const {
+        return _otable.size() > 0;
+    }
+
     void clear()
     {
-        for (uints i = 0; i < _table.size(); ++i)
-        {
-            Node* n = _table[i];
-            while (n)
-            {
-                Node* t = n->_next;
-                _ALLOC.free(n);
-                n = t;
-            }
-            _table[i] = 0;
-        }
+        free_chains(_otable);
+        _otable.discard();
+        _omig = 0;
+
+        free_chains(_table);
 
         _nelem = 0;
         //_table.need_newc(64);
@@ -862,13 +918,29 @@ private:
     {
         uints n = ht._table.size();
         _table.reset();
+        _nelem = 0;
         resize(n);
-        _ALLOC.reserve(n);
+        _ALLOC.reserve(n + ht._otable.size());
+
+        copy_chains(_table, ht._table);
+
+        if (ht._otable.size()) {
+            _otable.need_newc(ht._otable.size());
+            copy_chains(_otable, ht._otable);
+        }
+
+        _oshift = ht._oshift;
+        _rehash_budget = ht._rehash_budget;
+        _omig = ht._omig;
+        _nelem = ht._nelem;
+    }
 
-        for (uints h = 0; h < n; ++h)
+    void copy_chains(dynarray<Node*>& dst, const dynarray<Node*>& src)
+    {
+        for (uints h = 0, n = src.size(); h < n; ++h)
         {
-            Node** pn = &_table[h];
-            const Node* cn = ht._table[h];
+            Node** pn = &dst[h];
+            const Node* cn = src[h];
             while (cn)
             {
                 Node* n = new(_ALLOC.alloc_uninit()) Node(*cn);
@@ -878,8 +950,60 @@ private:
             }
             *pn = 0;
         }
+    }
 
-        _nelem = ht._nelem;
+    void free_chains(dynarray<Node*>& table)
+    {
+        for (uints i = 0; i < table.size(); ++i)
+        {
+            Node* n = table[i];
+            while (n)
+            {
+                Node* t = n->_next;
+                _ALLOC.free(n);
+                n = t;
+            }
+            table[i] = 0;
+        }
+    }
+
+    static Node* get_nonempty(const dynarray<Node*>& table, uints slot)
+    {
+        uints n = table.size();
+        for (; slot < n; ++slot)
+        {
+            if (table[slot])
+                return table[slot];
+        }
+        return 0;
+    }
+
+    ///Move chain from the old bucket array to the current one
+    void rehash_bucket(uints h)
+    {
+        Node* n = _otable[h];
+        _otable[h] = 0;
+
+        while (n)
+        {
+            Node* t = n->_next;
+            Node** pn = find_socket_ext(_table, _shift, _GETKEYFUNC(n->_val));
+
+            n->_next = *pn;
+            *pn = n;
+
+            n = t;
+        }
+    }
+
+    ///Migrate the old bucket of given key and a budgeted number of others
+    void rehash_key(uint64 hash)
+    {
+        uints h = bucket_from_hash(hash, _oshift);
+        if (_otable[h])
+            rehash_bucket(h);
+
+        rehash_step(_rehash_budget);
     }
 
 protected:
@@ -996,9 +1120,14 @@ protected:
         return true;
     }
 
-    bool __erase_value_slot(const VAL* val, uints socket = UMAXS)
+    bool __erase_value_slot(const VAL* val)
+    {
+        return __erase_value_slot(val, _HASHFUNC(_GETKEYFUNC(*val)));
+    }
+
+    bool __erase_value_slot(const VAL* val, uint64 hash)
     {
-        Node** pn = find_socket_val(val, socket);
+        Node** pn = find_socket_val(val, hash);
         if (!pn)
             return false;
 
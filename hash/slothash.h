@@ -121,8 +121,7 @@ public:
     template<class FKEY = KEY>
     const T* find_value(const FKEY& key, uint* slot = 0) const
     {
-        uint b = bucket(key);
-        uint id = find_object(b, key);
+        uint id = find_object(chain(key_hash(key)), key);
 
         if (slot)
             *slot = id;
@@ -183,20 +182,19 @@ public:
             return p;
 
         const KEY& oldkey = _EXTRACTOR(*p);
-        uint bo = bucket(oldkey);
 
         //remove id from the bucket list
-        uint* n = find_object_entry(bo, oldkey);
+        uint* n = find_object_entry(chain_entry(key_hash(oldkey)), oldkey);
         DASSERT(*n == id);
 
         *n = seqtable()[id];
 
         //insert new key
 
-        uint bn = bucket(newkey);
+        uint* bn = chain_entry(key_hash(newkey));
 
-        seqtable()[id] = _buckets[bn];
-        _buckets[bn] = id;
+        seqtable()[id] = *bn;
+        *bn = id;
 
         return p;
     }
@@ -295,10 +293,9 @@ public:
     template<class FKEY = KEY>
     uints erase(const FKEY& key)
     {
-        uint b = bucket(key);
         uint c = 0;
 
-        uint* n = find_object_entry(b, key);
+        uint* n = find_object_entry(chain_entry(key_hash(key)), key);
         while (*n != UMAX32) {
             if (!(_EXTRACTOR(*base::get_mutable_item(*n)) == key))
                 break;
@@ -318,6 +315,43 @@ public:
     {
         base::reset();
         memset(_buckets.ptr(), 0xff, _buckets.byte_size());
+
+        _obuckets.discard();
+        _omig = 0;
+    }
+
+    ///Set incremental rehash mode, where growing keeps the old bucket table and migrates it gradually
+    //@param budget number of old buckets migrated by each insert or erase, 0 to rehash at once
+    //@note lookups don't migrate, so that concurrent readers stay safe
+    void set_incremental_rehash(uint budget)
+    {
+        _rehash_budget = budget;
+        if (!budget)
+            rehash_step(UMAX32);
+    }
+
+    ///Migrate given number of buckets from the old bucket table
+    //@return true if there are still buckets left to migrate
+    bool rehash_step(uint budget)
+    {
+        uint n = _obuckets.size();
+        if (!n)
+            return false;
+
+        for (; budget > 0 && _omig < n; --budget, ++_omig)
+            rehash_bucket(_omig);
+
+        if (_omig < n)
+            return true;
+
+        _obuckets.discard();
+        _omig = 0;
+        return false;
+    }
+
+    //@return true if an incremental rehash is pending
+    bool rehash_pending() const {
+        return _obuckets.size() > 0;
     }
 
     void reserve(uint nitems) {
@@ -336,7 +370,11 @@ public:
     void swap(slothash& other) {
         base::swap(other);
         std::swap(_shift, other._shift);
+        std::swap(_oshift, other._oshift);
+        std::swap(_omig, other._omig);
+        std::swap(_rehash_budget, other._rehash_budget);
         _buckets.swap(other._buckets);
+        _obuckets.swap(other._obuckets);
     }
 
     friend void swap(slothash& a, slothash& b) {
@@ -352,20 +390,40 @@ protected:
     }
 
     template<class FKEY = KEY>
-    uint bucket(const FKEY& k) const {
-        return bucket_from_hash(_HASHFUNC(k), _shift);
+    uint64 key_hash(const FKEY& k) const {
+        return _HASHFUNC(k);
+    }
+
+    uint64 key_hash(const tokenhash& key) const {
+        return key.hash();
     }
 
-    template<>
-    uint bucket<tokenhash>(const tokenhash& key) const {
-        return bucket_from_hash(key.hash(), _shift);
+    ///Head of the bucket chain for given hash, for lookups
+    //@note during incremental rehash the keys stay in the old bucket until it's migrated
+    uint chain(uint64 hash) const
+    {
+        if (_obuckets.size()) {
+            uint id = _obuckets[bucket_from_hash(hash, _oshift)];
+            if (id != UMAX32)
+                return id;
+        }
+        return _buckets[bucket_from_hash(hash, _shift)];
+    }
+
+    ///Bucket entry for given hash, for modification
+    //@note pending old bucket with the key is migrated first, so that the entry is in the current table
+    uint* chain_entry(uint64 hash)
+    {
+        if (_obuckets.size())
+            rehash_key(hash);
+        return &_buckets[bucket_from_hash(hash, _shift)];
     }
 
     ///Find first node that matches the key
+    //@param n id of the first object in bucket chain
     template<class FKEY = KEY>
-    uint find_object(uint bucket, const FKEY& k) const
+    uint find_object(uint n, const FKEY& k) const
     {
-        uint n = _buckets[bucket];
         while (n != UMAX32)
         {
             if (_EXTRACTOR(*base::get_item(n)) == k)
@@ -376,12 +434,12 @@ protected:
         return n;
     }
 
+    //@param n bucket entry with the first object id in chain
     //@return ref to bucket or seqtable slot where the key would be found or written
     //@note if return value points to UINT32, the key was not found
     template<class FKEY = KEY>
-    uint* find_object_entry(uint bucket, const FKEY& k)
+    uint* find_object_entry(uint* n, const FKEY& k)
     {
-        uint* n = &_buckets[bucket];
         uint id = *n;
 
         if (id == UMAX32)
@@ -413,17 +471,15 @@ protected:
     template<class FKEY = KEY>
     bool find_or_insert_value_slot_uninit_(const FKEY& key, uint* pid)
     {
-        uint64 hash = _HASHFUNC(key);
-        uint b = bucket_from_hash(hash, _shift);
+        uint64 hash = key_hash(key);
 
-        uint* fid = find_object_entry(b, key);
+        uint* fid = find_object_entry(chain_entry(hash), key);
 
         bool isnew = *fid == UMAX32;
         if (isnew) {
             if (_buckets.size() <= base::count()) {
                 resize(_buckets.size() + 1, UMAX32);
-                b = bucket_from_hash(hash, _shift);
-                fid = find_object_entry(b, key);
+                fid = find_object_entry(chain_entry(hash), key);
             }
 
             uints ids;
@@ -446,8 +502,7 @@ protected:
         if (_buckets.size() <= base::count())
             resize(_buckets.size() + 1, skip_id);
 
-        uint b = bucket(key);
-        uint* fid = find_object_entry(b, key);
+        uint* fid = find_object_entry(chain_entry(key_hash(key)), key);
 
         bool isnew = *fid == UMAX32;
         return isnew || MULTIKEY ? fid : 0;
@@ -493,10 +548,9 @@ protected:
     {
         T* p = base::get_mutable_item(id);
         const KEY& key = _EXTRACTOR(*p);
-        uint b = bucket(key);
 
         //remove id from the bucket list
-        uint* n = find_object_entry(b, key);
+        uint* n = find_object_entry(chain_entry(key_hash(key)), key);
         DASSERT(*n == id);
 
         *n = seqtable()[id];
@@ -506,19 +560,37 @@ protected:
 
     //@return true if the underlying array was resized
     //@param skip_id id of newly created object that should be skipped in case of resize, or UMAX32
+    //@note in incremental rehash mode the old bucket table is kept and migrated gradually
     bool resize(uint bucketn, uint skip_id)
     {
         uint shift = 64 - int_high_pow2(bucketn);
 
         if (shift < _shift)
         {
-            //reindex objects
-            //clear both buckets index and sequaray
             uint nb = 1U << (64 - shift);
-            _buckets.calloc(nb, true);
+
+            //previous migration should have been finished long ago, unless growing by reserve
+            rehash_step(UMAX32);
 
             dynarray<uint>& st = seqtable();
             uints na = stdmax(base::preallocated_count(), nb);    //make sure seqtable won't get rebased
+
+            if (_rehash_budget && base::count() > 0) {
+                //chains in seqtable stay, only the bucket index is replaced
+                _obuckets.swap(_buckets);
+                _oshift = _shift;
+                _omig = 0;
+
+                _buckets.calloc(nb, true);
+                st.reserve(na, true);
+
+                _shift = shift;
+                return true;
+            }
+
+            //reindex objects
+            //clear both buckets index and sequaray
+            _buckets.calloc(nb, true);
             st.calloc(na, true);
 
             _shift = shift;
@@ -526,9 +598,8 @@ protected:
             base::for_each([&](const T& val, uints id) {
                 if (id != skip_id) {
                     const KEY& key = _EXTRACTOR(val);
-                    uint b = bucket(key);
 
-                    uint* n = find_object_entry(b, key);
+                    uint* n = find_object_entry(&_buckets[bucket_from_hash(key_hash(key), _shift)], key);
 
                     st[id] = *n;
                     *n = uint(id);
@@ -541,13 +612,48 @@ protected:
         return false;
     }
 
+    ///Move chain from the old bucket table to the current one
+    void rehash_bucket(uint b)
+    {
+        uint id = _obuckets[b];
+        _obuckets[b] = UMAX32;
+
+        dynarray<uint>& st = seqtable();
+
+        while (id != UMAX32) {
+            uint next = st[id];
+            const KEY& key = _EXTRACTOR(*base::get_item(id));
+
+            uint* n = find_object_entry(&_buckets[bucket_from_hash(key_hash(key), _shift)], key);
+
+            st[id] = *n;
+            *n = id;
+
+            id = next;
+        }
+    }
+
+    ///Migrate the old bucket of given key and a budgeted number of others
+    void rehash_key(uint64 hash)
+    {
+        uint b = bucket_from_hash(hash, _oshift);
+        if (_obuckets[b] != UMAX32)
+            rehash_bucket(b);
+
+        rehash_step(_rehash_budget);
+    }
+
 private:
 
     EXTRACTOR _EXTRACTOR;
     HASHFUNC _HASHFUNC;
 
     coid::dynarray32<uint> _buckets;    //< table with ids of first objects belonging to the given hash socket
+    coid::dynarray32<uint> _obuckets;   //< previous bucket table while an incremental rehash is pending
     uint _shift = 64;
+    uint _oshift = 64;
+    uint _omig = 0;                     //< next bucket of _obuckets to migrate
+    uint _rehash_budget = 0;            //< buckets migrated per insert or erase, 0 to rehash at once
 };
 
 
@@ -0,0 +1,928 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is COID/comm module.
+ *
+ * The Initial Developer of the Original Code is
+ * Outerra.
+ * Portions created by the Initial Developer are Copyright (C) 2017
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ * Brano Kemen
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * either the GNU General Public License Version 2 or later (the "GPL"), or
+ * the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+ * in which case the provisions of the GPL or the LGPL are applicable instead
+ * of those above. If you wish to allow use of your version of this file only
+ * under the terms of either the GPL or the LGPL, and not to allow others to
+ * use your version of this file under the terms of the MPL, indicate your
+ * decision by deleting the provisions above and replace them with the notice
+ * and other provisions required by the GPL or the LGPL. If you do not delete
+ * the provisions above, a recipient may use your version of this file under
+ * the terms of any one of the MPL, the GPL or the LGPL.
+ *
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef __COID_COMM_SWISSTABLE__HEADER_FILE__
+#define __COID_COMM_SWISSTABLE__HEADER_FILE__
+
+#include "../namespace.h"
+#include "hashtable.h"
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COID_SWISS_SSE2
+#include <emmintrin.h>
+#endif
+
+COID_NAMESPACE_BEGIN
+
+namespace swiss {
+
+///Control byte values, full slots store 7 bits of the hash (0..127)
+enum : int8 {
+    EMPTY = -128,
+    DELETED = -2,
+};
+
+static const uint GROUP = 16;
+
+///A group of 16 control bytes probed at once
+struct group
+{
+#ifdef COID_SWISS_SSE2
+    __m128i _c;
+
+    explicit group(const int8* p) : _c(_mm_loadu_si128((const __m128i*)p))
+    {}
+
+    ///@return bit mask of slots with given tag
+    uint match(int8 tag) const {
+        return uint(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), _c)));
+    }
+
+    ///@return bit mask of empty or deleted slots
+    uint match_free() const {
+        return uint(_mm_movemask_epi8(_c));
+    }
+#else
+    const int8* _c;
+
+    explicit group(const int8* p) : _c(p)
+    {}
+
+    uint match(int8 tag) const {
+        uint m = 0;
+        for (uint i = 0; i < GROUP; ++i)
+            m |= uint(_c[i] == tag) << i;
+        return m;
+    }
+
+    uint match_free() const {
+        uint m = 0;
+        for (uint i = 0; i < GROUP; ++i)
+            m |= uint(_c[i] < 0) << i;
+        return m;
+    }
+#endif
+
+    uint match_empty() const { return match(EMPTY); }
+};
+
+} //namespace swiss
+
+
+////////////////////////////////////////////////////////////////////////////////
+///Open addressing hash table with 1-byte control metadata per slot, probed in groups of 16
+//@note values are stored inline, pointers and iterators are invalidated by insertions that grow the table
+//@param VAL value type stored in hash table
+//@param HASHFUNC hash function, HASHFUNC::key_type should be the type used for lookup
+//@param EQFUNC equality functor
+//@param GETKEYFUNC key extractor from VAL
+template <class VAL, class HASHFUNC, class EQFUNC, class GETKEYFUNC>
+class swisstable
+{
+public:
+
+    typedef typename HASHFUNC::key_type         LOOKUP;
+
+private:
+
+    typedef swisstable<VAL, HASHFUNC, EQFUNC, GETKEYFUNC>  _Self;
+
+    int8* _ctrl = 0;                    //< control bytes, capacity entries
+    VAL* _slots = 0;
+    uints _mask = 0;                    //< capacity - 1, capacity is a power of 2 and a multiple of group size
+    uints _nelem = 0;
+    uints _growth = 0;                  //< number of empty slots that can be taken before a rehash
+
+protected:
+
+    HASHFUNC    _HASHFUNC;
+    EQFUNC      _EQFUNC;
+    GETKEYFUNC  _GETKEYFUNC;
+
+    static uint64 mix(uint64 hash) {
+        //fibonacci hashing, folded so that both halves depend on all input bits
+        hash *= 11400714819323198485llu;
+        return hash ^ (hash >> 32);
+    }
+
+    static int8 tag(uint64 h) { return int8(h & 0x7f); }
+
+    static uints max_load(uints capacity) { return capacity - capacity / 8; }
+
+    uints probe_start(uint64 h) const {
+        return uints(h >> 7) & _mask & ~uints(swiss::GROUP - 1);
+    }
+
+    bool is_full(uints i) const { return _ctrl[i] >= 0; }
+
+public:
+
+    const HASHFUNC& hash_func() const { return _HASHFUNC; }
+    HASHFUNC& hash_func() { return _HASHFUNC; }
+
+    const EQFUNC& equal_func() const { return _EQFUNC; }
+    EQFUNC& equal_func() { return _EQFUNC; }
+
+
+    class Ptr
+    {
+        uints _i;
+        const _Self* _ht;
+
+    public:
+
+        typedef LOOKUP                  key_type;
+        typedef VAL                     value_type;
+        typedef HASHFUNC                hasher;
+        typedef EQFUNC                  key_equal;
+
+        typedef size_t                  size_type;
+        typedef ptrdiff_t               difference_type;
+        typedef VAL* pointer;
+        typedef const VAL* const_pointer;
+        typedef VAL& reference;
+        typedef const VAL& const_reference;
+
+        typedef std::forward_iterator_tag iterator_category;
+
+        uints _get_index() const { return _i; }
+        const _Self* _get_ht() const { return _ht; }
+
+        Ptr(uints i, const _Self& ht) : _i(i), _ht(&ht) {}
+        Ptr() : _i(0), _ht(0) {}
+
+        bool operator == (const Ptr& p) const { return _i == p._i; }
+        bool operator != (const Ptr& p) const { return _i != p._i; }
+
+        reference operator*() { return _ht->_slots[_i]; }
+        pointer operator ->() { return _ht->_slots + _i; }
+
+        Ptr& operator++()
+        {
+            _i = _ht->next_full(_i + 1);
+            return *this;
+        }
+
+        inline Ptr operator++(int)
+        {
+            Ptr tmp = *this;
+            ++* this;
+            return tmp;
+        }
+    };
+
+    class CPtr
+    {
+        uints _i;
+        const _Self* _ht;
+
+    public:
+
+        typedef LOOKUP                  key_type;
+        typedef VAL                     value_type;
+        typedef HASHFUNC                hasher;
+        typedef EQFUNC                  key_equal;
+
+        typedef size_t                  size_type;
+        typedef ptrdiff_t               difference_type;
+        typedef VAL* pointer;
+        typedef const VAL* const_pointer;
+        typedef VAL& reference;
+        typedef const VAL& const_reference;
+
+        typedef std::forward_iterator_tag iterator_category;
+
+        CPtr(uints i, const _Self& ht) : _i(i), _ht(&ht) {}
+        CPtr() : _i(0), _ht(0) {}
+
+        CPtr(const Ptr& p) : _i(p._get_index()), _ht(p._get_ht()) {}
+
+        CPtr& operator = (const Ptr& p)
+        {
+            _i = p._get_index();
+            _ht = p._get_ht();
+            return *this;
+        }
+
+        bool operator == (const CPtr& p) const { return _i == p._i; }
+        bool operator != (const CPtr& p) const { return _i != p._i; }
+
+        const_reference operator*() const { return _ht->_slots[_i]; }
+        const_pointer operator ->() const { return _ht->_slots + _i; }
+
+        CPtr& operator++()
+        {
+            _i = _ht->next_full(_i + 1);
+            return *this;
+        }
+
+        inline CPtr operator++(int)
+        {
+            CPtr tmp = *this;
+            ++* this;
+            return tmp;
+        }
+    };
+
+    typedef Ptr                         iterator;
+    typedef CPtr                        const_iterator;
+
+
+    size_t size() const { return _nelem; }
+    size_t max_size() const { return size_t(-1); }
+    bool empty() const { return _nelem == 0; }
+
+    ///@return number of slots
+    size_t bucket_count() const { return _ctrl ? _mask + 1 : 0; }
+
+    iterator begin() { return iterator(next_full(0), *this); }
+    iterator end() { return iterator(bucket_count(), *this); }
+
+    const_iterator begin() const { return const_iterator(next_full(0), *this); }
+    const_iterator end() const { return const_iterator(bucket_count(), *this); }
+
+    iterator find(const LOOKUP& k)
+    {
+        uints i = find_slot(_HASHFUNC(k), k);
+        return iterator(i != UMAXS ? i : bucket_count(), *this);
+    }
+
+    const_iterator find(const LOOKUP& k) const
+    {
+        uints i = find_slot(_HASHFUNC(k), k);
+        return const_iterator(i != UMAXS ? i : bucket_count(), *this);
+    }
+
+    size_t count(const LOOKUP& k) const {
+        return find_slot(_HASHFUNC(k), k) != UMAXS ? 1 : 0;
+    }
+
+    bool erase_value(const VAL& v) {
+        return __erase_value(_GETKEYFUNC(v), 0);
+    }
+
+    bool erase_value(const LOOKUP& k, VAL* dst) {
+        return __erase_value(k, dst);
+    }
+
+    ///Erase value by pointer obtained from this table
+    bool erase_value_slot(const VAL* v)
+    {
+        if (v < _slots || v >= _slots + bucket_count())
+            return false;
+        erase_slot(v - _slots);
+        return true;
+    }
+
+    size_t erase(const LOOKUP& k) {
+        return __erase_value(k, 0) ? 1 : 0;
+    }
+
+    void erase(iterator& it)
+    {
+        uints i = it._get_index();
+        ++it;
+        erase_slot(i);
+    }
+
+    void erase(iterator f, iterator l)
+    {
+        while (f != l)
+            erase(f);
+    }
+
+    ///Resize the table to accommodate given number of elements without rehashing
+    void reserve(size_t n)
+    {
+        uints cap = swiss::GROUP;
+        while (max_load(cap) < n)
+            cap <<= 1;
+
+        if (cap > bucket_count())
+            rehash(cap);
+    }
+
+    bool resize(size_t n) {
+        reserve(n);
+        return true;
+    }
+
+    void clear()
+    {
+        if (!_ctrl)
+            return;
+
+        if (!std::is_trivially_destructible<VAL>::value) {
+            for (uints i = next_full(0), n = bucket_count(); i < n; i = next_full(i + 1))
+                _slots[i].~VAL();
+        }
+
+        ::memset(_ctrl, swiss::EMPTY, _mask + 1);
+        _nelem = 0;
+        _growth = max_load(_mask + 1);
+    }
+
+    std::pair<iterator, bool> insert_unique(const VAL& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        if (isnew)
+            new(_slots + i) VAL(v);
+        return std::pair<iterator, bool>(iterator(i, *this), isnew);
+    }
+
+    std::pair<iterator, bool> insert_unique(VAL&& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        if (isnew)
+            new(_slots + i) VAL(std::forward<VAL>(v));
+        return std::pair<iterator, bool>(iterator(i, *this), isnew);
+    }
+
+    void insert_unique(const VAL* f, const VAL* l)
+    {
+        reserve(_nelem + (l - f));
+        for (; f != l; ++f)
+            insert_unique(*f);
+    }
+
+    void insert_unique(const_iterator f, const_iterator l)
+    {
+        for (; f != l; ++f)
+            insert_unique(*f);
+    }
+
+    friend void swap(_Self& a, _Self& b)
+    {
+        std::swap(a._ctrl, b._ctrl);
+        std::swap(a._slots, b._slots);
+        std::swap(a._mask, b._mask);
+        std::swap(a._nelem, b._nelem);
+        std::swap(a._growth, b._growth);
+        std::swap(a._HASHFUNC, b._HASHFUNC);
+        std::swap(a._EQFUNC, b._EQFUNC);
+        std::swap(a._GETKEYFUNC, b._GETKEYFUNC);
+    }
+
+    _Self& operator = (const _Self& ht)
+    {
+        if (this != &ht) {
+            _Self tmp(ht);
+            swap(*this, tmp);
+        }
+        return *this;
+    }
+
+    _Self& operator = (_Self&& ht)
+    {
+        swap(*this, ht);
+        return *this;
+    }
+
+
+    swisstable(uints n, const HASHFUNC& hf, const EQFUNC& eqf, const GETKEYFUNC& gkf)
+        : _HASHFUNC(hf)
+        , _EQFUNC(eqf)
+        , _GETKEYFUNC(gkf)
+    {
+        if (n)
+            reserve(n);
+    }
+
+    swisstable(const swisstable& ht)
+        : _HASHFUNC(ht._HASHFUNC)
+        , _EQFUNC(ht._EQFUNC)
+        , _GETKEYFUNC(ht._GETKEYFUNC)
+    {
+        reserve(ht._nelem);
+        insert_unique(ht.begin(), ht.end());
+    }
+
+    swisstable(swisstable&& ht)
+        : _HASHFUNC(ht._HASHFUNC)
+        , _EQFUNC(ht._EQFUNC)
+        , _GETKEYFUNC(ht._GETKEYFUNC)
+    {
+        std::swap(_ctrl, ht._ctrl);
+        std::swap(_slots, ht._slots);
+        std::swap(_mask, ht._mask);
+        std::swap(_nelem, ht._nelem);
+        std::swap(_growth, ht._growth);
+    }
+
+    ~swisstable()
+    {
+        clear();
+        if (_ctrl)
+            ::dlfree(_ctrl);
+    }
+
+protected:
+
+    ///@return index of the next full slot starting from given one, or capacity
+    uints next_full(uints i) const
+    {
+        uints n = bucket_count();
+        for (; i < n; ++i)
+            if (is_full(i))
+                break;
+        return i;
+    }
+
+    ///Find slot holding the key
+    //@return slot index or UMAXS if not found
+    uints find_slot(uint64 hash, const LOOKUP& k) const
+    {
+        if (!_ctrl)
+            return UMAXS;
+
+        uint64 h = mix(hash);
+        int8 t = tag(h);
+        uints pos = probe_start(h);
+
+        //triangular probing visits every group once when the group count is a power of 2
+        for (uints step = swiss::GROUP; ; step += swiss::GROUP)
+        {
+            swiss::group g(_ctrl + pos);
+
+            for (uint m = g.match(t); m; m &= m - 1) {
+                uints i = pos + lsb_bit_set(m);
+                if (_EQFUNC(_GETKEYFUNC(_slots[i]), k))
+                    return i;
+            }
+
+            if (g.match_empty())
+                return UMAXS;
+
+            pos = (pos + step) & _mask;
+        }
+    }
+
+    ///Find the first empty or deleted slot in the probe sequence
+    uints find_free(uint64 h) const
+    {
+        uints pos = probe_start(h);
+
+        for (uints step = swiss::GROUP; ; step += swiss::GROUP)
+        {
+            uint m = swiss::group(_ctrl + pos).match_free();
+            if (m)
+                return pos + lsb_bit_set(m);
+
+            pos = (pos + step) & _mask;
+        }
+    }
+
+    ///Find existing slot for the key or claim a free one, growing the table if needed
+    //@return slot index, uninitialized if isnew was set
+    uints find_or_prepare_insert(const LOOKUP& k, bool* isnew)
+    {
+        uint64 hash = _HASHFUNC(k);
+        uints i = find_slot(hash, k);
+        if (i != UMAXS) {
+            *isnew = false;
+            return i;
+        }
+
+        *isnew = true;
+        uint64 h = mix(hash);
+
+        i = _ctrl ? find_free(h) : UMAXS;
+        if (i == UMAXS || (_growth == 0 && _ctrl[i] == swiss::EMPTY)) {
+            //double the size unless most of the load comes from deleted slots
+            uints cap = bucket_count();
+            rehash(cap == 0 ? swiss::GROUP : (_nelem >= max_load(cap) / 2 ? 2 * cap : cap));
+            i = find_free(h);
+        }
+
+        if (_ctrl[i] == swiss::EMPTY)
+            --_growth;
+        _ctrl[i] = tag(h);
+        ++_nelem;
+        return i;
+    }
+
+    void erase_slot(uints i)
+    {
+        DASSERT_RET(is_full(i));
+        _slots[i].~VAL();
+        --_nelem;
+
+        //lookups cannot have probed past a group that still has an empty slot
+        if (swiss::group(_ctrl + (i & ~uints(swiss::GROUP - 1))).match_empty()) {
+            _ctrl[i] = swiss::EMPTY;
+            ++_growth;
+        }
+        else
+            _ctrl[i] = swiss::DELETED;
+    }
+
+    ///Rebuild the table with given capacity, dropping the deleted slots
+    void rehash(uints cap)
+    {
+        DASSERT(cap >= swiss::GROUP && (cap & (cap - 1)) == 0);
+
+        int8* octrl = _ctrl;
+        VAL* oslots = _slots;
+        uints ocap = bucket_count();
+
+        _ctrl = (int8*)::dlmalloc(cap + cap * sizeof(VAL));
+        _slots = (VAL*)(_ctrl + cap);
+        _mask = cap - 1;
+        _growth = max_load(cap) - _nelem;
+
+        ::memset(_ctrl, swiss::EMPTY, cap);
+
+        for (uints i = 0; i < ocap; ++i) {
+            if (octrl[i] < 0)
+                continue;
+
+            uint64 h = mix(_HASHFUNC(_GETKEYFUNC(oslots[i])));
+            uints k = find_free(h);
+            _ctrl[k] = tag(h);
+
+            new(_slots + k) VAL(std::move(oslots[i]));
+            oslots[i].~VAL();
+        }
+
+        if (octrl)
+            ::dlfree(octrl);
+    }
+
+    bool __erase_value(const LOOKUP& k, VAL* dst)
+    {
+        uints i = find_slot(_HASHFUNC(k), k);
+        if (i == UMAXS)
+            return false;
+
+        if (dst)
+            *dst = std::move(_slots[i]);
+        erase_slot(i);
+        return true;
+    }
+
+    VAL* __insert_unique(VAL&& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        return isnew ? new(_slots + i) VAL(std::forward<VAL>(v)) : 0;
+    }
+
+    VAL* __insert_unique(const VAL& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        return isnew ? new(_slots + i) VAL(v) : 0;
+    }
+
+    VAL* __insert_unique__replace(VAL&& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        if (isnew)
+            return new(_slots + i) VAL(std::forward<VAL>(v));
+
+        _slots[i] = std::forward<VAL>(v);
+        return _slots + i;
+    }
+
+    VAL* __insert_unique__replace(const VAL& v)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(_GETKEYFUNC(v), &isnew);
+        if (isnew)
+            return new(_slots + i) VAL(v);
+
+        _slots[i] = v;
+        return _slots + i;
+    }
+
+    VAL* _insert_unique_slot(const LOOKUP& k)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(k, &isnew);
+        return isnew ? new(_slots + i) VAL : 0;
+    }
+
+    VAL* _insert_unique_slot_uninit(const LOOKUP& k)
+    {
+        bool isnew;
+        uints i = find_or_prepare_insert(k, &isnew);
+        return isnew ? _slots + i : 0;
+    }
+
+    VAL* _find_or_insert_slot(const LOOKUP& k, bool* isnew)
+    {
+        bool isnew_;
+        uints i = find_or_prepare_insert(k, &isnew_);
+        if (isnew_)
+            new(_slots + i) VAL;
+        if (isnew)
+            *isnew = isnew_;
+        return _slots + i;
+    }
+
+    VAL* _find_or_insert_slot_uninit(const LOOKUP& k, bool* isnew)
+    {
+        bool isnew_;
+        uints i = find_or_prepare_insert(k, &isnew_);
+        if (isnew)
+            *isnew = isnew_;
+        return _slots + i;
+    }
+
+    VAL* find_value_(uint64 hash, const LOOKUP& k) const
+    {
+        uints i = find_slot(hash, k);
+        return i != UMAXS ? _slots + i : 0;
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+@class swiss_map
+Open addressing counterpart of hash_map, can be swapped for it by a typedef
+@param KEY key type (stored in pair with the value)
+@param VAL value type
+@param HASHFUNC hash function, HASHFUNC::key_type should be the type used for lookup
+@param EQFUNC equality functor
+@param ALLOC unused, values are stored inline in the table
+**/
+template <
+    class KEY,
+    class VAL,
+    class HASHFUNC = hasher<KEY>,
+    class EQFUNC = equal_to<KEY, typename HASHFUNC::key_type>,
+    template<class> class ALLOC = AllocStd
+>
+class swiss_map
+    : public swisstable<
+    std::pair<KEY, VAL>,
+    HASHFUNC,
+    EQFUNC,
+    _Select_pair1st<std::pair<KEY, VAL>, KEY>
+    >
+{
+    typedef _Select_pair1st<std::pair<KEY, VAL>, KEY>                     _SEL;
+    typedef swisstable<std::pair<KEY, VAL>, HASHFUNC, EQFUNC, _SEL>     _HT;
+
+public:
+
+    typedef typename _HT::LOOKUP                    key_type;
+    typedef std::pair<KEY, VAL>                      value_type;
+    typedef HASHFUNC                                hasherfn;
+    typedef EQFUNC                                  key_equal;
+
+    typedef size_t                                  size_type;
+    typedef ptrdiff_t                               difference_type;
+    typedef value_type* pointer;
+    typedef const value_type* const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    typedef typename _HT::iterator                  iterator;
+    typedef typename _HT::const_iterator            const_iterator;
+
+
+    std::pair<iterator, bool> insert(const value_type& val) {
+        return this->insert_unique(val);
+    }
+
+    void insert(const value_type* f, const value_type* l) {
+        this->insert_unique(f, l);
+    }
+
+    void insert(const_iterator f, const_iterator l) {
+        this->insert_unique(f, l);
+    }
+
+    const VAL* insert_value(const value_type& val)
+    {
+        value_type* v = this->__insert_unique(val);
+        return v ? &v->second : 0;
+    }
+
+    const VAL* insert_value(value_type&& val)
+    {
+        value_type* v = this->__insert_unique(std::forward<value_type>(val));
+        return v ? &v->second : 0;
+    }
+
+    const VAL* insert_key_value(const key_type& k, const VAL& v)
+    {
+        value_type* n = this->__insert_unique(value_type(k, v));
+        return n ? &n->second : 0;
+    }
+
+    const VAL* insert_key_value(const key_type& k, VAL&& v)
+    {
+        value_type* n = this->__insert_unique(value_type(k, std::forward<VAL>(v)));
+        return n ? &n->second : 0;
+    }
+
+
+    VAL* find_value(const key_type& k) const
+    {
+        value_type* v = this->find_value_(this->_HASHFUNC(k), k);
+        return v ? &v->second : 0;
+    }
+
+    VAL* find_value(uint hash, const key_type& k) const
+    {
+        value_type* v = this->find_value_(hash, k);
+        return v ? &v->second : 0;
+    }
+
+    swiss_map()
+        : _HT(0, hasherfn(), key_equal(), _SEL()) {}
+
+    explicit swiss_map(size_type n)
+        : _HT(n, hasherfn(), key_equal(), _SEL()) {}
+    swiss_map(size_type n, const hasherfn& hf)
+        : _HT(n, hf, key_equal(), _SEL()) {}
+    swiss_map(size_type n, const hasherfn& hf, const key_equal& eql)
+        : _HT(n, hf, eql, _SEL()) {}
+
+    swiss_map(const value_type* f, const value_type* l, size_type n = 0)
+        : _HT(n, hasherfn(), key_equal(), _SEL())
+    {
+        this->insert_unique(f, l);
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/**
+@class swiss_keyset
+Open addressing counterpart of hash_keyset, can be swapped for it by a typedef
+@param VAL value type stored in hash table
+@param EXTRACTKEY key extractor from value type, EXTRACTKEY::ret_type is the type extracted
+@param HASHFUNC hash function, HASHFUNC::key_type should be the type used for lookup
+@param EQFUNC equality functor, comparing EXTRACTKEY::ret_type extracted from value with HASHFUNC::key_type lookup key
+@param ALLOC unused, values are stored inline in the table
+**/
+template <
+    class VAL,
+    class EXTRACTKEY,
+    class HASHFUNC = hasher<typename type_base<typename EXTRACTKEY::ret_type>::type>,
+    class EQFUNC = equal_to<typename type_base<typename EXTRACTKEY::ret_type>::type, typename HASHFUNC::key_type>,
+    template<class> class ALLOC = AllocStd
+>
+class swiss_keyset
+    : public swisstable<VAL, HASHFUNC, EQFUNC, EXTRACTKEY>
+{
+    typedef swisstable<VAL, HASHFUNC, EQFUNC, EXTRACTKEY> _HT;
+
+public:
+
+    typedef typename _HT::LOOKUP                    key_type;
+    typedef VAL                                     value_type;
+    typedef EXTRACTKEY                              extractor;
+    typedef HASHFUNC                                hasherfn;
+    typedef EQFUNC                                  key_equal;
+
+    typedef size_t                                  size_type;
+    typedef ptrdiff_t                               difference_type;
+    typedef value_type* pointer;
+    typedef const value_type* const_pointer;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+
+    typedef typename _HT::iterator                  iterator;
+    typedef typename _HT::const_iterator            const_iterator;
+
+    std::pair<iterator, bool> insert(const value_type& val)
+    {
+        return this->insert_unique(val);
+    }
+
+    void insert(const value_type* f, const value_type* l)
+    {
+        this->insert_unique(f, l);
+    }
+
+    void insert(const_iterator f, const_iterator l)
+    {
+        this->insert_unique(f, l);
+    }
+
+    ///Insert value if it's got an unique key
+    //@return NULL if the value could not be inserted, or a constant pointer to the value
+    const VAL* insert_value(value_type&& val) {
+        return this->__insert_unique(std::forward<value_type>(val));
+    }
+
+    ///Insert value if it's got an unique key
+    //@return NULL if the value could not be inserted, or a constant pointer to the value
+    const VAL* insert_value(const value_type& val) {
+        return this->__insert_unique(val);
+    }
+
+    ///Insert new value or override the existing one under the same key.
+    //@return constant pointer to the value
+    const VAL* insert_or_replace_value(value_type&& val) {
+        return this->__insert_unique__replace(std::forward<value_type>(val));
+    }
+
+    ///Insert new value or override the existing one under the same key.
+    //@return constant pointer to the value
+    const VAL* insert_or_replace_value(const value_type& val) {
+        return this->__insert_unique__replace(val);
+    }
+
+    ///Create a default-constructed entry for value object that will be initialized by the caller afterwards
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    VAL* insert_value_slot(const key_type& key) {
+        return _HT::_insert_unique_slot(key);
+    }
+
+    ///Create an uninitialized entry for value object that will be initialized by the caller afterwards
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    VAL* insert_value_slot_uninit(const key_type& key) {
+        return _HT::_insert_unique_slot_uninit(key);
+    }
+
+    ///Find or create an empty entry for value object that will be initialized by the caller afterwards
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    VAL* find_or_insert_value_slot(const key_type& key, bool* isnew = 0) {
+        return _HT::_find_or_insert_slot(key, isnew);
+    }
+
+    ///Find or create an uninitialized entry for value object that will be initialized by the caller afterwards
+    //@note the value object should be initialized so that it would return the same key as the one passed in here
+    VAL* find_or_insert_value_slot_uninit(const key_type& key, bool* isnew = 0) {
+        return _HT::_find_or_insert_slot_uninit(key, isnew);
+    }
+
+
+    ///Find value object corresponding to given key
+    const VAL* find_value(const key_type& k) const {
+        return this->find_value_(this->_HASHFUNC(k), k);
+    }
+
+    ///Find value object corresponding to given key
+    const VAL* find_value(uint hash, const key_type& k) const {
+        return this->find_value_(hash, k);
+    }
+
+
+    swiss_keyset()
+        : _HT(0, hasherfn(), key_equal(), extractor()) {}
+
+    explicit swiss_keyset(size_type n)
+        : _HT(n, hasherfn(), key_equal(), extractor()) {}
+
+    explicit swiss_keyset(const extractor& ex, size_type n = 0)
+        : _HT(n, hasherfn(), key_equal(), ex) {}
+    swiss_keyset(const extractor& ex, const hasherfn& hf, size_type n = 0)
+        : _HT(n, hf, key_equal(), ex) {}
+    swiss_keyset(const extractor& ex, const hasherfn& hf, const key_equal& eql, size_type n = 0)
+        : _HT(n, hf, eql, ex) {}
+
+    swiss_keyset(const value_type* f, const value_type* l, size_type n = 0)
+        : _HT(n, hasherfn(), key_equal(), extractor())
+    {
+        this->insert_unique(f, l);
+    }
+};
+
+COID_NAMESPACE_END
+
+#endif //__COID_COMM_SWISSTABLE__HEADER_FILE__
@@ -1,7 +1,7 @@
 
 #include "interface.h"
 #include "commexception.h"
-#include "hash/hashkeyset.h"
+#include "hash/concurrent_keyset.h"
 #include "sync/mutex.h"
 #include "dir.h"
 #include "intergen/ifc.h"
@@ -40,8 +40,8 @@ struct entry
 ////////////////////////////////////////////////////////////////////////////////
 class interface_register_impl
 {
-    hash_keyset<entry, _Select_Copy<entry, token> > _hash;
-    comm_mutex _mx;
+    concurrent_keyset<entry, _Select_Copy<entry, token> > _hash;
+    comm_mutex _mx;                     //< serializes module unload notifications
 
     charstr _root_path;
     interface_register::fn_log_t _fn_log;
@@ -119,30 +119,25 @@ public:
 
         token handle = modulename.cut_right_back(':', token::cut_trait_remove_sep_default_empty());
 
-        GUARDTHIS(_mx);
-
-        if (!creator_ptr) {
-            return _hash.erase_value(key, 0);
-        }
-        else {
-            entry* en = _hash.insert_value_slot(key);
-            if (en) {
-                en->creator_ptr = creator_ptr;
-                en->ifcname.takeover(tmp);
-                en->ns = ns;
-                en->classname = classname;
-                en->creatorname = creatorname;
-                en->hash = wrapper;
-                en->hashvalue = hash;
-                en->script = script;
-                en->modulename = modulename;
-                en->handle = uints(handle.touint64());
-                en->keylen = key.len();
-                return true;
-            }
-        }
-
-        return false;
+        if (!creator_ptr)
+            return _hash.erase(key);
+
+        //the entry is filled in before it becomes visible to the readers
+        const entry* en = _hash.insert_value_slot(key, [&](entry& en) {
+            en.creator_ptr = creator_ptr;
+            en.ifcname.takeover(tmp);
+            en.ns = ns;
+            en.classname = classname;
+            en.creatorname = creatorname;
+            en.hash = wrapper;
+            en.hashvalue = hash;
+            en.script = script;
+            en.modulename = modulename;
+            en.handle = uints(handle.touint64());
+            en.keylen = key.len();
+        });
+
+        return en != 0;
     }
 
     virtual dynarray<creator>& find_interface_creators(const regex& name, dynarray<creator>& dst)
@@ -150,20 +145,16 @@ public:
         //interface creator names:
         // [ns1::[ns2:: ...]]::class.creator
 
-        GUARDTHIS(_mx);
-
-        auto i = _hash.begin();
-        auto ie = _hash.end();
-        for (; i != ie; ++i) {
-            if (i->script)
-                continue;
+        _hash.for_each([&](const entry& en) {
+            if (en.script)
+                return;
 
-            if (name.match(token(*i))) {
+            if (name.match(token(en))) {
                 creator* p = dst.add();
-                p->creator_ptr = i->creator_ptr;
-                p->name = token(*i);
+                p->creator_ptr = en.creator_ptr;
+                p->name = token(en);
             }
-        }
+        });
 
         return dst;
     }
@@ -184,27 +175,23 @@ public:
         token classname = ns.cut_right_group_back("::"_T);
         token creatorname = classname.cut_right('.', token::cut_trait_remove_sep_default_empty());
 
-        GUARDTHIS(_mx);
-
-        auto i = _hash.begin();
-        auto ie = _hash.end();
-        for (; i != ie; ++i) {
-            if (!script.is_null() && script != i->script)
-                continue;
+        _hash.for_each([&](const entry& en) {
+            if (!script.is_null() && script != en.script)
+                return;
 
-            if (i->classname != classname)
-                continue;
+            if (en.classname != classname)
+                return;
 
-            if (creatorname && i->creatorname != creatorname)
-                continue;
+            if (creatorname && en.creatorname != creatorname)
+                return;
 
-            if (ns && i->ns != ns)
-                continue;
+            if (ns && en.ns != ns)
+                return;
 
             creator* p = dst.add();
-            p->creator_ptr = i->creator_ptr;
-            p->name = token(*i);
-        }
+            p->creator_ptr = en.creator_ptr;
+            p->name = token(en);
+        });
 
         return dst;
     }
@@ -217,31 +204,27 @@ public:
         token classname = ns.cut_right_group_back("::"_T);
         token creatorname = classname.cut_right('.', token::cut_trait_remove_sep_default_empty());
 
-        GUARDTHIS(_mx);
-
-        auto i = _hash.begin();
-        auto ie = _hash.end();
-        for (; i != ie; ++i) {
-            if (i->script)
-                continue;
+        _hash.for_each([&](const entry& en) {
+            if (en.script)
+                return;
 
-            if (i->classname != classname)
-                continue;
+            if (en.classname != classname)
+                return;
 
-            if (creatorname && i->creatorname != creatorname)
-                continue;
+            if (creatorname && en.creatorname != creatorname)
+                return;
 
-            token ins = i->ns;
+            token ins = en.ns;
             if (!script.is_null() && (!ins.consume_end(script) || !ins.consume_end("::"_T)))
-                continue;
+                return;
 
             if (ns && ins != ns)
-                continue;
+                return;
 
             creator* p = dst.add();
-            p->creator_ptr = i->creator_ptr;
-            p->name = token(*i);
-        }
+            p->creator_ptr = en.creator_ptr;
+            p->name = token(en);
+        });
 
         return dst;
     }
@@ -251,21 +234,19 @@ public:
         zstring str = iface;
         str.get_str() << "@client-" << hash << '.' << client;
 
-        GUARDTHIS(_mx);
-
-        const entry* en = _hash.find_value(str);
+        interface_register::client_fn fn = 0;
 
-        if (en) {
-            if (en->hashvalue != hash)
-                return 0;
+        _hash.find(str, [&](const entry& en) {
+            if (en.hashvalue != hash)
+                return;
 
-            if (module && !en->modulename.ends_with_icase(module))
-                return 0;
+            if (module && !en.modulename.ends_with_icase(module))
+                return;
 
-            return (interface_register::client_fn)en->creator_ptr;
-        }
+            fn = (interface_register::client_fn)en.creator_ptr;
+        });
 
-        return 0;
+        return fn;
     }
 
     virtual void* get_interface_maker(const token& name, const token& script) const
@@ -281,24 +262,20 @@ public:
         token ns = iface;
         token classname = ns.cut_right_group_back("::"_T);
 
-        GUARDTHIS(_mx);
-
-        auto i = _hash.begin();
-        auto ie = _hash.end();
-        for (; i != ie; ++i) {
-            if (i->hashvalue != hash)
-                continue;
+        _hash.for_each([&](const entry& en) {
+            if (en.hashvalue != hash)
+                return;
 
-            if (i->hash != "client"_T)
-                continue;
+            if (en.hash != "client"_T)
+                return;
 
-            if (i->classname != classname || i->ns != ns)
-                continue;
+            if (en.classname != classname || en.ns != ns)
+                return;
 
             interface_register::creator* p = dst.add();
-            p->name = i->script;
-            p->creator_ptr = i->creator_ptr;
-        }
+            p->name = en.script;
+            p->creator_ptr = en.creator_ptr;
+        });
 
         return dst;
     }
@@ -313,11 +290,10 @@ public:
 
     virtual interface_register::wrapper_fn find_wrapper(const token& ifcname) const
     {
-        GUARDTHIS(_mx);
-
-        const entry* en = _hash.find_value(ifcname);
+        interface_register::wrapper_fn fn = 0;
+        _hash.find(ifcname, [&fn](const entry& en) { fn = (interface_register::wrapper_fn)en.creator_ptr; });
 
-        return en ? (interface_register::wrapper_fn)en->creator_ptr : 0;
+        return fn;
     }
 
     virtual void setup(const token& path, interface_register::fn_log_t logfn, interface_register::fn_acc_t access, interface_register::fn_getlog_t getlogfn)
@@ -418,39 +394,37 @@ public:
 
                 (str.get_str() = nsc) << "@unload"_T;
 
-                const entry* en = _hash.find_value(str);
-                if (!en)
-                    continue;
-
-                intergen_interface::fn_unload_client fn = (intergen_interface::fn_unload_client)en->creator_ptr;
-
-                fn(""_T, ""_T, uen.bstrlen > 0 ? bstr : 0);
+                intergen_interface::fn_unload_client fn = 0;
+                _hash.find(str, [&fn](const entry& en) { fn = (intergen_interface::fn_unload_client)en.creator_ptr; });
 
+                if (fn)
+                    fn(""_T, ""_T, uen.bstrlen > 0 ? bstr : 0);
             }
             return true;
         }
 
         //find clients residing in given dll
-        auto b = _hash.begin();
-        auto e = _hash.end();
+        //entries stay valid in the read section even after they are erased
+        concurrent_keyset<entry, _Select_Copy<entry, token> >::read_guard guard(_hash);
+        dynarray<const entry*> clients;
 
-        for (; b != e; ) {
-            auto& en = *b;
-            ++b;
-
-            if (en.handle != handle || en.hash != "client"_T)
-                continue;
+        _hash.for_each([&](const entry& en) {
+            if (en.handle == handle && en.hash == "client"_T)
+                clients.push(&en);
+        });
 
+        for (const entry* en : clients)
+        {
             uints len = bstr->len();
 
-            unload_client(en, bstr);
+            unload_client(*en, bstr);
 
             interface_register::unload_entry* ue = ens.add();
-            ue->ifcname.takeover(en.ifcname);
+            ue->ifcname = en->ifcname;
             ue->bstrofs = down_cast<uint>(len);
             ue->bstrlen = down_cast<uint>(bstr->len() - len);
 
-            RASSERT(_hash.erase_value_slot(&en, token(ue->ifcname.ptr(), ue->ifcname.ptr() + en.keylen)));
+            RASSERT(_hash.erase(*en));
         }
 
         return true;
@@ -458,7 +432,7 @@ public:
 
 private:
 
-    bool unload_client(entry& cen, binstring* bstr)
+    bool unload_client(const entry& cen, binstring* bstr)
     {
         const token& client = cen.script;
 
@@ -466,13 +440,10 @@ private:
         zstring str = cen.ns_class();
         str.get_str() << "@unload"_T;
 
-        const entry* en = _hash.find_value(str);
-        if (!en)
-            return true;
-
-        intergen_interface::fn_unload_client fn = (intergen_interface::fn_unload_client)en->creator_ptr;
+        intergen_interface::fn_unload_client fn = 0;
+        _hash.find(str, [&fn](const entry& en) { fn = (intergen_interface::fn_unload_client)en.creator_ptr; });
 
-        return fn(client, cen.modulename, bstr);
+        return fn ? fn(client, cen.modulename, bstr) : true;
     }
 
     //@return current directory from current path
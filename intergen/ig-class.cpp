@@ -591,7 +591,7 @@ void Interface::compute_hash(int version)
 
     mash << 'v' << version;
 
-    hash = __coid_hash_string(mash.ptr(), mash.len());
+    hash = __coid_hash_string_fnv(mash.ptr(), mash.len());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
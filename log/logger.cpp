@@ -48,6 +48,9 @@
 #include "../timer.h"
 #include "../net_ul.h"
 
+#include <chrono>
+#include <ctime>
+
 using namespace coid;
 
 static bool _enable_debug_out = false;
@@ -107,6 +110,155 @@ ref<logmsg> canlog(log::type type, const tokenhash & hash, const void * inst)
     return interface_register::canlog(type, hash, inst);
 }
 
+ref<logmsg> canlog(const log_format& fmt)
+{
+    return interface_register::getlog()->create_msg(fmt);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+log_format::log_format(log::type type, const tokenhash& hash, const token& fmt)
+    : type(type)
+    , hash(hash)
+    , fmt(fmt)
+{
+    static std::atomic<uint> _last_id(0);
+    id = ++_last_id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///Append single argument of a binary message
+static void format_arg( charstr& dst, binstring& args )
+{
+    switch (args.fetch<uint8>()) {
+    case log::arg_int8:   dst << args.fetch<int8>(); break;
+    case log::arg_int16:  dst << args.fetch<int16>(); break;
+    case log::arg_int32:  dst << args.fetch<int32>(); break;
+    case log::arg_int64:  dst << args.fetch<int64>(); break;
+    case log::arg_uint8:  dst << args.fetch<uint8>(); break;
+    case log::arg_uint16: dst << args.fetch<uint16>(); break;
+    case log::arg_uint32: dst << args.fetch<uint32>(); break;
+    case log::arg_uint64: dst << args.fetch<uint64>(); break;
+    case log::arg_float:  dst << args.fetch<float>(); break;
+    case log::arg_double: dst << args.fetch<double>(); break;
+    case log::arg_bool:   dst << (args.fetch<uint8>() ? "true" : "false"); break;
+    case log::arg_char:   dst << args.fetch<char>(); break;
+    case log::arg_ptr:    dst << "0x"; dst.append_num(16, args.fetch<uint64>()); break;
+    case log::arg_str:    dst << args.string<uint16>(); break;
+    default:
+        //unknown type, can't continue
+        args.set_offset(args.len());
+    }
+}
+
+///Substitute arguments of a binary message for {} in the format string, the same way as charstr::print
+static void format_args( charstr& dst, token fmt, binstring& args )
+{
+    args.set_offset(0);
+
+    while (args.has_data()) {
+        token p = fmt.cut_left("{}", false);
+        if (p.ptre() < fmt.ptr()) {
+            dst << p;
+            format_arg(dst, args);
+        }
+        else {
+            //no more {} in the string
+            fmt = p;
+            break;
+        }
+    }
+
+    dst << fmt;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+///Slot of a per-thread message ring
+struct logmsg_slot
+{
+    enum {
+        FREE,                           //< available to the owning thread
+        USED,                           //< handed out, being filled
+        READY,                          //< published, waiting for the writer
+        DROPPED,                        //< released without publishing, writer skips it
+    };
+
+    std::atomic<uint8> state;
+    policy_msg* policy = 0;             //< preallocated message
+    ref<logmsg> msg;                    //< published message, set before READY
+
+    logmsg_slot() : state(FREE)
+    {}
+};
+
+///Ring of preallocated messages of a single thread
+/// The owning thread takes slots at head, the writer thread writes them out in the same order from
+/// the tail, so neither side needs a lock. When the ring gets full the thread continues in a new ring
+/// linked after it. Messages still held by the thread are skipped, so they don't block the ones behind
+/// them, and rings are reused once all their messages are back.
+struct log_ring
+{
+    static const uint SIZE = 64;
+
+    logmsg_slot slots[SIZE];
+    std::atomic<uint> head;             //< next slot to hand out, advanced by the owning thread
+    std::atomic<uint> tail;             //< oldest slot not written out yet, advanced by the writer thread
+    std::atomic<log_ring*> next;        //< ring that replaced this one when it got full
+    std::atomic_bool orphaned;          //< owning thread has exited
+
+    log_ring();
+    ~log_ring();
+
+    //@return free slot or null if the ring is full
+    logmsg_slot* alloc()
+    {
+        uint h = head.load(std::memory_order_relaxed);
+        logmsg_slot& s = slots[h % SIZE];
+        if (s.state.load(std::memory_order_acquire) != logmsg_slot::FREE)
+            return 0;
+
+        s.state.store(logmsg_slot::USED, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+        return &s;
+    }
+
+    //@return true if no message of the ring is handed out or waiting to be written
+    bool is_free() const
+    {
+        for (const logmsg_slot& s : slots) {
+            if (s.state.load(std::memory_order_acquire) != logmsg_slot::FREE)
+                return false;
+        }
+        return true;
+    }
+
+    //@return true if a message is waiting to be written
+    bool has_ready() const
+    {
+        for (const logmsg_slot& s : slots) {
+            if (s.state.load(std::memory_order_acquire) == logmsg_slot::READY)
+                return true;
+        }
+        return false;
+    }
+
+    ///Write out published messages from the tail, skipping the ones still held
+    void write_ready();
+
+    ///Prepare a drained ring for another thread
+    void reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        next.store(0, std::memory_order_relaxed);
+        orphaned.store(false, std::memory_order_relaxed);
+    }
+
+    ///Take a slot from the ring of the current thread
+    //@return slot or null during thread teardown
+    static logmsg_slot* alloc_local();
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 
 class policy_msg : public policy_base
@@ -129,13 +281,15 @@ protected:
         , _obj(obj)
     {}
 
+    friend struct log_ring;
+
 public:
 
     logmsg* get() const { return _obj; }
 
     virtual void _destroy() override
     {
-        DASSERT(_pool != 0);
+        DASSERT(_pool != 0 || _obj->_slot != 0);
 
         if(_obj->_logger) {
             //first destroy just queues the message
@@ -143,6 +297,12 @@ public:
             if (_obj->finalize(this))
                 x->flush();
         }
+        else if (logmsg_slot* s = _obj->_slot) {
+            //back to the ring, written out or dropped by the logger before publishing
+            uint8 used = logmsg_slot::USED;
+            if (!s->state.compare_exchange_strong(used, logmsg_slot::DROPPED, std::memory_order_release))
+                s->state.store(logmsg_slot::FREE, std::memory_order_release);
+        }
         else {
             //back to the pool
             policy_msg* t = this;
@@ -153,6 +313,12 @@ public:
     ///
     static policy_msg* create()
     {
+        logmsg_slot* s = log_ring::alloc_local();
+        if (s) {
+            s->policy->get()->reset();
+            return s->policy;
+        }
+
         pool_type& pool = pool_singleton();
         policy_msg* p=0;
 
@@ -172,6 +338,69 @@ public:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+log_ring::log_ring()
+    : head(0)
+    , tail(0)
+    , next(0)
+    , orphaned(false)
+{
+    for (logmsg_slot& s : slots) {
+        logmsg* m = new logmsg;
+        m->_slot = &s;
+        s.policy = new policy_msg(m);
+    }
+}
+
+log_ring::~log_ring()
+{
+    for (logmsg_slot& s : slots) {
+        delete s.policy->get();
+        delete s.policy;
+    }
+}
+
+logmsg_slot* log_ring::alloc_local()
+{
+    struct holder {
+        log_ring* ring = 0;
+
+        ~holder() {
+            //the writer recycles the ring once it's drained
+            if (ring)
+                ring->orphaned.store(true, std::memory_order_release);
+            ring = 0;
+            gone() = true;
+        }
+
+        static bool& gone() {
+            static thread_local bool gone = false;
+            return gone;
+        }
+    };
+
+    static thread_local holder h;
+
+    if (!h.ring) {
+        if (holder::gone())
+            return 0;
+
+        log_writer& lw = SINGLETON(log_writer);
+        h.ring = lw.alloc_ring();
+        lw.add_ring(h.ring);
+    }
+
+    logmsg_slot* s = h.ring->alloc();
+    if (!s) {
+        //full, continue in another ring linked after this one
+        log_ring* r = SINGLETON(log_writer).alloc_ring();
+        h.ring->next.store(r, std::memory_order_release);
+        h.ring = r;
+        s = r->alloc();
+    }
+    return s;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 class logger_file
 {
@@ -179,6 +408,14 @@ class logger_file
     charstr _logbuf;
     charstr _logpath;
     bool _stdout;
+    bool _cache = true;                 //< keep messages until the log file is opened
+
+    bofstream _binfile;
+    charstr _binpath;
+    binstring _binrec;
+    dynarray<uint> _binformats;         //< file format id + 1 of formats already written to the binary file, by format id
+    uint _nbinformats = 0;              //< formats written to the binary file
+    bool _bintext = false;              //< binary messages are written to the text log as well
 
 
     bool check_file_open()
@@ -195,10 +432,65 @@ class logger_file
         return e==0;
     }
 
+    bool check_binfile_open()
+    {
+        if(_binfile.is_open() || !_binpath)
+            return _binfile.is_open();
+
+        opcd e = _binfile.open(_binpath);
+        if(!e) {
+            //messages carry the monotonic time, the header pairs it with the local time of day
+            const uint32 version = BINLOG_VERSION;
+            const uint64 base[2] = { nsec_timer::current_time_ns(), local_day_time_ns() };
+            _binfile.xwrite_token_raw(BINLOG_MAGIC);
+            _binfile.xwrite_raw(&version, sizeof(version));
+            _binfile.xwrite_raw(base, sizeof(base));
+        }
+
+        return e==0;
+    }
+
 public:
-    explicit logger_file( bool std_out ) : _stdout(std_out) {}
+
+    static const token BINLOG_MAGIC;
+    static const uint32 BINLOG_VERSION = 3;
+    static const uints BINREC_BATCH = 64 * 1024;   //< batched binary records written at once
+
+    ///Binary log record kinds, following the magic, uint32 version, uint64 monotonic time in ns and uint64 local time of day in ns
+    enum : uint8 {
+        BINREC_FORMAT = 'F',            //< uint32 id (sequential within the file), uint8 type, uint16 source length, source, uint16 format length, format
+        BINREC_MSG = 'M',               //< uint32 format id, uint64 monotonic time in ns, uint32 args length, args
+    };
+
+    ///Wall clock time since the local day start
+    static uint64 local_day_time_ns()
+    {
+        using namespace std::chrono;
+        nanoseconds now = system_clock::now().time_since_epoch();
+        time_t t = time_t(duration_cast<seconds>(now).count());
+
+#ifdef SYSTYPE_MSVC
+        struct tm tm;
+        localtime_s(&tm, &t);
+#else
+        struct tm tm;
+        localtime_r(&t, &tm);
+#endif
+        uint64 sec = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+        return sec * 1000000000ULL + uint64(now.count() % 1000000000);
+    }
+
+    explicit logger_file( bool std_out, bool cache = true ) : _stdout(std_out), _cache(cache) {
+        _binrec.set_packing(1);
+    }
     logger_file( const token& path, bool std ) : _logpath(path), _stdout(std)
-    {}
+    {
+        _binrec.set_packing(1);
+    }
+
+    ~logger_file() {
+        flush_binary();
+    }
 
     ///Open physical log file. @note Only notes the file name, the file is opened with the next log msg because of potential MT clashes
     void open( charstr filename, bool std ) {
@@ -206,11 +498,53 @@ public:
         _stdout = std;
     }
 
+    ///Set binary log file. @note Also opened with the next binary message
+    void open_binary( charstr filename, bool text ) {
+        std::swap(_binpath, filename);
+        _bintext = text;
+    }
+
+    ///Write binary message to the binary log file
+    //@return true if the message shouldn't be written to the text log
+    bool write_binary( const logmsg& lm )
+    {
+        if(!check_binfile_open())
+            return false;
+
+        const log_format* f = lm.get_format();
+        //process-wide ids are sparse, the file numbers its formats in the order of appearance
+        uint& fid = _binformats.get_or_addc(f->id);
+        if(!fid) {
+            fid = ++_nbinformats;
+            _binrec << BINREC_FORMAT << uint32(fid - 1) << uint8(f->type);
+            _binrec.append_string<uint16>(f->hash);
+            _binrec.append_string<uint16>(f->fmt);
+        }
+
+        const binstring& args = lm.args();
+        _binrec << BINREC_MSG << uint32(fid - 1) << uint64(lm.get_time()) << uint32(args.len());
+        _binrec.append_buffer(args.ptr(), args.len());
+
+        //records are batched, written out when the buffer fills up or the writer drains
+        if(_binrec.len() >= BINREC_BATCH)
+            flush_binary();
+
+        return !_bintext;
+    }
+
+    ///Write out batched binary records
+    void flush_binary()
+    {
+        if(_binrec.len() && _binfile.is_open())
+            _binfile.xwrite_raw(_binrec.ptr(), _binrec.len());
+        _binrec.reset();
+    }
+
     void write_to_file( const logmsg& lm )
     {
         if(check_file_open())
             _logfile.xwrite_token_raw(lm.str());
-        else
+        else if(_cache)
             _logbuf << lm.str();
 
         if(_stdout)
@@ -218,6 +552,8 @@ public:
     }
 };
 
+const token logger_file::BINLOG_MAGIC = "coidblog";
+
 } //namespace coid
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -225,11 +561,33 @@ logmsg::logmsg()
 {
     //reserve memory from process allocator
     _str.reserve(128, PROCWIDE_SINGLETON(comm_array_mspace).msp);
+    _args.get_buf().reserve(64, false, PROCWIDE_SINGLETON(comm_array_mspace).msp);
+    _args.set_packing(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void logmsg::format()
+{
+    if (!_format || _str)
+        return;
+
+    _str << type2tok(_type);
+    if (_hash)
+        _str << '[' << _hash << "] ";
+
+    format_args(_str, _format->fmt, _args);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void logmsg::write()
 {
+    if (_format) {
+        if (_logger_file && _logger_file->write_binary(*this))
+            return;
+
+        format();
+    }
+
     if(!_str.ends_with('\n'))
         _str.append('\n');
 
@@ -242,15 +600,15 @@ void logmsg::write()
 ////////////////////////////////////////////////////////////////////////////////
 bool logmsg::finalize( policy_msg* p )
 {
-    if (_type == log::perf) {
+    if (_type == log::perf && !_format) {
         int64 ns = nsec_timer::current_time_ns() - _time;
         _str << " (" << (ns * 1.0e-6f) << "ms)";
     }
 
-    if (_type == log::none)
+    if (_type == log::none && !_format)
         _type = deduce_type();
 
-    bool flush = _str.last_char() == '\r';
+    bool flush = !_format && _str.last_char() == '\r';
 
     _logger_file = _logger->file();
     _logger->enqueue(ref<logmsg>(p));
@@ -264,7 +622,8 @@ bool logmsg::finalize( policy_msg* p )
 
 ////////////////////////////////////////////////////////////////////////////////
 logger::logger(bool std_out, bool cache_msgs)
-    : _stdout(std_out)
+    : _filter_snapshot(0)
+    , _stdout(std_out)
     , _mutex(512, false)
 {
     SINGLETON(log_writer);
@@ -273,6 +632,12 @@ logger::logger(bool std_out, bool cache_msgs)
         _logfile = ref<logger_file>(new logger_file(std_out));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+logger::~logger()
+{
+    delete _filter_snapshot.load();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void logger::terminate()
 {
@@ -289,14 +654,35 @@ void logger::enable_debug_out(bool en)
 uints logger::register_filter(const log_filter& filter) 
 { 
     GUARDTHIS(_mutex);
-    return _filters.get_item_id(_filters.push(filter));
+    uints id = _filters.get_item_id(_filters.push(filter));
+    update_filter_snapshot();
+    return id;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void logger::unregister_filter(uints pos) 
 { 
     GUARDTHIS(_mutex);
-    _filters.del_item(pos); 
+    _filters.del_item(pos);
+    update_filter_snapshot();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void logger::update_filter_snapshot()
+{
+    filter_snapshot* fs = 0;
+    if (_filters.count()) {
+        fs = new filter_snapshot;
+        _filters.for_each([fs](const log_filter& f) {
+            fs->push(f);
+        });
+    }
+
+    //the old snapshot is released once the enqueue calls that could have loaded it are done
+    const filter_snapshot* old = _filter_snapshot.exchange(fs, std::memory_order_acq_rel);
+    if (old)
+        _snapshot_readers.retire(const_cast<filter_snapshot*>(old), [](void* p) { delete static_cast<filter_snapshot*>(p); });
+    _snapshot_readers.collect();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -357,21 +743,42 @@ ref<logmsg> logger::create_msg( log::type type, const tokenhash& hash )
     return msg;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+ref<logmsg> logger::create_msg( const log_format& fmt )
+{
+    if (fmt.type > _minlevel && (!_allow_perf || fmt.type != log::perf))
+        return ref<logmsg>();
+
+    ref<logmsg> msg = ref<logmsg>(policy_msg::create());
+    msg->set_type(fmt.type);
+    msg->set_hash(fmt.hash);
+    msg->set_format(&fmt);
+    msg->set_logger(this);
+    msg->set_time(nsec_timer::current_time_ns());
+
+    return msg;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void logger::enqueue( ref<logmsg>&& msg )
 {
-    {
-        GUARDTHIS(_mutex);
+    uint slot = _snapshot_readers.enter();
 
-        _filters.for_each([&](const log_filter& f) {
+    const filter_snapshot* filters = _filter_snapshot.load(std::memory_order_acquire);
+    if (filters) {
+        for (const log_filter& f : *filters) {
             if (msg->get_type() <= (log::type)f._log_level
                 && f._module.cmpeq(msg->get_hash()))
             {
+                //filters get the text of binary messages
+                msg->format();
                 f._filter_fun(msg);
             }
-        });
-
+        }
     }
+
+    _snapshot_readers.leave(slot);
+
     SINGLETON(log_writer).addmsg(std::forward<ref<logmsg>>(msg));
 }
 
@@ -404,6 +811,104 @@ void logger::open(const token& filename)
     _logfile->open(filename, _stdout);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void logger::open_binary(const token& filename, bool text)
+{
+    if (!_logfile)
+        _logfile = ref<logger_file>(new logger_file(_stdout, false));
+
+    _logfile->open_binary(filename, text);
+    SINGLETON(log_writer).add_binary(_logfile);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+opcd logger::decode_binary(binstream& in, binstream& out)
+{
+    struct format {
+        log::type type = log::none;
+        charstr hash;
+        charstr fmt;
+    };
+
+    binstring bin;
+    bin.set_packing(1);
+    bin.load_from_binstream(in);
+
+    if (bin.len() < logger_file::BINLOG_MAGIC.len() + sizeof(uint32)
+        || token((const char*)bin.ptr(), logger_file::BINLOG_MAGIC.len()) != logger_file::BINLOG_MAGIC)
+        return ersINVALID_TYPE "not a binary log";
+
+    bin.set_offset(logger_file::BINLOG_MAGIC.len());
+    if (bin.fetch<uint32>() != logger_file::BINLOG_VERSION)
+        return ersINVALID_VERSION;
+
+    if (bin.remaining_len() < 2 * sizeof(uint64))
+        return ersNO_MORE "truncated binary log";
+
+    static const int64 DAY_NS = 86400LL * 1000000000LL;
+    uint64 base_ns = bin.fetch<uint64>();
+    int64 day_ns = bin.fetch<uint64>();
+
+    dynarray<format> formats;
+    binstring args;
+    args.set_packing(1);
+    charstr line;
+
+    try {
+        while (bin.has_data()) {
+            uint8 kind = bin.fetch<uint8>();
+
+            if (kind == logger_file::BINREC_FORMAT) {
+                //ids come in sequence, don't size anything by an id from the file
+                if (bin.fetch<uint32>() != formats.size())
+                    return ersINVALID_PARAMS "unexpected format id";
+
+                format& f = *formats.add();
+                f.type = log::type(bin.fetch<uint8>());
+                f.hash = bin.string<uint16>();
+                f.fmt = bin.string<uint16>();
+            }
+            else if (kind == logger_file::BINREC_MSG) {
+                uint id = bin.fetch<uint32>();
+                uint64 ns = bin.fetch<uint64>();
+                uint32 size = bin.fetch<uint32>();
+                const void* p = bin.read_buffer(size);
+
+                if (id >= formats.size())
+                    return ersINVALID_PARAMS "message with an unknown format";
+                const format& f = formats[id];
+
+                ::memcpy(args.alloc(size), p, size);
+
+                line.reset();
+                //messages can be created before the file was opened
+                int64 tod = (day_ns + int64(ns - base_ns)) % DAY_NS;
+                if (tod < 0)
+                    tod += DAY_NS;
+                line.append_time_formatted(tod / 1000000, true, 3);
+                line << ' ' << logmsg::type2tok(f.type);
+                if (f.hash)
+                    line << '[' << f.hash << "] ";
+
+                format_args(line, f.fmt, args);
+                line << '\n';
+
+                out.xwrite_token_raw(line);
+            }
+            else
+                return ersSYNTAX_ERROR "unknown record";
+        }
+    }
+    catch (const exception&) {
+        return ersNO_MORE "truncated binary log";
+    }
+    catch (opcd e) {
+        return e;
+    }
+
+    return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void logger::flush()
 {
@@ -416,6 +921,7 @@ void logger::flush()
 log_writer::log_writer()
     : _thread()
     , _queue()
+    , _rings_mutex(512, false)
 {
     //make sure the dependent singleton gets created
     policy_msg::pool_singleton();
@@ -428,6 +934,76 @@ log_writer::log_writer()
 log_writer::~log_writer()
 {
     terminate();
+
+    //rings left after the final flush belong to threads that can still log, they are leaked
+    log_ring* r;
+    while (_free_rings.create_instance(r))
+        delete r;
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void log_writer::addmsg(logmsg_ptr&& m)
+{
+    logmsg_slot* s = m->_slot;
+    if (s) {
+        s->msg.takeover(m);
+        s->state.store(logmsg_slot::READY, std::memory_order_release);
+    }
+    else
+        _queue.push(std::forward<logmsg_ptr>(m));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void log_writer::add_ring(log_ring* ring)
+{
+    GUARDTHIS(_rings_mutex);
+    shared_mspace_guard shared;
+    _rings.push(ring);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void log_writer::add_binary(const ref<logger_file>& file)
+{
+    GUARDTHIS(_rings_mutex);
+    for (const ref<logger_file>& f : _binfiles) {
+        if (f.get() == file.get())
+            return;
+    }
+    shared_mspace_guard shared;
+    _binfiles.push(file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+log_ring* log_writer::alloc_ring()
+{
+    log_ring* r = 0;
+    if (!_free_rings.create_instance(r))
+        r = new log_ring;
+    return r;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void log_writer::free_ring(log_ring* ring)
+{
+    ring->reset();
+    _free_rings.release_instance(ring);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool log_writer::is_empty() const
+{
+    if (!_queue.is_empty())
+        return false;
+
+    GUARDTHIS(_rings_mutex);
+    for (const log_ring* r : _rings) {
+        for (; r; r = r->next.load(std::memory_order_acquire)) {
+            if (r->has_ready())
+                return false;
+        }
+    }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -458,9 +1034,104 @@ void log_writer::flush()
 
     //int maxloop = 3000 / 20;
 
+    //held over the whole drain so that is_empty doesn't see batched binary records as written
+    GUARDTHIS(_rings_mutex);
+
     while( _queue.pop(m) ) {
-        DASSERT( m->str() );
+        DASSERT( m->str() || m->get_format() );
         m->write();
         m.release();
     }
+
+    for (uints i = 0; i < _rings.size(); ) {
+        log_ring* r = drain(_rings[i]);
+        if (r)
+            _rings[i++] = r;
+        else
+            _rings.del(i);
+    }
+
+    for (uints i = 0; i < _binfiles.size(); ) {
+        _binfiles[i]->flush_binary();
+
+        //closed once the logger and its messages are gone
+        if (_binfiles[i].refcount() == 1)
+            _binfiles.del(i);
+        else
+            ++i;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void log_ring::write_ready()
+{
+    //slots up to head stay in use until they are written out or dropped
+    uint t = tail.load(std::memory_order_relaxed);
+    const uint h = head.load(std::memory_order_acquire);
+    bool held = false;
+
+    for (uint i = t; i != h; ++i) {
+        logmsg_slot& s = slots[i % SIZE];
+        uint8 state = s.state.load(std::memory_order_acquire);
+
+        if (state == logmsg_slot::READY) {
+            ref<logmsg> m;
+            m.takeover(s.msg);
+
+            //releasing the last reference drops the slot, a filter may still hold one
+            s.state.store(logmsg_slot::USED, std::memory_order_relaxed);
+
+            DASSERT( m->str() || m->get_format() );
+            m->write();
+            m.release();
+
+            state = logmsg_slot::DROPPED;
+            if (s.state.compare_exchange_strong(state, logmsg_slot::FREE, std::memory_order_acq_rel))
+                state = logmsg_slot::FREE;
+        }
+        else if (state == logmsg_slot::DROPPED) {
+            s.state.store(logmsg_slot::FREE, std::memory_order_release);
+            state = logmsg_slot::FREE;
+        }
+
+        //tail stays at the oldest held message, the ones behind it go out anyway
+        if (state != logmsg_slot::FREE)
+            held = true;
+        else if (!held)
+            t = i + 1;
+    }
+
+    tail.store(t, std::memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+log_ring* log_writer::drain(log_ring* ring)
+{
+    log_ring* first = 0;
+    log_ring* prev = 0;
+
+    while (ring) {
+        //check before draining, so that nothing can be published after the last look
+        log_ring* next = ring->next.load(std::memory_order_acquire);
+        const bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+
+        ring->write_ready();
+
+        //a replaced or orphaned ring is reused once none of its messages is handed out,
+        // the thread only touches its last ring so the chain can be relinked around it
+        if ((next || orphaned) && ring->is_free()) {
+            if (prev)
+                prev->next.store(next, std::memory_order_release);
+            free_ring(ring);
+        }
+        else {
+            if (!first)
+                first = ring;
+            prev = ring;
+        }
+
+        ring = next;
+    }
+
+    return first;
 }
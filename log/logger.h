@@ -37,9 +37,12 @@
 #define __COMM_LOGGER_H__
 
 #include "../str.h"
+#include "../binstring.h"
 #include "../ref.h"
 #include "../function.h"
 #include "../alloc/slotalloc.h"
+#include "../hash/concurrent_keyset.h"
+#include <atomic>
 
 COID_NAMESPACE_BEGIN
 
@@ -94,16 +97,132 @@ inline const char* name(type t) {
         : 0;
 }
 
+///Argument types of binary log messages
+enum arg_type : uint8 {
+    arg_int8,
+    arg_int16,
+    arg_int32,
+    arg_int64,
+    arg_uint8,
+    arg_uint16,
+    arg_uint32,
+    arg_uint64,
+    arg_float,
+    arg_double,
+    arg_bool,
+    arg_char,
+    arg_ptr,
+    arg_str,                            //< uint16 length followed by the characters
+};
+
+///Write string argument, truncated to 64k
+inline void write_arg_str( binstring& bin, const token& tok )
+{
+    bin << uint8(arg_str);
+    bin.append_string<uint16>(tok.len() > 0xffff ? token(tok.ptr(), 0xffff) : tok);
+}
+
+///Binary argument writer, types without a binary form are stored as text
+template<class T, class Enable = void>
+struct arg_writer {
+    static void write( binstring& bin, const T& v ) {
+        charstr tmp;
+        tmp << v;
+        write_arg_str(bin, tmp);
+    }
+};
+
+template<class T>
+struct arg_writer<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+    static void write( binstring& bin, T v ) {
+        const uint8 t = (std::is_signed<T>::value ? arg_int8 : arg_uint8)
+            + (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3);
+        bin << t << v;
+    }
+};
+
+template<class T>
+struct arg_writer<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    static void write( binstring& bin, T v ) {
+        typedef typename std::underlying_type<T>::type U;
+        arg_writer<U>::write(bin, U(v));
+    }
+};
+
+template<class T>
+struct arg_writer<T*> {
+    static void write( binstring& bin, const T* v ) {
+        bin << uint8(arg_ptr) << uint64(uints(v));
+    }
+};
+
+template<> struct arg_writer<bool> {
+    static void write( binstring& bin, bool v ) { bin << uint8(arg_bool) << uint8(v); }
+};
+
+template<> struct arg_writer<char> {
+    static void write( binstring& bin, char v ) { bin << uint8(arg_char) << v; }
+};
+
+template<> struct arg_writer<float> {
+    static void write( binstring& bin, float v ) { bin << uint8(arg_float) << v; }
+};
+
+template<> struct arg_writer<double> {
+    static void write( binstring& bin, double v ) { bin << uint8(arg_double) << v; }
+};
+
+template<> struct arg_writer<const char*> {
+    static void write( binstring& bin, const char* v ) { write_arg_str(bin, token(v)); }
+};
+
+template<> struct arg_writer<char*> {
+    static void write( binstring& bin, const char* v ) { write_arg_str(bin, token(v)); }
+};
+
+template<> struct arg_writer<token> {
+    static void write( binstring& bin, const token& v ) { write_arg_str(bin, v); }
+};
+
+template<> struct arg_writer<charstr> {
+    static void write( binstring& bin, const charstr& v ) { write_arg_str(bin, v); }
+};
+
+///Append argument to the binary message
+template<class T>
+inline void write_arg( binstring& bin, const T& v ) {
+    arg_writer<typename std::decay<T>::type>::write(bin, v);
+}
+
 } //namespace log
 
 class logger_file;
 class logger;
 class logmsg;
 class policy_msg;
+class log_writer;
+struct logmsg_slot;
+struct log_ring;
+
+///Static format of a binary log message, one per call site
+/// Binary messages only store the raw arguments, they are formatted by the log writer thread or
+/// written to a binary log file as they are.
+struct log_format
+{
+    log::type type;
+    tokenhash hash;                     //< source identifier
+    token fmt;                          //< format string with {} for variable substitutions
+    uint id;                            //< process-unique format id
+
+    log_format( log::type type, const tokenhash& hash, const token& fmt );
+};
 
 //@return logmsg object if given log type and source is currently allowed to log
 ref<logmsg> canlog( log::type type, const tokenhash& hash = tokenhash(), const void* inst = 0 );
 
+//@return binary logmsg object if the log type and source of the format is currently allowed to log
+ref<logmsg> canlog( const log_format& fmt );
+
 
 #ifdef COID_VARIADIC_TEMPLATES
 
@@ -114,6 +233,11 @@ ref<logmsg> canlog( log::type type, const tokenhash& hash = tokenhash(), const v
 template<class ...Vs>
 void printlog( log::type type, const tokenhash& hash, const token& fmt, Vs&&... vs);
 
+///Binary log message, arguments are formatted later by the log writer thread
+//@param fmt static format of the call site
+template<class ...Vs>
+void printlog_bin( const log_format& fmt, const Vs&... vs );
+
 #endif //COID_VARIADIC_TEMPLATES
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -127,6 +251,14 @@ void printlog( log::type type, const tokenhash& hash, const token& fmt, Vs&&...
 #define coidlog_error(src, msg)   do{ ref<coid::logmsg> q = coid::canlog(coid::log::error, src ); if (q) {q->str() << msg; }} while(0)
 //@}
 
+///Log message with deferred formatting, arguments are substituted for {} in the format string
+/// Only the raw arguments are recorded on the calling thread, @see printlog_bin
+//@note the format is created once per call site, lvl must be a constant and src and fmt string literals
+#define coidlog_bin(lvl, src, fmt, ...) do{ \
+    static constexpr coid::log::type _coid_type = lvl; \
+    static const coid::log_format _coid_fmt(_coid_type, "" src, "" fmt); \
+    coid::printlog_bin(_coid_fmt, ##__VA_ARGS__); } while(0)
+
 ///Create a perf object that logs the time while the scope exists
 #define coidlog_perf_scope(src, msg) \
    ref<coid::logmsg> perf##line = coid::canlog(coid::log::perf, src); if (perf##line) perf##line->str() << msg
@@ -163,15 +295,21 @@ class logmsg
 protected:
 
     friend class policy_msg;
+    friend class log_writer;
+    friend struct log_ring;
 
     logger* _logger = 0;
     ref<logger_file> _logger_file;
+    logmsg_slot* _slot = 0;             //< slot of the per-thread ring holding this message, null if pooled
 
     tokenhash _hash;
     log::type _type = log::none;
     charstr _str;
     uint64 _time = 0;
 
+    const log_format* _format = 0;      //< format of a binary message
+    binstring _args;                    //< raw arguments of a binary message
+
 public:
 
     COIDNEWDELETE(logmsg);
@@ -194,6 +332,8 @@ public:
         _str.reset();
         _logger = 0;
         _logger_file.release();
+        _format = 0;
+        _args.reset();
     }
 
     void write();
@@ -257,6 +397,18 @@ public:
     charstr& str() { return _str; }
     const charstr& str() const { return _str; }
 
+    void set_format(const log_format* fmt) { _format = fmt; }
+
+    //@return format of a binary message, null for text messages
+    const log_format* get_format() const { return _format; }
+
+    //@return raw arguments of a binary message
+    binstring& args() { return _args; }
+    const binstring& args() const { return _args; }
+
+    ///Format arguments of a binary message into the text
+    void format();
+
 protected:
 
     //@return true if looger should be flushed (msg ended with \r)
@@ -284,6 +436,19 @@ inline void printlog( log::type type, const tokenhash& hash, const token& fmt, V
     str.print(fmt, std::forward<Vs>(vs)...);
 }
 
+///Binary log message, arguments are formatted later by the log writer thread
+//@param fmt static format of the call site
+template<class ...Vs>
+inline void printlog_bin( const log_format& fmt, const Vs&... vs )
+{
+    ref<logmsg> msgr = canlog(fmt);
+    if (!msgr)
+        return;
+
+    binstring& args = msgr->args();
+    variadic_call([&args](int, const auto& v) { log::write_arg(args, v); }, vs...);
+}
+
 #endif //COID_VARIADIC_TEMPLATES
 
 struct log_filter {
@@ -318,7 +483,12 @@ struct log_filter {
 class logger
 {
 protected:
-    slotalloc<log_filter> _filters;
+    typedef dynarray<log_filter> filter_snapshot;
+
+    slotalloc<log_filter> _filters;                     //< registered filters, guarded by _mutex
+    std::atomic<const filter_snapshot*> _filter_snapshot;  //< immutable copy of the filters read by enqueue without locking
+    epoch_domain _snapshot_readers;                     //< enqueue calls reading a snapshot, replaced copies are released after them
+
     ref<logger_file> _logfile;
 
     log::type _minlevel = log::last;
@@ -332,12 +502,22 @@ public:
     //@param std_out true if messages should be printed to stdout as well
     //@param cache_msgs true if messages should be cached until the log file is specified with open()
     logger( bool std_out, bool cache_msgs );
-    virtual ~logger() {}
+    virtual ~logger();
 
     static void terminate();
 
     void open( const token& filename );
 
+    ///Write binary messages to a binary log file
+    //@param filename binary log file, decoded by decode_binary
+    //@param text true if binary messages should be written to the text log as well
+    void open_binary( const token& filename, bool text = false );
+
+    ///Decode binary log file into text
+    //@param in binary log written via open_binary
+    //@param out text output, one line per message prefixed with the message time
+    static opcd decode_binary( binstream& in, binstream& out );
+
     void post( const token& msg, const token& prefix = token() );
 
 #ifdef COID_VARIADIC_TEMPLATES
@@ -373,6 +553,11 @@ public:
     //@return an empty logmsg object
     ref<logmsg> create_msg( log::type type, const tokenhash& hash );
 
+    ///Creates binary logmsg object if the log type of the format is enabled
+    //@param fmt static format of the message
+    //@return logmsg reference or null if not enabled
+    ref<logmsg> create_msg( const log_format& fmt );
+
     ///Creates logmsg object if given log message type is enabled
     //@param type log level
     //@param hash tokenhash identifying the client (interface) name
@@ -392,6 +577,12 @@ public:
 
     uints register_filter(const log_filter& filter);
     void unregister_filter(uints pos);
+
+protected:
+
+    ///Publish a new filter snapshot after a change of _filters
+    //@note _mutex must be locked
+    void update_filter_snapshot();
 };
 
 
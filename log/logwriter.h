@@ -36,7 +36,8 @@
 #ifndef __COMM_LOGWRITTER_H__
 #define __COMM_LOGWRITTER_H__
 
-#include "../sync/queue.h"
+#include "../atomic/queue.h"
+#include "../atomic/pool_base.h"
 #include "logger.h"
 //#include "../pthreadx.h"
 
@@ -46,7 +47,13 @@ class log_writer
 {
 protected:
 	coid::thread _thread;
-	coid::queue<logmsg_ptr> _queue;
+	atomic::queue<logmsg_ptr> _queue;               //< messages from the shared pool
+
+    dynarray<log_ring*> _rings;                     //< per-thread message rings
+    pool<log_ring*> _free_rings;                    //< drained rings for reuse
+    mutable comm_mutex _rings_mutex;
+
+    dynarray<ref<logger_file>> _binfiles;           //< files with binary logs, batched records written out after each drain
 
 public:
 	log_writer();
@@ -59,17 +66,32 @@ public:
 
 	void* thread_run();
 
-	void addmsg(logmsg_ptr&& m) {
-        _queue.push(std::forward<logmsg_ptr>(m));
-    }
+    ///Queue message for writing; messages from per-thread rings are published in their slots
+	void addmsg(logmsg_ptr&& m);
+
+    ///Register ring of a thread, drained by the writer thread
+    void add_ring(log_ring* ring);
+
+    ///Register file with a binary log
+    void add_binary(const ref<logger_file>& file);
+
+    ///Take a drained ring or create a new one
+    log_ring* alloc_ring();
+
+    ///Return drained ring for reuse
+    void free_ring(log_ring* ring);
 
 	void flush();
 
     void terminate();
 
-    bool is_empty() const {
-        return _queue.is_empty();
-    }
+    bool is_empty() const;
+
+protected:
+
+    ///Write out ready messages of the thread's rings, recycling the rings that are done
+    //@return the oldest ring still in use or null if the thread has exited and all its rings are done
+    log_ring* drain(log_ring* ring);
 };
 
 COID_NAMESPACE_END
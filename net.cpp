@@ -68,6 +68,7 @@
 # include <unistd.h>
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/uio.h>
 # include <arpa/inet.h>
 # include <netinet/tcp.h>
 # include <time.h>
@@ -738,6 +739,58 @@ namespace coid {
         return ::send(handle, (const char*)buffer, size, flags);
     }
 
+    ////////////////////////////////////////////////////////////////////////////////
+    ///Send spans with sendmsg in batches of 64, or consecutive sends on Windows
+    //@return number of bytes sent, or -1 on error
+    int netSocket::sendv(const binstream::span* spans, int count, int flags)
+    {
+        if (handle == UMAXS)
+            throw ersDISCONNECTED;  //invalid handle
+
+#ifdef SYSTYPE_WIN
+        int total = 0;
+        for (int i = 0; i < count; ++i) {
+            int n = ::send(handle, (const char*)spans[i].ptr, (int)spans[i].len, flags);
+            if (n < 0)
+                return total ? total : n;
+
+            total += n;
+            if (n < (int)spans[i].len)
+                break;
+        }
+        return total;
+#else
+        static const int NIOV = 64;
+        iovec iov[NIOV];
+
+        int total = 0;
+        for (int b = 0; b < count; b += NIOV) {
+            int nb = count - b < NIOV ? count - b : NIOV;
+            uints size = 0;
+
+            for (int i = 0; i < nb; ++i) {
+                iov[i].iov_base = (void*)spans[b + i].ptr;
+                iov[i].iov_len = spans[b + i].len;
+                size += spans[b + i].len;
+            }
+
+            msghdr msg;
+            ::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nb;
+
+            int n = (int)::sendmsg(handle, &msg, flags);
+            if (n < 0)
+                return total ? total : n;
+
+            total += n;
+            if (uints(n) < size)
+                break;
+        }
+        return total;
+#endif
+    }
+
     ////////////////////////////////////////////////////////////////////////////////
     int netSocket::sendto(const void * buffer, int size, int flags, const netAddress* to)
     {
@@ -265,6 +265,7 @@ public:
     int   connect     ( const token& host, int port, bool portoverride ) ;
     int   connect     ( const netAddress& addr ) ;
     int   send        ( const void* buffer, int size, int flags = 0 ) ;
+    int   sendv       ( const binstream::span* spans, int count, int flags = 0 ) ;
     int   sendto      ( const void* buffer, int size, int flags, const netAddress* to ) ;
     int   recv        ( void* buffer, int size, int flags = 0 ) ;
     int   recvfrom    ( void* buffer, int size, int flags, netAddress* from ) ;
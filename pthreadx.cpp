@@ -8,6 +8,9 @@
 #   define WIN32_LEAN_AND_MEAN
 #   include <windows.h>
 #   include <process.h>
+#else
+#   include <stdio.h>
+#   include <unistd.h>
 #endif
 
 
@@ -109,6 +112,83 @@ void thread::set_affinity_mask(uint64 mask)
 #endif
 }
 
+////////////////////////////////////////////////////////////////////////////////
+#ifndef SYSTYPE_WIN
+//@return cpu mask parsed from sysfs cpulist format ("0-3,8,10-11")
+static uint64 read_cpulist(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return 0;
+
+    uint64 mask = 0;
+    uint a, b;
+    char sep;
+    while (fscanf(f, "%u", &a) == 1) {
+        b = a;
+        sep = (char)fgetc(f);
+        if (sep == '-') {
+            if (fscanf(f, "%u", &b) != 1)
+                break;
+            sep = (char)fgetc(f);
+        }
+
+        for (uint i = a; i <= b && i < 64; ++i)
+            mask |= (uint64)1 << i;
+
+        if (sep != ',')
+            break;
+    }
+
+    fclose(f);
+    return mask;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+uint thread::numa_node_count()
+{
+#ifdef SYSTYPE_WIN
+    ULONG highest = 0;
+    if (!GetNumaHighestNodeNumber(&highest))
+        return 1;
+    return highest + 1;
+#else
+    uint n = 0;
+    char path[64];
+    for (;; ++n) {
+        sprintf(path, "/sys/devices/system/node/node%u/cpulist", n);
+        FILE* f = fopen(path, "r");
+        if (!f)
+            break;
+        fclose(f);
+    }
+    return n ? n : 1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+uint64 thread::numa_node_mask(uint node)
+{
+#ifdef SYSTYPE_WIN
+    ULONGLONG mask = 0;
+    if (!GetNumaNodeProcessorMask((UCHAR)node, &mask))
+        return 0;
+    return mask;
+#else
+    char path[64];
+    sprintf(path, "/sys/devices/system/node/node%u/cpulist", node);
+    uint64 mask = read_cpulist(path);
+
+    if (!mask && node == 0) {
+        //no NUMA info, all processors
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        mask = ncpu >= 64 ? ~(uint64)0 : ((uint64)1 << ncpu) - 1;
+    }
+    return mask;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 thread thread::create_new_fn( const function<void*()>& fn, void* context, const token& name )
 {
@@ -128,6 +128,12 @@ public:
     // sets a processor affinity mask for current thread
     static void set_affinity_mask(uint64 mask);
 
+    //@return number of NUMA nodes, 1 if not available
+    static uint numa_node_count();
+
+    //@return affinity mask of processors (first 64) belonging to given NUMA node
+    static uint64 numa_node_mask(uint node);
+
     //@{ Static methods dealing with the thread currently running
 
     //@return context info given when current thread was created
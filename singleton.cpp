@@ -37,7 +37,8 @@
 
 #include "singleton.h"
 #include "sync/mutex.h"
-#include "hash/hashkeyset.h"
+#include "hash/concurrent_keyset.h"
+#include "alloc/commalloc.h"
 
 #include "binstream/filestream.h"
 #include "binstream/txtstream.h"
@@ -87,6 +88,8 @@ class global_singleton_manager
             ptr = 0;
         }
 
+        operator token() const { return type; }
+
         killer( void* ptr, void (*fn_destroy)(void*), const token& type, const char* file, int line, bool invisible )
             : ptr(ptr), fn_destroy(fn_destroy), type_name(type.ptr()), file(file), line(line), type(type), invisible(invisible)
         {
@@ -101,6 +104,9 @@ public:
         last = 0;
         count = 0;
         shutting_down = false;
+
+        //not released in destructor, same as the singletons themselves
+        visible = new visible_t;
     }
 
     void* find_or_add_singleton(
@@ -110,19 +116,34 @@ public:
         const token& type, const char* file, int line, bool invisible )
     {
         RASSERT( !shutting_down );
+
+        //look for singletons registered in different module, without locking
+        void* ptr = 0;
+        if(!invisible && visible->find(type, [&ptr](killer* const& k) { ptr = k->ptr; })) {
+            if(initmod)
+                initmod(ptr);
+
+            _t_creator_key.set(0);
+            return ptr;
+        }
+
         comm_mutex_guard<_comm_mutex> mxg(mx);
 
-        //look for singletons registered in different module
-        killer* k = invisible ? 0 : last;
-        while(k && (k->invisible || k->type != type))
-            k = k->next;
+        killer* k = 0;
+        if(!invisible)
+            visible->find(type, [&k](killer* const& v) { k = v; });
 
         if(!k) {
+            //singletons outlive any scope_arena installed by the creating thread
+            shared_mspace_guard shared;
             k = new killer(create(), destroy, type, file, line, invisible);
             k->next = last;
 
             last = k;
             ++count;
+
+            if(!invisible)
+                visible->insert_value(k);
         }
         else if(initmod)
             initmod(k->ptr);
@@ -141,8 +162,15 @@ public:
                 killer* tmp = *pkill;
                 *pkill = tmp->next;
 
+                //unpublish first so that lookups can't hand out the destroyed object
+                bool published = !tmp->invisible && visible->erase(tmp->type);
+
                 tmp->destroy();
-                delete tmp;
+
+                if (published)
+                    visible->retire(tmp, [](void* k) { delete static_cast<killer*>(k); });
+                else
+                    delete tmp;
                 return;
             }
 
@@ -192,6 +220,11 @@ private:
     _comm_mutex mx;
     killer* last;
 
+    typedef concurrent_keyset<killer*, _Select_CopyPtr<killer, token>> visible_t;
+
+    ///Visible singletons by type
+    visible_t* visible;
+
     uint count;
 
     bool shutting_down;
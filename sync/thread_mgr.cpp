@@ -75,11 +75,13 @@ namespace coid {
 void thread_manager::thread_name(thread_t tid, const token& name)
 {
     GUARDME;
-    info* const* pti = _hash.find_value(tid);
-    if (pti && (*pti)->name != name) {
-        (*pti)->name = name;
-        set_thread_name(*pti);
-    }
+    shared_mspace_guard shared;
+    _hash.find(tid, [&name](info* const& ti) {
+        if (ti->name != name) {
+            ti->name = name;
+            set_thread_name(ti);
+        }
+    });
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -93,7 +95,11 @@ thread thread_manager::thread_start(thread_manager::info* ti)
     pthread_create(&tid, 0, thread_manager::def_thread, ti);
 #endif
 
+    //register here so that the thread is known (and can be joined) as soon as this returns
+    GUARDME;
     ti->tid = tid;
+    _hash.insert_value(ti);
+
     return tid;
 }
 
@@ -111,7 +117,7 @@ void* thread_manager::def_thread(void* pinfo)
     while (ti->tid == thread::invalid())
         sysMilliSecondSleep(0);
 
-    ti->mgr->thread_register(ti);
+    ti->mgr->_pkey.set(ti);
 
     //invoke begin callback
     if (ti->mgr->_cbk_begin)
@@ -150,8 +156,7 @@ void* thread_manager::def_thread(void* pinfo)
     if (ti->mgr->_cbk_end)
         ti->mgr->_cbk_end();
 
-    ti->mgr->thread_unregister(ti->tid);
-    delete ti;
+    ti->mgr->thread_unregister(ti);
 
     return res;
 }
@@ -39,7 +39,7 @@
 #define __COID_COMM_SYNC_THREADMGR__HEADER_FILE__
 
 #include "../pthreadx.h"
-#include "../hash/hashkeyset.h"
+#include "../hash/concurrent_keyset.h"
 #include "mutex.h"
 
 COID_NAMESPACE_BEGIN
@@ -79,23 +79,22 @@ public:
         if( tid.is_invalid() )
             return 0;
 
-        GUARDME;
-        info*const* pti = _hash.find_value(tid);
-        return pti ? (*pti)->context : 0;
+        void* context = 0;
+        _hash.find(tid, [&context](info* const& ti) { context = ti->context; });
+        return context;
     }
 
     ///Access context value under lock preventing the context corruption
+    //@note the lock also keeps the thread from unregistering while fnc_extract runs
     opcd access_context_value( thread tid, void* val, void (*fnc_extract)(void*, void*) )
     {
         if( tid.is_invalid() )
             return ersNOT_FOUND "thread id";
 
         GUARDME;
-        info*const* pti = _hash.find_value(tid);
-        if(pti)
-            fnc_extract( val, (*pti)->context );
+        bool found = _hash.find(tid, [&](info* const& ti) { fnc_extract(val, ti->context); });
 
-        return pti ? opcd(0) : ersIMPROPER_STATE;
+        return found ? opcd(0) : ersIMPROPER_STATE;
     }
 
     typedef void (*thread_beginend_callback)();
@@ -115,7 +114,10 @@ public:
         i->tid = thread::invalid();
         i->cancel = 0;
 
-        i->name = name;
+        {
+            shared_mspace_guard shared;
+            i->name = name;
+        }
         i->mgr = this;
 
         return thread_start(i);
@@ -123,40 +125,32 @@ public:
 
     bool thread_exists( thread_t tid ) const
     {
-        GUARDME;
-        return 0 != _hash.find_value(tid);
+        return _hash.find(tid, [](info* const&) {});
     }
 
+    ///Thread name, locked against concurrent renaming
     token thread_name( thread_t tid ) const
     {
         GUARDME;
-        info*const* pti = _hash.find_value(tid);
-        if(pti)
-            return (*pti)->name;
-
-        return token();
+        token name;
+        _hash.find(tid, [&name](info* const& ti) { name = ti->name; });
+        return name;
     }
 
     void thread_name( thread_t tid, const token& name );
 
     opcd request_cancellation( thread_t tid )
     {
-        GUARDME;
-        info*const* pti = _hash.find_value(tid);
-        if(pti)
-        {
-            (*pti)->cancel = 1;
-            return 0;
-        }
+        bool found = _hash.find(tid, [](info* const& ti) { ti->cancel = 1; });
 
-        return ersINVALID_PARAMS;
+        return found ? opcd(0) : ersINVALID_PARAMS;
     }
 
     bool test_cancellation( thread_t tid )
     {
-        GUARDME;
-        info*const* pti = _hash.find_value(tid);
-        return  pti && (*pti)->cancel;
+        bool cancel = false;
+        _hash.find(tid, [&cancel](info* const& ti) { cancel = ti->cancel != 0; });
+        return cancel;
     }
 
     const info * tls_info()
@@ -174,30 +168,25 @@ public:
 
 protected:
 
-    ///Map from thread_t to thread_info
-    typedef hash_keyset<info*,_Select_CopyPtr<info,thread_t> >     t_hash;
+    ///Map from thread_t to thread_info, lookups don't lock
+    typedef concurrent_keyset<info*,_Select_CopyPtr<info,thread_t> >     t_hash;
 
     t_hash          _hash;
     thread_key      _pkey;
 
-    mutable comm_mutex  _mutex;
+    mutable comm_mutex  _mutex;         //< serializes registration, names and context access
 
     thread_beginend_callback _cbk_begin, _cbk_end;
 
 
     thread thread_start( info* );
 
-    void thread_register( info* i )
-    {
-        GUARDME;
-        _hash.insert_value(i);
-        _pkey.set(i);
-    }
-
-    void thread_unregister( thread_t tid )
+    ///Remove thread from the map and delete its info once no reader can access it
+    void thread_unregister( info* ti )
     {
         GUARDME;
-        _hash.erase(tid);
+        _hash.erase(ti->tid);
+        _hash.retire(ti, [](void* p) { delete static_cast<info*>(p); });
     }
 
 
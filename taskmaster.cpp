@@ -1,18 +1,34 @@
 #include "net_ul.h"
 #include "profiler/profiler.h"
 #include "taskmaster.h"
+#include "timer.h"
+#include <algorithm>
 
 COID_NAMESPACE_BEGIN
 
 const taskmaster::signal_handle taskmaster::invalid_signal = taskmaster::signal_handle(taskmaster::signal_handle::invalid); 
 
-taskmaster::taskmaster(uint nthreads, uint nlowprio_threads)
+//@return NUMA node of given processor
+static int processor_node(uint cpu, uint nnodes)
+{
+    for (uint n = 0; n < nnodes; ++n) {
+        if (cpu < 64 && (thread::numa_node_mask(n) & ((uint64)1 << cpu)))
+            return int(n);
+    }
+    return 0;
+}
+
+taskmaster::taskmaster(uint nthreads, uint nlowprio_threads, EScheduler scheduler, EAffinity affinity)
     : _qsize(0)
     , _hqsize(0)
+    , _nsleeping(0)
     , _quitting(false)
+    , _scheduler(scheduler)
     , _nlowprio_threads(nlowprio_threads)
 {
     _taskdata.reserve_virtual(8192 * 16);
+    for (std::atomic_int& n : _npending)
+        n = 0;
     _signal_pool.resize(4096);
     _free_signals.reserve(4096);
     for (uint i = 0; i < _signal_pool.size(); ++i) {
@@ -20,10 +36,32 @@ taskmaster::taskmaster(uint nthreads, uint nlowprio_threads)
         _free_signals.push(signal_handle(i));
     }
 
+    const uint nnodes = affinity == EAffinity::NONE ? 1 : thread::numa_node_count();
+    _nodes.alloc(nnodes);
+
     _threads.alloc(nthreads);
     _threads.for_each([&](threadinfo& ti, uints id) {
         ti.order = uint(id);
         ti.master = this;
+        ti.rnd.seed(uint(id) + 1);
+
+        switch (affinity) {
+        case EAffinity::CORE:
+            ti.node = processor_node(uint(id), nnodes);
+            ti.affinity = (uint64)1 << id;
+            break;
+        case EAffinity::NUMA_NODE:
+            ti.node = int(id % nnodes);
+            ti.affinity = thread::numa_node_mask(ti.node);
+            break;
+        default:
+            ti.node = 0;
+            ti.affinity = 0;
+        }
+        });
+
+    //start only after all workers are set up, they look at each other when stealing
+    _threads.for_each([&](threadinfo& ti) {
         ti.tid.create(threadfunc, &ti, 0, "taskmaster");
         });
 }
@@ -34,28 +72,255 @@ taskmaster::~taskmaster() {
 
 void taskmaster::wait() {
     CPU_PROFILE_SCOPE_COLOR("taskmaster::wait", 0x80, 0, 0);
-    std::unique_lock<std::mutex> lock(_sync);
-    if (get_order() < _nlowprio_threads) {
-        while (!_qsize) // handle spurious wake-ups
-            _cv.wait(lock);
+    threadinfo* ti = get_threadinfo();
+    const uint64 t0 = nsec_timer::current_time_ns();
+    {
+        std::unique_lock<std::mutex> lock(_sync);
+        const std::atomic_int& qsize = ti->order < _nlowprio_threads ? _qsize : _hqsize;
+
+        //announce before checking the counters, pairs with the check in enqueue
+        ++_nsleeping;
+        while (!qsize) { // handle spurious wake-ups
+            ti->sleeping = true;
+            ti->cv.wait(lock);
+        }
+        ti->sleeping = false;
+        --_nsleeping;
+    }
+    ti->idle_ns.fetch_add(nsec_timer::current_time_ns() - t0, std::memory_order_relaxed);
+}
+
+void taskmaster::enqueue(std::unique_lock<std::mutex>& lock, EPriority priority, const affinity_hint& hint, granule* first, uints stride, uints n)
+{
+    const bool low = priority == EPriority::LOW;
+    threadinfo* ti = get_threadinfo();
+    if (ti && ti->master != this)
+        ti = 0;
+
+    auto task = [first, stride](uints i) {
+        return (invoker_base*)(first + i * stride);
+    };
+
+    //preferred worker that can't run the priority falls back to its node
+    affinity_hint target = hint;
+    if (target.worker >= 0) {
+        if (uint(target.worker) >= _threads.size())
+            target.worker = -1;
+        else if (low && target.worker >= _nlowprio_threads) {
+            target.node = _threads[target.worker].node;
+            target.worker = -1;
+        }
+    }
+    if (target.node >= 0 && uint(target.node) >= _nodes.size())
+        target.node = -1;
+
+    if (target.is_any() && ti && _scheduler == EScheduler::WORK_STEALING && (!low || ti->order < _nlowprio_threads)) {
+        //owner push into own deque, no need to hold the lock
+        if (lock.owns_lock())
+            lock.unlock();
+
+        //count first so that a thief can't drive the counter negative
+        _qsize += int(n);
+        if (!low) _hqsize += int(n);
+        _npending[(int)priority] += int(n);
+
+        for (uints i = 0; i < n; ++i)
+            ti->local[(int)priority].push(task(i));
+
+        //prefer waking workers of the same node
+        target.node = ti->node;
     }
     else {
-        while (!_hqsize) // handle spurious wake-ups
-            _hcv.wait(lock);
+        //the queues are lock-free, the lock is needed only to wake sleepers
+        atomic::queue<invoker_base*>& q = target.worker >= 0
+            ? _threads[target.worker].mailbox[(int)priority]
+            : target.node >= 0
+                ? _nodes[target.node].ready[(int)priority]
+                : _ready_jobs[(int)priority];
+
+        //counted before the push so that poppers never skip a non-empty priority
+        _npending[(int)priority] += int(n);
+
+        for (uints i = 0; i < n; ++i)
+            q.push(task(i));
+
+        _qsize += int(n);
+        if (!low) _hqsize += int(n);
+    }
+
+    //sleepers registered before checking the counters, so either they see the new count
+    // or we see them here; locking ensures they are already blocked in wait before notify
+    if (_nsleeping == 0) {
+        if (lock.owns_lock())
+            lock.unlock();
+        return;
+    }
+
+    if (!lock.owns_lock())
+        lock.lock();
+    wake(lock, priority, n, target);
+}
+
+void taskmaster::wake(std::unique_lock<std::mutex>& lock, EPriority priority, uints n, const affinity_hint& hint)
+{
+    const bool low = priority == EPriority::LOW;
+    auto can_wake = [&](const threadinfo& t) {
+        return t.sleeping && (!low || t.order < _nlowprio_threads);
+    };
+    auto notify = [&](threadinfo& t) {
+        //cleared here so that the worker isn't picked twice, wait() sets it again when going back to sleep
+        t.sleeping = false;
+        t.cv.notify_one();
+        --n;
+    };
+
+    int node = hint.node;
+
+    if (hint.worker >= 0) {
+        threadinfo& t = _threads[hint.worker];
+        if (can_wake(t))
+            notify(t);
+
+        if (n == 0) {
+            lock.unlock();
+            return;
+        }
+
+        //preferred worker is busy or has more tasks than it can run at once, wake sleepers
+        // that can steal them, preferably on its node
+        node = t.node;
+    }
+
+    if (node >= 0) {
+        bool node_can_run = false;
+        bool woken = false;
+        for (uints i = 0; i < _threads.size() && n > 0; ++i) {
+            threadinfo& t = _threads[i];
+            if (t.node != node || (low && t.order >= _nlowprio_threads))
+                continue;
+
+            node_can_run = true;
+            if (t.sleeping) {
+                notify(t);
+                woken = true;
+            }
+        }
+
+        //busy workers of a preferred node get to its tasks later, tasks of a busy worker go to anyone
+        if (woken || (node_can_run && hint.worker < 0)) {
+            lock.unlock();
+            return;
+        }
+    }
+
+    for (uints i = 0; i < _threads.size() && n > 0; ++i) {
+        threadinfo& t = _threads[i];
+        if (can_wake(t))
+            notify(t);
     }
+
+    lock.unlock();
+}
+
+taskmaster::invoker_base* taskmaster::pop_task(int order)
+{
+    const bool can_run_low = order != -1 && order < _nlowprio_threads;
+    threadinfo* ti = order != -1 ? get_threadinfo() : 0;
+    if (ti && ti->master != this)
+        ti = 0;
+
+    const bool ws = _scheduler == EScheduler::WORK_STEALING;
+    invoker_base* task = 0;
+
+    for (int prio = 0; prio < (int)EPriority::COUNT; ++prio) {
+        if (prio == (int)EPriority::LOW && !can_run_low)
+            continue;
+
+        //skip probing the queues and stealing for empty priorities
+        if (_npending[prio].load(std::memory_order_relaxed) <= 0)
+            continue;
+
+        bool found = ti
+            ? ti->mailbox[prio].pop(task)
+                || (ws && ti->local[prio].pop(task))
+                || _nodes[ti->node].ready[prio].pop(task)
+                || _ready_jobs[prio].pop(task)
+            : _ready_jobs[prio].pop(task);
+
+        if (!found && (task = steal_task(ti, prio)) != 0) {
+            found = true;
+            if (ti)
+                ti->nsteals.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (found) {
+            --_npending[prio];
+            --_qsize;
+            if (prio != (int)EPriority::LOW) --_hqsize;
+            return task;
+        }
+    }
+
+    return 0;
+}
+
+taskmaster::invoker_base* taskmaster::steal_task(threadinfo* self, int prio)
+{
+    invoker_base* task = 0;
+    const uint n = uint(_threads.size());
+
+    //LOW tasks only sit in deques and mailboxes of low prio workers
+    const uint nvictims = prio == (int)EPriority::LOW ? uint(_nlowprio_threads) : n;
+
+    if (self && nvictims > 1) {
+        const bool ws = _scheduler == EScheduler::WORK_STEALING;
+        const uint start = self->rnd.rand() % nvictims;
+
+        //workers of the same node first
+        for (int pass = 0; pass < 2; ++pass) {
+            for (uint i = 0; i < nvictims; ++i) {
+                threadinfo& victim = _threads[(start + i) % nvictims];
+                if (&victim == self || (victim.node == self->node) != (pass == 0))
+                    continue;
+
+                if ((ws && victim.local[prio].steal(task)) || victim.mailbox[prio].pop(task))
+                    return task;
+            }
+        }
+    }
+
+    //other nodes' queues
+    const uint nnodes = uint(_nodes.size());
+    for (uint i = 0; i < nnodes; ++i) {
+        if (self && int(i) == self->node)
+            continue;
+
+        if (_nodes[i].ready[prio].pop(task))
+            return task;
+    }
+
+    return 0;
 }
 
 void taskmaster::run_task(invoker_base* task)
 {
     CPU_PROFILE_FUNCTION();
+    threadinfo* ti = get_threadinfo();
+    if (ti && ti->master == this) {
+        //only the owner writes the counter
+        ti->ntasks.store(ti->ntasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+#ifdef _DEBUG
+    //slotalloc_atomic looks the id up by walking its pages
     uints id = _taskdata.get_item_id((granule*)task);
     //coidlog_devdbg("taskmaster", "thread " << order << " processing task id " << id);
 
-#ifdef _DEBUG
     thread::set_name("<unknown task>"_T);
-#endif
 
     DASSERT_RET(_taskdata.is_valid_id(id));
+#endif
+
     task->invoke();
 
 #ifdef _DEBUG
@@ -63,25 +328,67 @@ void taskmaster::run_task(invoker_base* task)
 #endif
 
     const signal_handle handle = task->signal();
-    if (handle.is_valid()) {
+    const uints size = task->size();
+    task->destroy();
+
+    if (handle.is_valid())
+        decrement(handle);
+
+    free_task((granule*)task, size);
+}
+
+void taskmaster::decrement(signal_handle handle)
+{
+    signal& s = _signal_pool[handle.index()];
+
+    //only the last reference needs the lock
+    if (atomic::dec(&s.ref) > 0)
+        return;
+
+    dynarray<continuation> ready;
+    {
         std::unique_lock<std::mutex> lock(_signal_sync);
-        signal& s = _signal_pool[handle.index()];
-        --s.ref;
-        if (s.ref == 0) {
+
+        //increment could have added references meanwhile, or another thread that dropped
+        // the counter to zero after that has already released the signal
+        if (s.ref == 0 && s.version == handle.version()) {
             s.version = (s.version + 1) % 0xffFF;
             signal_handle free_handle = signal_handle::make(s.version, handle.index());
             _free_signals.push(free_handle);
+
+            if (s.waiting.size())
+                ready.swap(s.waiting);
         }
     }
 
-    _taskdata.del_range((granule*)task, align_to_chunks(task->size(), sizeof(granule)));
+    for (const continuation& c : ready) {
+        std::unique_lock<std::mutex> lock(_sync);
+        enqueue(lock, c.priority, c.task);
+    }
+}
+
+bool taskmaster::add_continuation(signal_handle handle, EPriority priority, invoker_base* task)
+{
+    if (!handle.is_valid())
+        return false;
+
+    std::unique_lock<std::mutex> lock(_signal_sync);
+    if (is_signaled(handle, false))
+        return false;
+
+    continuation* c = _signal_pool[handle.index()].waiting.add();
+    c->task = task;
+    c->priority = priority;
+    return true;
 }
 
 void* taskmaster::threadfunc( int order )
 {
     get_order() = order;
+    get_threadinfo() = &_threads[order];
 
-    thread::set_affinity_mask((uint64)1 << order);
+    if (_threads[order].affinity)
+        thread::set_affinity_mask(_threads[order].affinity);
     coidlog_info("taskmaster", "thread " << order << " running");
     char tmp[64];
     sprintf_s(tmp, "taskmaster %d", order);
@@ -90,19 +397,9 @@ void* taskmaster::threadfunc( int order )
     wait();
     while (!_quitting) {
         // TODO there are 3 locks here: wait, _ready_jobs.pop and lock(_sync), they can be merged into one
-        invoker_base* task = 0;
-        for (int prio = 0; prio < (int)EPriority::COUNT; ++prio) {
-            const bool can_run = prio != (int)EPriority::LOW || order < _nlowprio_threads || order == -1;
-            if (can_run && _ready_jobs[prio].pop(task)) {
-                {
-                    std::unique_lock<std::mutex> lock(_sync);
-                    --_qsize;
-                    if (prio != (int)EPriority::LOW) --_hqsize;
-                }
-                run_task(task);
-                break;
-            }
-        }
+        invoker_base* task = pop_task(order);
+        if (task)
+            run_task(task);
         wait();
     }
 
@@ -126,18 +423,18 @@ bool taskmaster::is_signaled(signal_handle handle, bool lock)
     return version != handle.version() || ref == 0;
 }
 
-taskmaster::signal_handle taskmaster::alloc_signal()
+taskmaster::signal_handle taskmaster::alloc_signal(int ref)
 {
     signal_handle handle;
     if (!_free_signals.pop(handle)) return invalid_signal;
 
     signal& s = _signal_pool[handle.index()];
-    s.ref = 1;
+    s.ref = ref;
 
     return handle;
 }
 
-void taskmaster::increment(signal_handle* handle)
+void taskmaster::increment(signal_handle* handle, int count)
 {
     std::unique_lock<std::mutex> lock(_signal_sync);
     if (!handle) return;
@@ -145,51 +442,61 @@ void taskmaster::increment(signal_handle* handle)
     if (handle->is_valid()) {
         signal& s = _signal_pool[handle->index()];
         if (is_signaled(*handle, false)) {
-            *handle = alloc_signal();
+            *handle = alloc_signal(count);
         }
         else {
-            ++s.ref;
+            //decrement drops references without the lock
+            atomic::add(&s.ref, count);
         }
     }
     else {
-        *handle = alloc_signal();
+        *handle = alloc_signal(count);
     }
 }
 
 void taskmaster::notify_all() {
-    {
-        std::unique_lock<std::mutex> lock(_sync);
-        _qsize += (int)_threads.size();
-        _hqsize += (int)_threads.size();
+    std::unique_lock<std::mutex> lock(_sync);
+    _qsize += (int)_threads.size();
+    _hqsize += (int)_threads.size();
+
+    for (threadinfo& ti : _threads)
+        ti.cv.notify_one();
+}
+
+taskmaster::worker_stats taskmaster::get_worker_stats(uint worker) const
+{
+    worker_stats stats = {};
+    DASSERT_RET(worker < _threads.size(), stats);
+
+    const threadinfo& ti = _threads[worker];
+    stats.ntasks = ti.ntasks.load(std::memory_order_relaxed);
+    stats.nsteals = ti.nsteals.load(std::memory_order_relaxed);
+    stats.idle_ns = ti.idle_ns.load(std::memory_order_relaxed);
+    stats.node = ti.node;
+    return stats;
+}
+
+void taskmaster::reset_worker_stats()
+{
+    for (threadinfo& ti : _threads) {
+        ti.ntasks.store(0, std::memory_order_relaxed);
+        ti.nsteals.store(0, std::memory_order_relaxed);
+        ti.idle_ns.store(0, std::memory_order_relaxed);
     }
-    _cv.notify_all();
-    _hcv.notify_all();
 }
 
 void taskmaster::enter_critical_section(critical_section& critical_section, int spin_count)
 {
     for (;;) {
         for (int i = 0; i < spin_count; ++i) {
-            if (critical_section.value == 0 && atomic::cas(&critical_section.value, 1, 0) == 0) {
+            if (try_enter_critical_section(critical_section))
                 return;
-            }
         }
 
-        invoker_base* task = 0;
-        const int order = get_order();
-        for (int prio = 0; prio < (int)EPriority::COUNT; ++prio) {
-            const bool can_run = prio != (int)EPriority::LOW || (order < _nlowprio_threads && order != -1);
-            if (can_run && _ready_jobs[prio].pop(task)) {
-                {
-                    std::unique_lock<std::mutex> lock(_sync);
-                    --_qsize;
-                    if (prio != (int)EPriority::LOW) --_hqsize;
-                }
-                run_task(task);
-                break;
-            }
-        }
-        if (!task)
+        invoker_base* task = pop_task(get_order());
+        if (task)
+            run_task(task);
+        else
             thread::wait(0);
     }
 }
@@ -197,7 +504,23 @@ void taskmaster::enter_critical_section(critical_section& critical_section, int
 void taskmaster::leave_critical_section(critical_section& critical_section)
 {
     const int32 prev = atomic::cas(&critical_section.value, 0, 1);
-    DASSERTN(prev == 1);
+    if (prev == 1)
+        return;
+
+    DASSERTN(prev == 2);
+
+    //coroutines parked, the first one gets the section without leaving it
+    std::unique_lock<std::mutex> lock(_section_sync);
+    section_waiter* w = critical_section.parked;
+    critical_section.parked = w->next;
+    if (!critical_section.parked) {
+        critical_section.parked_last = 0;
+        atomic::cas(&critical_section.value, 1, 2);
+    }
+    lock.unlock();
+
+    std::unique_lock<std::mutex> sync(_sync, std::defer_lock);
+    enqueue(sync, w->priority, w);
 }
 
 
@@ -207,20 +530,10 @@ void taskmaster::wait(signal_handle signal)
 
     const int order = get_order();
     while (!is_signaled(signal, true)) {
-        invoker_base* task = 0;
-        for (int prio = 0; prio < (int)EPriority::COUNT; ++prio) {
-            const bool can_run = prio != (int)EPriority::LOW || (order < _nlowprio_threads&& order != -1);
-            if (can_run && _ready_jobs[prio].pop(task)) {
-                {
-                    std::unique_lock<std::mutex> lock(_sync);
-                    --_qsize;
-                    if (prio != (int)EPriority::LOW) --_hqsize;
-                }
-                run_task(task);
-                break;
-            }
-        }
-        if (!task)
+        invoker_base* task = pop_task(order);
+        if (task)
+            run_task(task);
+        else
             thread::wait(0);
     }
 }
@@ -257,15 +570,161 @@ taskmaster::signal_handle taskmaster::create_signal()
 
 void taskmaster::trigger_signal(signal_handle handle)
 {
-    std::unique_lock<std::mutex> lock(_signal_sync);
+    decrement(handle);
+}
 
-    signal& s = _signal_pool[handle.index()];
-    --s.ref;
-    if (s.ref == 0) {
-        s.version = (s.version + 1) % 0xffFF;
-        signal_handle free_handle = signal_handle::make(s.version, handle.index());
-        _free_signals.push(free_handle);
+void taskmaster::push_graph(task_graph& graph, signal_handle* signal)
+{
+    DASSERT_RET(!graph._signal.is_valid() || is_signaled(graph._signal, true));
+
+    //hold an extra reference until all root nodes are queued, so that the signal can't get released early
+    graph._signal = invalid_signal;
+    increment(&graph._signal);
+
+    const uint n = uint(graph._nodes.size());
+    for (uint i = 0; i < n; ++i) {
+        task_graph::node& node = graph._nodes[i];
+        node.pending = node.npred + int(node.signals.size());
+    }
+
+    for (uint i = 0; i < n; ++i) {
+        task_graph::node& node = graph._nodes[i];
+
+        if (node.npred == 0 && node.signals.size() == 0) {
+            schedule_node(graph, i);
+            continue;
+        }
+
+        for (const signal_handle* sig : node.signals) {
+            push_after(*sig, node.priority, &graph._signal, [this, &graph, i]() {
+                release_node(graph, i);
+            });
+        }
     }
+
+    if (signal)
+        push_after(graph._signal, EPriority::HIGH, signal, []() {});
+
+    decrement(graph._signal);
+}
+
+void taskmaster::schedule_node(task_graph& graph, uint id)
+{
+    push(graph._nodes[id].priority, &graph._signal, [this, &graph, id]() {
+        run_node(graph, id);
+    });
+}
+
+void taskmaster::release_node(task_graph& graph, uint id)
+{
+    if (atomic::dec(&graph._nodes[id].pending) == 0)
+        schedule_node(graph, id);
+}
+
+void taskmaster::run_node(task_graph& graph, uint id)
+{
+    task_graph::node& node = graph._nodes[id];
+
+    node.start_ns = nsec_timer::current_time_ns();
+    node.work->invoke();
+    node.end_ns = nsec_timer::current_time_ns();
+
+    //successors are queued before this task releases the graph signal
+    for (task_graph::node_id succ : node.successors)
+        release_node(graph, succ);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void taskmaster::task_graph::precede(node_id before, node_id after)
+{
+    DASSERT_RET(before < _nodes.size() && after < _nodes.size() && before != after);
+
+    *_nodes[before].successors.add() = after;
+    ++_nodes[after].npred;
+}
+
+void taskmaster::task_graph::depend(node_id node, const signal_handle* signal)
+{
+    DASSERT_RET(node < _nodes.size() && signal);
+
+    *_nodes[node].signals.add() = signal;
+}
+
+void taskmaster::task_graph::clear()
+{
+    for (node& n : _nodes) {
+        n.work->destroy();
+        ::operator delete(n.work);
+    }
+    _nodes.reset();
+}
+
+uint64 taskmaster::task_graph::critical_path(dynarray<node_id>& path) const
+{
+    path.reset();
+
+    const uint n = uint(_nodes.size());
+    if (n == 0)
+        return 0;
+
+    dynarray<uint64> start;
+    dynarray<uint64> finish;
+    dynarray<node_id> prev;
+    dynarray<int> npred;
+    dynarray<node_id> order;
+    start.calloc(n);
+    finish.calloc(n);
+    prev.calloc(n, true);
+    npred.alloc(n);
+    order.reserve(n, false);
+
+    for (uint i = 0; i < n; ++i) {
+        npred[i] = _nodes[i].npred;
+        if (npred[i] == 0)
+            order.push(i);
+    }
+
+    //longest path in topological order, start[] holds the max finish time of predecessors
+    node_id last = order.size() ? order[0] : 0;
+    for (uints k = 0; k < order.size(); ++k) {
+        const node_id i = order[k];
+        const node& nd = _nodes[i];
+
+        finish[i] = start[i] + (nd.end_ns - nd.start_ns);
+        if (finish[i] > finish[last])
+            last = i;
+
+        for (node_id s : nd.successors) {
+            if (prev[s] == UMAX32 || finish[i] > start[s]) {
+                start[s] = finish[i];
+                prev[s] = i;
+            }
+            if (--npred[s] == 0)
+                order.push(s);
+        }
+    }
+
+    DASSERT(order.size() == n);     //cycle in the graph
+
+    for (node_id i = last; i != UMAX32; i = prev[i])
+        path.push(i);
+
+    std::reverse(path.begin(), path.end());
+    return finish[last];
+}
+
+charstr& taskmaster::task_graph::dump_critical_path(charstr& dst) const
+{
+    dynarray<node_id> path;
+    uint64 total = critical_path(path);
+
+    dst << "critical path " << (total / 1000) << "us:\n";
+    for (node_id i : path) {
+        const node& nd = _nodes[i];
+        dst << "  " << i << " " << nd.name << " " << ((nd.end_ns - nd.start_ns) / 1000) << "us\n";
+    }
+
+    return dst;
 }
 
 
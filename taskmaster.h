@@ -42,12 +42,22 @@
 #include "trait.h"
 #include "alloc/slotalloc.h"
 #include "bitrange.h"
-#include "sync/queue.h"
+#include "atomic/queue.h"
+#include "atomic/ws_deque.h"
+#include "rnd.h"
 #include "pthreadx.h"
 #include "log/logger.h"
 #include <mutex>
 #include <condition_variable>
 
+#if defined(__cpp_impl_coroutine)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <optional>
+#define COID_TASKMASTER_COROUTINES 1
+#endif
+#endif
+
 COID_NAMESPACE_BEGIN
 
 /**
@@ -59,6 +69,21 @@ COID_NAMESPACE_BEGIN
 
     When a thread is waiting for a signal it processes other tasks in queue.
 
+    In the work stealing mode each worker thread owns a set of lock-free deques (one per priority).
+    Tasks pushed from within a worker go to its own deques, tasks pushed from other threads go to
+    the shared queues. An idle worker first pops from its own deques (LIFO), then from the shared
+    queues and finally steals (FIFO) from randomly chosen other workers.
+
+    Workers can be pinned to cores or to NUMA nodes, workers on the same node form a pool with its
+    own queues. A task can be pushed with an affinity hint naming the preferred node or worker; the
+    preferred workers are woken up and take such tasks first, but an idle worker elsewhere can still
+    take them after it runs out of other work.
+
+    When compiled as C++20, tasks can also be coroutines (co_task) that co_await signals, critical
+    sections or child coroutines. Instead of processing other tasks on the waiting thread's stack,
+    a suspended coroutine returns the worker to the scheduler and its frame is queued again once
+    the awaited condition is met.
+
     Basic usage:
         coid::taskmaster::signal_handle signal;
         for (int i = 0; i < 10; ++i) {
@@ -68,10 +93,15 @@ COID_NAMESPACE_BEGIN
 **/
 class taskmaster
 {
+protected:
+    struct section_waiter;
+
 public:
     struct critical_section
     {
-        volatile int32 value = 0;
+        volatile int32 value = 0;               //< 0 free, 1 entered, 2 entered with coroutines parked on it
+        section_waiter* parked = 0;             //< coroutines waiting to enter in order of arrival, guarded by _section_sync
+        section_waiter* parked_last = 0;
     };
 
     struct signal_handle
@@ -97,6 +127,8 @@ public:
 
     static const signal_handle invalid_signal;
 
+    class task_graph;
+
     enum class EPriority {
         HIGH,
         NORMAL,
@@ -105,28 +137,191 @@ public:
         COUNT
     };
 
+    enum class EScheduler {
+        SHARED_QUEUE,                   //< all tasks go through shared queues
+        WORK_STEALING,                  //< per-worker deques with stealing, see class notes
+    };
+
+    enum class EAffinity {
+        NONE,                           //< workers are not pinned, single pool
+        CORE,                           //< worker i pinned to logical processor i, pools by NUMA node of the processor
+        NUMA_NODE,                      //< workers distributed round-robin over NUMA nodes and pinned to node's processors
+    };
+
+    ///Preferred placement of a pushed task
+    struct affinity_hint
+    {
+        int node = -1;                  //< preferred NUMA node pool, -1 any
+        int worker = -1;                //< preferred worker, -1 any
+
+        static affinity_hint numa_node(int node) { affinity_hint h; h.node = node; return h; }
+        static affinity_hint worker_thread(int worker) { affinity_hint h; h.worker = worker; return h; }
+
+        bool is_any() const { return node < 0 && worker < 0; }
+    };
+
+    ///Worker statistics since creation or the last reset
+    struct worker_stats
+    {
+        uint64 ntasks;                  //< number of tasks run
+        uint64 nsteals;                 //< tasks taken from other workers or other nodes' queues
+        uint64 idle_ns;                 //< time spent sleeping while waiting for tasks
+        int node;                       //< NUMA node pool of the worker
+    };
+
     //@param nthreads total number of job threads to spawn
     //@param nlong_threads number of low-prio job threads (<= nthreads)
-    taskmaster(uint nthreads, uint nlowprio_threads);
+    //@param scheduler scheduling mode
+    //@param affinity worker placement
+    taskmaster(uint nthreads, uint nlowprio_threads, EScheduler scheduler = EScheduler::SHARED_QUEUE, EAffinity affinity = EAffinity::CORE);
 
     ~taskmaster();
 
     uints get_workers_count() const { return _threads.size(); }
 
+    //@return number of NUMA node pools
+    uints get_node_count() const { return _nodes.size(); }
+
+    //@return statistics of given worker
+    worker_stats get_worker_stats(uint worker) const;
+
+    ///Reset statistics of all workers
+    void reset_worker_stats();
+
     ///Run fn(index) in parallel in task level 0
     //@param first begin index value
     //@param last end index value
     //@param fn function(index) to run
     template <typename Index, typename Fn>
     void parallel_for(Index first, Index last, const Fn& fn) {
+        parallel_for(first, last, 0, fn);
+    }
+
+    ///Run fn(index) in parallel over chunks of the range
+    //@param first begin index value
+    //@param last end index value
+    //@param grain max number of indices processed by a single task, 0 to pick one from the worker count
+    //@param fn function(index) to run
+    //@note the range is split recursively in halves until the chunks are <= grain, the calling thread
+    // processes the first chunk itself
+    template <typename Index, typename Fn>
+    void parallel_for(Index first, Index last, uints grain, const Fn& fn) {
+        parallel_for_range(first, last, grain, [&fn](Index b, Index e) {
+            for (; b != e; ++b)
+                fn(b);
+        });
+    }
+
+    ///Run fn(first, last) in parallel on contiguous subranges of the range
+    //@param grain max size of the subrange passed to fn, 0 to pick one from the worker count
+    //@param fn function(Index first, Index last) to run
+    template <typename Index, typename Fn>
+    void parallel_for_range(Index first, Index last, uints grain, const Fn& fn) {
+        if (!(first < last))
+            return;
+
+        if (grain == 0)
+            grain = default_grain(uints(last - first));
+
         signal_handle signal;
-        for (; first != last; ++first) {
-            push(EPriority::HIGH, &signal, fn, first);
-        }
+        split_range(&signal, first, last, grain, fn);
 
         wait(signal);
     }
 
+    ///Parallel reduction over a range
+    //@param grain max number of indices reduced by a single task, 0 to pick one from the worker count
+    //@param identity identity value of the reduction
+    //@param fn function T(Index first, Index last, T init) that accumulates the subrange onto init
+    //@param reduce function T(const T& a, const T& b) combining two partial results
+    //@return reduced value
+    //@note partial results are combined in index order, so reduce needs to be associative but not commutative
+    template <typename T, typename Index, typename Fn, typename Reduce>
+    T parallel_reduce(Index first, Index last, uints grain, const T& identity, const Fn& fn, const Reduce& reduce)
+    {
+        if (!(first < last))
+            return identity;
+
+        uints n = uints(last - first);
+        if (grain == 0)
+            grain = default_grain(n);
+
+        uints nchunks = align_to_chunks(n, grain);
+        dynarray<T> partial;
+        partial.alloc(nchunks);
+
+        parallel_for_range(uints(0), nchunks, 1, [&](uints b, uints e) {
+            for (; b < e; ++b) {
+                Index cf = first + b * grain;
+                Index cl = b + 1 < nchunks ? cf + grain : last;
+                partial[b] = fn(cf, cl, identity);
+            }
+        });
+
+        T result = identity;
+        for (uints i = 0; i < nchunks; ++i)
+            result = reduce(result, partial[i]);
+
+        return result;
+    }
+
+    ///Parallel prefix scan over a range
+    //@param grain max number of indices scanned by a single task, 0 to pick one from the worker count
+    //@param identity identity value of the scan operation
+    //@param fn function T(Index first, Index last, T init, bool final) that accumulates the subrange
+    // onto init and returns the result; when final is true it should also write out the prefix values
+    //@param reduce function T(const T& a, const T& b) combining two partial results
+    //@return total value of the scan
+    //@note runs in two passes: first computes the sums of chunks without final, then runs final pass
+    // on each chunk with prefix of preceding chunks
+    template <typename T, typename Index, typename Fn, typename Reduce>
+    T parallel_scan(Index first, Index last, uints grain, const T& identity, const Fn& fn, const Reduce& reduce)
+    {
+        if (!(first < last))
+            return identity;
+
+        uints n = uints(last - first);
+        if (grain == 0)
+            grain = default_grain(n);
+
+        uints nchunks = align_to_chunks(n, grain);
+        dynarray<T> partial;
+        partial.alloc(nchunks);
+
+        auto chunk = [&](uints b, Index& cf, Index& cl) {
+            cf = first + b * grain;
+            cl = b + 1 < nchunks ? cf + grain : last;
+        };
+
+        //the last chunk's sum is not needed for the prefixes
+        parallel_for_range(uints(0), nchunks - 1, 1, [&](uints b, uints e) {
+            for (; b < e; ++b) {
+                Index cf, cl;
+                chunk(b, cf, cl);
+                partial[b] = fn(cf, cl, identity, false);
+            }
+        });
+
+        //exclusive prefixes
+        T sum = identity;
+        for (uints i = 0; i + 1 < nchunks; ++i) {
+            T next = reduce(sum, partial[i]);
+            partial[i] = sum;
+            sum = next;
+        }
+        partial[nchunks - 1] = sum;
+
+        parallel_for_range(uints(0), nchunks, 1, [&](uints b, uints e) {
+            for (; b < e; ++b) {
+                Index cf, cl;
+                chunk(b, cf, cl);
+                partial[b] = fn(cf, cl, partial[b], true);
+            }
+        });
+
+        return partial[nchunks - 1];
+    }
+
     ///Push task (functor, e.g. lamda) into queue for processing by worker threads
     //@param priority task priority, higher priority tasks are processed before lower priority
     //@param signal signal to trigger when the task finishes
@@ -146,25 +341,65 @@ public:
     //@param args arguments needed to invoke the function
     template <typename Fn, typename ...Args>
     void push(EPriority priority, signal_handle* signal, const Fn& fn, Args&& ...args)
+    {
+        push(affinity_hint(), priority, signal, fn, std::forward<Args>(args)...);
+    }
+
+    ///Push task (function and its arguments) into queue for processing by worker threads
+    //@param hint preferred NUMA node or worker to run the task on
+    //@param priority task priority, higher priority tasks are processed before lower priority
+    //@param signal signal to trigger when the task finishes
+    //@param fn function to run
+    //@param args arguments needed to invoke the function
+    template <typename Fn, typename ...Args>
+    void push(const affinity_hint& hint, EPriority priority, signal_handle* signal, const Fn& fn, Args&& ...args)
     {
         using callfn = invoker<Fn, Args...>;
 
-        {
-            //lock to access allocator and semaphore
-            std::unique_lock<std::mutex> lock(_sync);
+        granule* p = alloc_data(sizeof(callfn));
+        increment(signal);
+        auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, std::forward<Args>(args)...);
 
-            granule* p = alloc_data(sizeof(callfn));
-            increment(signal);
-            auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, std::forward<Args>(args)...);
+        //enqueue locks only if it needs to
+        std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+        enqueue(lock, priority, hint, (granule*)task, 0, 1);
+    }
 
-            _ready_jobs[(int)priority].push_front(task);
+    ///Push tasks fn(index) for each index of the range into queue as a single batch
+    //@param priority task priority, higher priority tasks are processed before lower priority
+    //@param signal signal to trigger when all the tasks finish
+    //@param first begin index value
+    //@param last end index value
+    //@param fn function(index) to run
+    //@note storage for the tasks is allocated in contiguous blocks, each block is queued at once
+    // and only as many workers are woken up as there are tasks
+    template <typename Index, typename Fn>
+    void push_range(EPriority priority, signal_handle* signal, Index first, Index last, const Fn& fn)
+    {
+        using callfn = invoker<Fn, Index>;
 
-            ++_qsize;
-            if (priority != EPriority::LOW) ++_hqsize;
-        }
-        _cv.notify_one();
-        if (priority != EPriority::LOW) {
-            _hcv.notify_one();
+        if (!(first < last))
+            return;
+
+        const uints stride = align_to_chunks(sizeof(callfn), sizeof(granule));
+        const uints nblock = stdmax(BATCH_GRANULES / stride, uints(1));
+        uints n = uints(last - first);
+
+        //enqueue locks only if it needs to
+        std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+
+        increment(signal, int(n));
+        const signal_handle handle = signal ? *signal : invalid_signal;
+
+        while (n > 0) {
+            const uints nb = stdmin(n, nblock);
+            granule* p = alloc_data(nb * stride * sizeof(granule));
+
+            for (uints i = 0; i < nb; ++i, ++first)
+                new(p + i * stride) callfn(handle, fn, Index(first));
+
+            enqueue(lock, priority, affinity_hint(), p, stride, nb);
+            n -= nb;
         }
     }
 
@@ -181,23 +416,12 @@ public:
 
         using callfn = invoker_memberfn<Fn, C*, Args...>;
 
-        {
-            //lock to access allocator and semaphore
-            std::unique_lock<std::mutex> lock(_sync);
-
-            granule* p = alloc_data(sizeof(callfn));
-            increment(signal);
-            auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, obj, std::forward<Args>(args)...);
+        granule* p = alloc_data(sizeof(callfn));
+        increment(signal);
+        auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, obj, std::forward<Args>(args)...);
 
-            _ready_jobs[(int)priority].push_front(task);
-
-            ++_qsize;
-            if (priority != EPriority::LOW) ++_hqsize;
-        }
-        _cv.notify_one();
-        if (priority != EPriority::LOW) {
-            _hcv.notify_one();
-        }
+        std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+        enqueue(lock, priority, task);
     }
 
     ///Push task (function and its arguments) into queue for processing by worker threads
@@ -213,34 +437,52 @@ public:
 
         using callfn = invoker_memberfn<Fn, C, Args...>;
 
-        {
-            //lock to access allocator and semaphore
-            std::unique_lock<std::mutex> lock(_sync);
+        granule* p = alloc_data(sizeof(callfn));
+        increment(signal);
+        auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, obj, std::forward<Args>(args)...);
 
-            granule* p = alloc_data(sizeof(callfn));
-            increment(signal);
-            auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, obj, std::forward<Args>(args)...);
+        std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+        enqueue(lock, priority, task);
+    }
+
+    ///Push task that becomes ready after another signal gets signaled, without blocking any thread
+    //@param after signal to wait for, if it's already signaled the task is queued immediately
+    //@param priority task priority, higher priority tasks are processed before lower priority
+    //@param signal signal to trigger when the task finishes
+    //@param fn function to run
+    //@param args arguments needed to invoke the function
+    template <typename Fn, typename ...Args>
+    void push_after(signal_handle after, EPriority priority, signal_handle* signal, const Fn& fn, Args&& ...args)
+    {
+        using callfn = invoker<Fn, Args...>;
 
-            _ready_jobs[(int)priority].push_front(task);
+        granule* p = alloc_data(sizeof(callfn));
+        increment(signal);
+        auto task = new(p) callfn(signal ? *signal : invalid_signal, fn, std::forward<Args>(args)...);
 
-            ++_qsize;
-            if (priority != EPriority::LOW) ++_hqsize;
-        }
-        _cv.notify_one();
-        if (priority != EPriority::LOW) {
-            _hcv.notify_one();
+        if (!add_continuation(after, priority, task)) {
+            std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+            enqueue(lock, priority, task);
         }
     }
 
+    ///Submit task graph for processing
+    //@param graph graph to run; it must not be modified or submitted again until it finishes
+    //@param signal signal to trigger when all tasks of the graph finish
+    //@note nodes are queued once all their dependencies are finished, no thread waits for them
+    void push_graph(task_graph& graph, signal_handle* signal);
+
     /// Enter critical section; no two threads can be in the same critical section at the same time
     /// other threads process other tasks while waiting to enter critical section
     //@param spin_count number of spins before trying to process other tasks
     //@note never call enter(A) enter(B) exit(A) exit(B) in that order, since it can cause
     // deadlock thanks to taskmaster's nature
+    // coroutine tasks can use co_await on the critical section instead, which doesn't nest
     void enter_critical_section(critical_section& critical_section, int spin_count = 1024);
 
-    /// Leave critical section
-    //@note only thread which entered the critical section can leave it
+    /// Leave critical section, handing it over to the first coroutine parked on it
+    //@note only thread which entered the critical section can leave it; coroutines awaiting the section
+    // must belong to the same taskmaster
     void leave_critical_section(critical_section& critical_section);
 
     ///Wait for signal to become signaled
@@ -266,6 +508,9 @@ public:
 
 protected:
 
+    struct invoker_base;
+    struct granule;
+
     ///
     struct threadinfo
     {
@@ -273,24 +518,73 @@ protected:
         taskmaster* master;
 
         int order;
+        int node;                                       //< NUMA node pool
+        uint64 affinity;                                //< processor affinity mask, 0 if not pinned
+
+        rnd_int rnd;                                    //< victim selection when stealing
+        atomic::ws_deque<invoker_base*> local[(int)EPriority::COUNT];  //< work stealing mode deques
+        atomic::queue<invoker_base*> mailbox[(int)EPriority::COUNT];   //< tasks pushed with this worker as preferred
 
+        std::condition_variable cv;                     //< signaled to wake up this worker
+        bool sleeping;                                  //< blocked in wait(), guarded by _sync
 
-        threadinfo() : master(0), order(-1)
+        std::atomic<uint64> ntasks;
+        std::atomic<uint64> nsteals;
+        std::atomic<uint64> idle_ns;
+
+        threadinfo() : master(0), order(-1), node(0), affinity(0), sleeping(false), ntasks(0), nsteals(0), idle_ns(0)
         {}
     };
 
+    ///Queues of a NUMA node pool
+    struct nodeinfo
+    {
+        atomic::queue<invoker_base*> ready[(int)EPriority::COUNT];
+    };
+
     ///Unit of allocation for tasks
     struct granule
     {
         uint8 dummy[8 * sizeof(void*)];
     };
 
+    static const uints BATCH_GRANULES = 256;           //< max contiguous granules, size of slotalloc page
+
     static int& get_order()
     {
         static thread_local int order = -1;
         return order;
     }
 
+    //@return worker info of the current thread, or null if it's not a worker thread
+    static threadinfo*& get_threadinfo()
+    {
+        static thread_local threadinfo* ti = 0;
+        return ti;
+    }
+
+    ///Grain size for a range of n items, aims at several chunks per worker to balance uneven work
+    uints default_grain(uints n) const {
+        uints nchunks = 8 * (_threads.size() + 1);
+        return n > nchunks ? n / nchunks : 1;
+    }
+
+    ///Process the range by splitting off its upper halves as new tasks until the rest fits into grain
+    template <typename Index, typename Fn>
+    void split_range(signal_handle* signal, Index first, Index last, uints grain, const Fn& fn)
+    {
+        while (uints(last - first) > grain) {
+            Index mid = first + (last - first) / 2;
+            push(EPriority::HIGH, signal, [this, signal, grain, &fn](Index b, Index e) {
+                split_range(signal, b, e, grain, fn);
+                }, mid, last);
+            last = mid;
+        }
+
+        fn(first, last);
+    }
+
+    //@note thread safe, single granule slots come from per-thread magazines of the allocator
     granule* alloc_data(uints size)
     {
         uints n = align_to_chunks(size, sizeof(granule));
@@ -300,30 +594,90 @@ protected:
         return p;
     }
 
-    ///
-    struct invoker_base {
-        virtual void invoke() = 0;
-        virtual size_t size() const = 0;
+    ///Release task storage, single granule slots go back to the magazine of the current thread
+    void free_task(granule* p, uints size)
+    {
+        _taskdata.del_range(p, align_to_chunks(size, sizeof(granule)));
+    }
 
-        invoker_base(signal_handle signal)
-            : _signal(signal)
+    ///Type-erased task, the callable is stored inline after the header and invoked through
+    /// a plain function pointer
+    struct invoker_base {
+        typedef void (*thunk_fn)(invoker_base*);
+
+        invoker_base(signal_handle signal, thunk_fn invoke, thunk_fn destroy, uints size)
+            : _invoke(invoke)
+            , _destroy(destroy)
+            , _signal(signal)
+            , _size(uint32(size))
+#ifdef _DEBUG
             , _tid(thread::self())
+#endif
         {}
 
+        void invoke() {
+            _invoke(this);
+        }
+
+        ///Destroy the callable, the storage is released by the caller
+        void destroy() {
+            if (_destroy)
+                _destroy(this);
+        }
+
+        size_t size() const {
+            return _size;
+        }
+
         signal_handle signal() const {
             return _signal;
         }
 
     protected:
+
+        template <class T>
+        static void invoke_thunk(invoker_base* p) {
+            static_cast<T*>(p)->run();
+        }
+
+        template <class T>
+        static void destroy_thunk(invoker_base* p) {
+            static_cast<T*>(p)->~T();
+        }
+
+        //@return destroy thunk of T or null if there's nothing to destroy
+        template <class T>
+        static thunk_fn destroyer() {
+            return std::is_trivially_destructible<T>::value ? 0 : &destroy_thunk<T>;
+        }
+
+        thunk_fn _invoke;
+        thunk_fn _destroy;
         signal_handle _signal;
-        thread_t _tid;
+        uint32 _size;
+#ifdef _DEBUG
+        thread_t _tid;                  //< pushing thread
+#endif
+    };
+
+    ///Task parked on a critical section, queued by the thread leaving the section
+    struct section_waiter : invoker_base
+    {
+        section_waiter(thunk_fn invoke, uints size, EPriority priority)
+            : invoker_base(invalid_signal, invoke, 0, size)
+            , next(0)
+            , priority(priority)
+        {}
+
+        section_waiter* next;
+        EPriority priority;
     };
 
     template <typename Fn, typename ...Args>
     struct invoker_common : invoker_base
     {
-        invoker_common(signal_handle signal, const Fn& fn, Args&& ...args)
-            : invoker_base(signal)
+        invoker_common(signal_handle signal, thunk_fn invoke, thunk_fn destroy, uints size, const Fn& fn, Args&& ...args)
+            : invoker_base(signal, invoke, destroy, size)
             , _fn(fn)
             , _tuple(std::forward<Args>(args)...)
         {}
@@ -353,16 +707,13 @@ protected:
     struct invoker : invoker_common<Fn, Args...>
     {
         invoker(signal_handle signal, const Fn& fn, Args&& ...args)
-            : invoker_common<Fn, Args...>(signal, fn, std::forward<Args>(args)...)
+            : invoker_common<Fn, Args...>(signal, &invoker_base::invoke_thunk<invoker>, invoker_base::destroyer<invoker>(), sizeof(invoker),
+                fn, std::forward<Args>(args)...)
         {}
 
-        void invoke() override final {
+        void run() {
             this->invoke_fn(make_index_sequence<sizeof...(Args)>());
         }
-
-        size_t size() const override final {
-            return sizeof(*this);
-        }
     };
 
     ///invoker for member functions (on copied objects)
@@ -370,23 +721,21 @@ protected:
     struct invoker_memberfn : invoker_common<Fn, Args...>
     {
         invoker_memberfn(signal_handle signal, Fn fn, const C& obj, Args&&... args)
-            : invoker_common<Fn, Args...>(signal, fn, std::forward<Args>(args)...)
+            : invoker_common<Fn, Args...>(signal, &invoker_base::invoke_thunk<invoker_memberfn>, invoker_base::destroyer<invoker_memberfn>(), sizeof(invoker_memberfn),
+                fn, std::forward<Args>(args)...)
             , _obj(obj)
         {}
 
         invoker_memberfn(signal_handle signal, Fn fn, C&& obj, Args&&... args)
-            : invoker_common<Fn, Args...>(signal, fn, std::forward<Args>(args)...)
+            : invoker_common<Fn, Args...>(signal, &invoker_base::invoke_thunk<invoker_memberfn>, invoker_base::destroyer<invoker_memberfn>(), sizeof(invoker_memberfn),
+                fn, std::forward<Args>(args)...)
             , _obj(std::forward<C>(obj))
         {}
 
-        void invoke() override final {
+        void run() {
             this->invoke_memberfn(_obj, make_index_sequence<sizeof...(Args)>());
         }
 
-        size_t size() const override final {
-            return sizeof(*this);
-        }
-
     private:
 
         C _obj;
@@ -397,18 +746,15 @@ protected:
     struct invoker_memberfn<Fn, C*, Args...> : invoker_common<Fn, Args...>
     {
         invoker_memberfn(signal_handle signal, Fn fn, C* obj, Args&&... args)
-            : invoker_common<Fn, Args...>(signal, fn, std::forward<Args>(args)...)
+            : invoker_common<Fn, Args...>(signal, &invoker_base::invoke_thunk<invoker_memberfn>, invoker_base::destroyer<invoker_memberfn>(), sizeof(invoker_memberfn),
+                fn, std::forward<Args>(args)...)
             , _obj(obj)
         {}
 
-        void invoke() override final {
+        void run() {
             this->invoke_memberfn(*_obj, make_index_sequence<sizeof...(Args)>());
         }
 
-        size_t size() const override final {
-            return sizeof(*this);
-        }
-
     private:
 
         C* _obj;
@@ -419,29 +765,506 @@ protected:
     struct invoker_memberfn<Fn, iref<C>, Args...> : invoker_common<Fn, Args...>
     {
         invoker_memberfn(signal_handle signal, Fn fn, const iref<C>& obj, Args&&... args)
-            : invoker_common<Fn, Args...>(signal, fn, std::forward<Args>(args)...)
+            : invoker_common<Fn, Args...>(signal, &invoker_base::invoke_thunk<invoker_memberfn>, invoker_base::destroyer<invoker_memberfn>(), sizeof(invoker_memberfn),
+                fn, std::forward<Args>(args)...)
             , _obj(obj)
         {}
 
-        void invoke() override final {
+        void run() {
             this->invoke_memberfn(*_obj, make_index_sequence<sizeof...(Args)>());
         }
 
-        size_t size() const override final {
-            return sizeof(*this);
-        }
-
     private:
 
         iref<C> _obj;
     };
 
+    ///Task waiting for a signal
+    struct continuation
+    {
+        invoker_base* task;
+        EPriority priority;
+    };
+
     struct signal
     {
         volatile int ref;
         uint32 version;
+
+        dynarray<continuation> waiting;     //< tasks to queue once the signal gets signaled
+    };
+
+#ifdef COID_TASKMASTER_COROUTINES
+    //@note the coroutine support consists of inline code and types only and doesn't change the layout
+    // of taskmaster, so the library itself doesn't have to be compiled as C++20
+
+    //@return taskmaster from which coroutine frames created on the current thread are allocated
+    static taskmaster*& co_frame_master()
+    {
+        static thread_local taskmaster* master = 0;
+        return master;
+    }
+
+    struct co_frame_scope
+    {
+        explicit co_frame_scope(taskmaster* master) : _prev(co_frame_master()) {
+            co_frame_master() = master;
+        }
+
+        ~co_frame_scope() {
+            co_frame_master() = _prev;
+        }
+
+    private:
+        taskmaster* _prev;
+    };
+
+    ///Precedes the coroutine frame in memory
+    struct alignas(alignof(std::max_align_t)) co_frame_header
+    {
+        taskmaster* master;                 //< owner of the granules, null if allocated on heap
+    };
+
+    ///Task resuming a suspended coroutine, can be parked on a critical section
+    struct co_resumer : section_waiter
+    {
+        co_resumer(taskmaster* master, EPriority priority, std::coroutine_handle<> handle)
+            : section_waiter(&invoke_thunk<co_resumer>, sizeof(co_resumer), priority)
+            , _master(master)
+            , _handle(handle)
+        {}
+
+        void run() {
+            co_frame_scope scope(_master);
+            _handle.resume();
+        }
+
+    private:
+
+        taskmaster* _master;
+        std::coroutine_handle<> _handle;
+    };
+
+    ///Queue a task that resumes the coroutine
+    void co_resume(EPriority priority, std::coroutine_handle<> handle)
+    {
+        granule* p = alloc_data(sizeof(co_resumer));
+        auto task = new(p) co_resumer(this, priority, handle);
+
+        std::unique_lock<std::mutex> lock(_sync, std::defer_lock);
+        enqueue(lock, priority, task);
+    }
+
+    ///co_await signal_handle
+    struct co_signal_awaiter
+    {
+        taskmaster* master;
+        EPriority priority;
+        signal_handle signal;
+
+        bool await_ready() const {
+            return !signal.is_valid() || master->is_signaled(signal, true);
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            taskmaster* tm = master;
+
+            granule* p = tm->alloc_data(sizeof(co_resumer));
+            auto task = new(p) co_resumer(tm, priority, handle);
+
+            //the coroutine can be resumed by another thread from here on, the awaiter must not be touched
+            if (tm->add_continuation(signal, priority, task))
+                return true;
+
+            //signaled meanwhile
+            tm->free_task(p, sizeof(co_resumer));
+            return false;
+        }
+
+        void await_resume() const {}
+    };
+
+    ///co_await critical_section
+    struct co_section_awaiter
+    {
+        taskmaster* master;
+        EPriority priority;
+        critical_section& cs;
+
+        bool await_ready() const {
+            return try_enter_critical_section(cs);
+        }
+
+        ///Park the coroutine on the section, it's resumed inside it by leave_critical_section
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            taskmaster* tm = master;
+
+            granule* p = tm->alloc_data(sizeof(co_resumer));
+            auto task = new(p) co_resumer(tm, priority, handle);
+
+            std::unique_lock<std::mutex> lock(tm->_section_sync);
+            for (;;) {
+                if (try_enter_critical_section(cs)) {
+                    //left meanwhile
+                    lock.unlock();
+                    tm->free_task(p, sizeof(co_resumer));
+                    return false;
+                }
+
+                //marked so that the leaving thread takes the lock and hands the section over
+                if (cs.value == 2 || atomic::cas(&cs.value, 2, 1) == 1)
+                    break;
+            }
+
+            if (cs.parked_last)
+                cs.parked_last->next = task;
+            else
+                cs.parked = task;
+            cs.parked_last = task;
+
+            return true;
+        }
+
+        void await_resume() const {}
+    };
+
+    ///Promise part common to all coroutine tasks
+    struct co_promise_base
+    {
+        taskmaster* master = 0;
+        EPriority priority = EPriority::NORMAL;
+        signal_handle signal;               //< signal of a pushed coroutine, triggered when it finishes
+        std::coroutine_handle<> parent;     //< coroutine awaiting this one
+        bool detached = false;              //< pushed coroutine, frame destroys itself when finished
+
+        ///Frames are allocated from the task granules of the taskmaster that runs the coroutine,
+        /// frames larger than a granule block go to the heap
+        static void* operator new(size_t size)
+        {
+            const uints total = size + sizeof(co_frame_header);
+            taskmaster* tm = co_frame_master();
+            co_frame_header* h;
+
+            if (tm && align_to_chunks(total, sizeof(granule)) <= BATCH_GRANULES)
+                h = (co_frame_header*)tm->alloc_data(total);
+            else {
+                tm = 0;
+                h = (co_frame_header*)::operator new(total);
+            }
+
+            h->master = tm;
+            return h + 1;
+        }
+
+        static void operator delete(void* p, size_t size)
+        {
+            co_frame_header* h = (co_frame_header*)p - 1;
+            if (h->master)
+                h->master->_taskdata.del_range((granule*)h, align_to_chunks(size + sizeof(co_frame_header), sizeof(granule)));
+            else
+                ::operator delete(h);
+        }
+
+        struct final_awaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept
+            {
+                co_promise_base& p = handle.promise();
+                if (p.parent)
+                    return p.parent;
+
+                if (p.detached) {
+                    taskmaster* tm = p.master;
+                    signal_handle signal = p.signal;
+                    handle.destroy();
+
+                    if (signal.is_valid())
+                        tm->decrement(signal);
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        //coroutines start when pushed or awaited
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() {
+            //nothing to propagate the exception to in a worker thread
+            std::terminate();
+        }
+
+        co_signal_awaiter await_transform(signal_handle signal) {
+            DASSERT(master);
+            return co_signal_awaiter{ master, priority, signal };
+        }
+
+        co_section_awaiter await_transform(critical_section& cs) {
+            DASSERT(master);
+            return co_section_awaiter{ master, priority, cs };
+        }
+
+        template <class A>
+        A&& await_transform(A&& awaitable) {
+            return std::forward<A>(awaitable);
+        }
+    };
+
+    template <typename T, typename = void>
+    struct co_promise : co_promise_base
+    {
+        std::optional<T> value;
+
+        template <class V>
+        void return_value(V&& v) {
+            value.emplace(std::forward<V>(v));
+        }
+
+        T result() {
+            return std::move(*value);
+        }
+    };
+
+    template <typename T, typename D>
+    struct co_promise<T&, D> : co_promise_base
+    {
+        T* value = 0;
+
+        void return_value(T& v) {
+            value = &v;
+        }
+
+        T& result() {
+            return *value;
+        }
+    };
+
+    template <typename D>
+    struct co_promise<void, D> : co_promise_base
+    {
+        void return_void() {}
+        void result() {}
+    };
+#endif //COID_TASKMASTER_COROUTINES
+
+public:
+
+    ///Graph of tasks with dependencies, built once and submitted repeatedly with push_graph
+    class task_graph
+    {
+    public:
+
+        typedef uint node_id;
+
+        task_graph() : _signal(invalid_signal)
+        {}
+
+        ~task_graph() {
+            clear();
+        }
+
+        ///Add task node
+        //@param priority task priority
+        //@param fn functor to run
+        //@param name node name, used in critical path dump
+        //@return node id
+        template <typename Fn>
+        node_id add(EPriority priority, const Fn& fn, const token& name = token())
+        {
+            node* n = _nodes.add();
+            n->work = new(::operator new(sizeof(invoker<Fn>))) invoker<Fn>(invalid_signal, fn);
+            n->priority = priority;
+            n->name = name;
+
+            return node_id(_nodes.size() - 1);
+        }
+
+        ///Make node after run only after node before finishes
+        void precede(node_id before, node_id after);
+
+        ///Make node run only after an external signal gets signaled
+        //@param signal pointer to signal variable, read each time the graph is submitted
+        void depend(node_id node, const signal_handle* signal);
+
+        uints size() const { return _nodes.size(); }
+
+        ///Remove all nodes
+        void clear();
+
+        ///Compute the critical path (longest chain of dependent nodes) of the last run
+        //@param path receives ids of nodes on the critical path
+        //@return duration of the critical path in ns
+        uint64 critical_path(dynarray<node_id>& path) const;
+
+        ///Write the critical path of the last run with node durations
+        charstr& dump_critical_path(charstr& dst) const;
+
+    private:
+
+        friend class taskmaster;
+
+        task_graph(const task_graph&);
+
+        struct node
+        {
+            invoker_base* work = 0;
+            EPriority priority = EPriority::NORMAL;
+            charstr name;
+
+            dynarray<node_id> successors;
+            dynarray<const signal_handle*> signals;
+
+            int npred = 0;                  //< number of predecessor nodes
+            volatile int32 pending = 0;     //< dependencies left in current run
+
+            uint64 start_ns = 0;
+            uint64 end_ns = 0;
+        };
+
+        dynarray<node> _nodes;
+        signal_handle _signal;              //< signal of the current run
+    };
+
+#ifdef COID_TASKMASTER_COROUTINES
+
+    /**
+        Coroutine task.
+
+        Coroutine returning co_task can co_await:
+         - signal_handle: resumes once the signal gets signaled, e.g. after tasks pushed with it finish
+         - critical_section: resumes inside the section, leave it with leave_critical_section
+         - co_task: runs the child coroutine and resumes with its result
+
+        While suspended the coroutine doesn't occupy any thread. Coroutines are lazy, they start
+        running when pushed with push_co or when awaited by a parent coroutine, and they inherit
+        the priority of the parent.
+
+        Usage:
+            coid::taskmaster::co_task<> job(coid::taskmaster& tm) {
+                coid::taskmaster::signal_handle signal;
+                tm.push(coid::taskmaster::EPriority::NORMAL, &signal, [](){ foo(); });
+                co_await signal;
+                int x = co_await bar();
+            }
+
+            tm.push_co(coid::taskmaster::EPriority::NORMAL, &signal, job, std::ref(tm));
+    **/
+    template <typename T = void>
+    class co_task
+    {
+    public:
+
+        struct promise_type : co_promise<T>
+        {
+            co_task get_return_object() {
+                return co_task(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+        };
+
+        co_task() {}
+
+        co_task(co_task&& other) : _handle(other._handle) {
+            other._handle = nullptr;
+        }
+
+        co_task& operator = (co_task&& other) {
+            if (this != &other) {
+                if (_handle)
+                    _handle.destroy();
+                _handle = other._handle;
+                other._handle = nullptr;
+            }
+            return *this;
+        }
+
+        ~co_task() {
+            if (_handle)
+                _handle.destroy();
+        }
+
+        bool is_valid() const { return bool(_handle); }
+
+        ///Awaiter running the child coroutine on the current worker and resuming the parent with its result
+        struct awaiter
+        {
+            std::coroutine_handle<promise_type> child;
+
+            bool await_ready() const noexcept {
+                return !child || child.done();
+            }
+
+            template <class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept
+            {
+                const co_promise_base& pp = parent.promise();
+                co_promise_base& cp = child.promise();
+                cp.master = pp.master;
+                cp.priority = pp.priority;
+                cp.parent = parent;
+                return child;
+            }
+
+            T await_resume() {
+                return child.promise().result();
+            }
+        };
+
+        awaiter operator co_await() && {
+            return awaiter{ _handle };
+        }
+
+    private:
+
+        friend class taskmaster;
+
+        explicit co_task(std::coroutine_handle<promise_type> handle) : _handle(handle)
+        {}
+
+        std::coroutine_handle<promise_type> release() {
+            std::coroutine_handle<promise_type> h = _handle;
+            _handle = nullptr;
+            return h;
+        }
+
+        std::coroutine_handle<promise_type> _handle;
     };
 
+    ///Push coroutine task into queue for processing by worker threads
+    //@param priority task priority, inherited by child coroutines it awaits
+    //@param signal signal to trigger when the coroutine finishes
+    //@param fn coroutine function returning co_task
+    //@param args arguments for the coroutine, stored in its frame (use std::ref for references)
+    //@note the frame is allocated from the task storage, the coroutine runs on worker threads
+    template <typename Fn, typename ...Args>
+    void push_co(EPriority priority, signal_handle* signal, const Fn& fn, Args&& ...args)
+    {
+        auto task = [&]() {
+            co_frame_scope scope(this);
+            return fn(std::forward<Args>(args)...);
+        }();
+        DASSERT_RET(task.is_valid());
+
+        auto handle = task.release();
+        co_promise_base& p = handle.promise();
+        p.master = this;
+        p.priority = priority;
+        p.detached = true;
+
+        increment(signal);
+        p.signal = signal ? *signal : invalid_signal;
+
+        co_resume(priority, handle);
+    }
+
+#endif //COID_TASKMASTER_COROUTINES
+
 private:
 
     taskmaster(const taskmaster&);
@@ -453,9 +1276,51 @@ private:
 
     void* threadfunc(int order);
     void run_task(invoker_base* task);
+
+    ///Put task to the shared queue or, in work stealing mode, to the deque of current worker
+    //@param lock _sync lock, locked on demand if not owned, released on return
+    void enqueue(std::unique_lock<std::mutex>& lock, EPriority priority, invoker_base* task) {
+        enqueue(lock, priority, affinity_hint(), (granule*)task, 0, 1);
+    }
+
+    ///Put a batch of tasks laid out in contiguous memory to the queue
+    //@param lock _sync lock, locked on demand if not owned, released on return
+    //@param hint preferred node or worker
+    //@param first storage of the first task
+    //@param stride number of granules between tasks
+    //@param n number of tasks
+    void enqueue(std::unique_lock<std::mutex>& lock, EPriority priority, const affinity_hint& hint, granule* first, uints stride, uints n);
+
+    ///Wake up to n sleeping workers that can process tasks of given priority, preferred ones first
+    //@param lock locked _sync, released on return
+    void wake(std::unique_lock<std::mutex>& lock, EPriority priority, uints n, const affinity_hint& hint);
+
+    ///Get next task to run by worker with given order (-1 for non-worker threads)
+    //@return task or null if nothing runnable was found
+    invoker_base* pop_task(int order);
+
+    ///Try to steal a task of given priority from other workers and other nodes' queues
+    //@param self worker info of the current thread or null
+    invoker_base* steal_task(threadinfo* self, int prio);
+
+    void schedule_node(task_graph& graph, uint id);
+    void release_node(task_graph& graph, uint id);
+    void run_node(task_graph& graph, uint id);
+
+    ///Attach task to a signal, to be queued once the signal gets signaled
+    //@return false if the signal is already signaled
+    bool add_continuation(signal_handle handle, EPriority priority, invoker_base* task);
+
+    ///Decrement signal's counter and queue tasks waiting for it once it reaches 0
+    void decrement(signal_handle handle);
+
+    static bool try_enter_critical_section(critical_section& cs) {
+        return cs.value == 0 && atomic::cas(&cs.value, 1, 0) == 0;
+    }
+
     bool is_signaled(signal_handle handle, bool lock);
-    signal_handle alloc_signal();
-    void increment(signal_handle* handle);
+    signal_handle alloc_signal(int ref = 1);
+    void increment(signal_handle* handle, int count = 1);
     void notify_all();
     void wait();
 
@@ -463,20 +1328,24 @@ private:
 
     std::mutex _sync;
     std::mutex _signal_sync;
-    std::condition_variable _cv;        //< for threads which can process low prio tasks
-    std::condition_variable _hcv;       //< for threads which can not process low prio tasks
+    std::mutex _section_sync;           //< guards coroutines parked on critical sections
     std::atomic_int _qsize;             //< current queue size, used also as a semaphore
     std::atomic_int _hqsize;            //< current queue size without low prio tasks
+    std::atomic_int _npending[(int)EPriority::COUNT];  //< queued tasks per priority
+    std::atomic_int _nsleeping;         //< number of workers blocked in wait()
     volatile bool _quitting;
 
-    slotalloc_atomic<granule> _taskdata;
+    EScheduler _scheduler;
+
+    slotalloc_multi<granule> _taskdata;
 
     dynarray<threadinfo> _threads;
+    dynarray<nodeinfo> _nodes;
     volatile int _nlowprio_threads;
 
     dynarray<signal> _signal_pool;
     dynarray<signal_handle> _free_signals;
-    queue<invoker_base*> _ready_jobs[(int)EPriority::COUNT];
+    atomic::queue<invoker_base*> _ready_jobs[(int)EPriority::COUNT];
 };
 
 COID_NAMESPACE_END